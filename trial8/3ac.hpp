@@ -5,9 +5,11 @@
 #include <list>
 #include <map>
 #include <set>
+#include <vector>
 #include <string.h>
 #include "symbol_table.hpp"
 #include "types.hpp"
+#include "output_sink.hpp"
 
 namespace cshanty{
 
@@ -79,10 +81,10 @@ public:
 	virtual std::string valString() = 0;
 	virtual std::string locString() = 0;
 	virtual size_t getWidth(){ return myWidth; }
-	virtual void genLoadAddr(std::ostream& out, Register reg) = 0;
-	virtual void genStoreAddr(std::ostream& out, Register reg) = 0;
-	virtual void genLoadVal(std::ostream& out, Register reg) = 0;
-	virtual void genStoreVal(std::ostream& out, Register reg) = 0;
+	virtual void genLoadAddr(OutputSink& out, Register reg) = 0;
+	virtual void genStoreAddr(OutputSink& out, Register reg) = 0;
+	virtual void genLoadVal(OutputSink& out, Register reg) = 0;
+	virtual void genStoreVal(OutputSink& out, Register reg) = 0;
 	static size_t width(const DataType * type){
 		return type->getSize();
 	}
@@ -119,10 +121,10 @@ public:
 		return mySym->getName();
 	}
 	const SemSymbol * getSym(){ return mySym; }
-	virtual void genLoadVal(std::ostream& out, Register reg) override; 
-	virtual void genStoreVal(std::ostream& out, Register reg) override; 
-	virtual void genLoadAddr(std::ostream& out, Register reg) override; 
-	virtual void genStoreAddr(std::ostream& out, Register reg) override{ 
+	virtual void genLoadVal(OutputSink& out, Register reg) override; 
+	virtual void genStoreVal(OutputSink& out, Register reg) override; 
+	virtual void genLoadAddr(OutputSink& out, Register reg) override; 
+	virtual void genStoreAddr(OutputSink& out, Register reg) override{ 
 		throw new InternalError("Cannot change the addr of a symOpd");
 	}
 	virtual void setMemoryLoc(std::string loc) override {
@@ -159,14 +161,14 @@ public:
 	virtual std::string locString() override{
 		throw InternalError("Tried to get location of a constant: ");
 	}
-	virtual void genLoadVal(std::ostream& out, Register reg) override; 
-	virtual void genStoreVal(std::ostream& out, Register reg) override{ 
+	virtual void genLoadVal(OutputSink& out, Register reg) override; 
+	virtual void genStoreVal(OutputSink& out, Register reg) override{ 
 		throw new InternalError("Cannot change value of a literal");
 	}
-	virtual void genLoadAddr(std::ostream& out, Register reg) override{ 
+	virtual void genLoadAddr(OutputSink& out, Register reg) override{ 
 		throw new InternalError("Cannot get addr of a literal");
 	}
-	virtual void genStoreAddr(std::ostream& out, Register reg) override{ 
+	virtual void genStoreAddr(OutputSink& out, Register reg) override{ 
 		throw new InternalError("Cannot set the addr of a literal");
 	}
 	virtual void setMemoryLoc(std::string loc) override{
@@ -192,10 +194,10 @@ public:
 	std::string getName(){
 		return name;
 	}
-	virtual void genLoadVal(std::ostream& out, Register reg) override; 
-	virtual void genStoreVal(std::ostream& out, Register reg) override;
-	virtual void genLoadAddr(std::ostream& out, Register reg) override;
-	virtual void genStoreAddr(std::ostream& out, Register reg) override{ 
+	virtual void genLoadVal(OutputSink& out, Register reg) override; 
+	virtual void genStoreVal(OutputSink& out, Register reg) override;
+	virtual void genLoadAddr(OutputSink& out, Register reg) override;
+	virtual void genStoreAddr(OutputSink& out, Register reg) override{ 
 		throw new InternalError("Cannot change the addr of a auxOpd");
 	}
 
@@ -221,10 +223,10 @@ public:
 	virtual std::string locString() override{
 		return "[" + getName() + "]";
 	}
-	virtual void genLoadAddr(std::ostream& out, Register reg) override;
-	virtual void genStoreAddr(std::ostream& out, Register reg) override; 
-	virtual void genLoadVal(std::ostream& out, Register reg) override; 
-	virtual void genStoreVal(std::ostream& out, Register reg) override; 
+	virtual void genLoadAddr(OutputSink& out, Register reg) override;
+	virtual void genStoreAddr(OutputSink& out, Register reg) override; 
+	virtual void genLoadVal(OutputSink& out, Register reg) override; 
+	virtual void genStoreVal(OutputSink& out, Register reg) override; 
 
 	virtual void setMemoryLoc(std::string loc) override{
 		myLoc = loc;
@@ -243,7 +245,10 @@ private:
 
 enum BinOp {
 	ADD64, SUB64, DIV64, MULT64, EQ64, NEQ64,
-	LT64, GT64, LTE64, GTE64, OR64, AND64
+	LT64, GT64, LTE64, GTE64, OR64, AND64,
+	//Only made by -O: shifts left, right keeping the sign, and
+	// right filling with zeros
+	SHL64, SAR64, SHR64
 };
 enum UnaryOp{
 	NEG64, NOT64
@@ -254,13 +259,21 @@ public:
 	Quad();
 	void addLabel(Label * label);
 	Label * getLabel(){ return labels.front(); }
+	const std::list<Label *>& getLabels(){ return labels; }
 	void clearLabels(){ labels.clear(); }
 	virtual std::string repr() = 0;
 	std::string commentStr();
-	virtual std::string toString(bool verbose=false);
+	void print(OutputSink& out, bool verbose=false);
 	void setComment(std::string commentIn);
-	virtual void codegenX64(std::ostream& out) = 0;
-	void codegenLabels(std::ostream& out);
+	virtual void codegenX64(OutputSink& out) = 0;
+	void codegenLabels(OutputSink& out);
+
+	//Where this quad keeps its operands, for passes that rewrite
+	// them. The destination slot is only for a value the quad
+	// defines: a store through an AddrOpd defines no operand, so
+	// the AddrOpd is listed among the sources instead.
+	virtual Opd ** defSlot(){ return nullptr; }
+	virtual void useSlots(std::vector<Opd **>& slots){ }
 private:
 	std::string myComment;
 	std::list<Label *> labels;
@@ -271,11 +284,13 @@ public:
 	BinOpQuad(Opd * dstIn, BinOp oprIn, Opd * src1In, Opd * src2In);
 	std::string repr() override;
 	static std::string oprString(BinOp opr);
-	void codegenX64(std::ostream& out) override;
+	void codegenX64(OutputSink& out) override;
 	Opd * getDst(){ return dst; }
 	Opd * getSrc1(){ return src1; }
 	Opd * getSrc2(){ return src2; }
 	BinOp getOp(){ return opr; }
+	Opd ** defSlot() override;
+	void useSlots(std::vector<Opd **>& slots) override;
 private:
 	Opd * dst;
 	BinOp opr;
@@ -287,10 +302,12 @@ class UnaryOpQuad : public Quad {
 public:
 	UnaryOpQuad(Opd * dstIn, UnaryOp opIn, Opd * srcIn);
 	std::string repr() override ;
-	void codegenX64(std::ostream& out) override;
+	void codegenX64(OutputSink& out) override;
 	Opd * getDst(){ return dst; }
 	Opd * getSrc(){ return src; }
 	UnaryOp getOp(){ return op; }
+	Opd ** defSlot() override;
+	void useSlots(std::vector<Opd **>& slots) override;
 private:
 	Opd * dst;
 	UnaryOp op;
@@ -302,9 +319,11 @@ class AssignQuad : public Quad{
 public:
 	AssignQuad(Opd * dstIn, Opd * srcIn, bool isRecord);
 	std::string repr() override;
-	void codegenX64(std::ostream& out) override;
+	void codegenX64(OutputSink& out) override;
 	Opd * getDst(){ return dst; }
 	Opd * getSrc(){ return src; }
+	Opd ** defSlot() override;
+	void useSlots(std::vector<Opd **>& slots) override;
 private:
 	Opd * dst;
 	Opd * src;
@@ -317,9 +336,15 @@ public:
 	: dst(dstIn), src(srcIn), off(offIn){
 	}
 	std::string repr() override;
-	void codegenX64(std::ostream& out) override;
+	void codegenX64(OutputSink& out) override;
+	Opd * getDst(){ return dst; }
+	Opd * getSrc(){ return src; }
+	Opd * getOff(){ return off; }
+	Opd ** defSlot() override{ return &dst; }
+	void useSlots(std::vector<Opd **>& slots) override;
 private:
-	AddrOpd * dst;
+	//Always an AddrOpd
+	Opd * dst;
 	Opd * src;
 	Opd * off;
 };
@@ -328,8 +353,9 @@ class GotoQuad : public Quad {
 public:
 	GotoQuad(Label * tgtIn);
 	std::string repr() override;
-	void codegenX64(std::ostream& out) override;
+	void codegenX64(OutputSink& out) override;
 	Label * getTarget(){ return tgt; }
+	void setTarget(Label * tgtIn){ tgt = tgtIn; }
 private:
 	Label * tgt;
 };
@@ -339,8 +365,12 @@ public:
 	IfzQuad(Opd * cndIn, Label * tgtIn);
 	std::string repr() override;
 	Label * getTarget(){ return tgt; }
+	void setTarget(Label * tgtIn){ tgt = tgtIn; }
 	Opd * getCnd(){ return cnd; }
-	void codegenX64(std::ostream& out) override;
+	void codegenX64(OutputSink& out) override;
+	void useSlots(std::vector<Opd **>& slots) override{
+		slots.push_back(&cnd);
+	}
 private:
 	Opd * cnd;
 	Label * tgt;
@@ -350,7 +380,7 @@ class NopQuad : public Quad {
 public:
 	NopQuad();
 	std::string repr() override;
-	void codegenX64(std::ostream& out) override;
+	void codegenX64(OutputSink& out) override;
 };
 
 class IntrinsicOutputQuad : public Quad {
@@ -359,7 +389,10 @@ public:
 	std::string repr() override;
 	Opd * getSrc(){ return myArg; }
 	const DataType * getType(){ return myType; }
-	void codegenX64(std::ostream& out) override;
+	void codegenX64(OutputSink& out) override;
+	void useSlots(std::vector<Opd **>& slots) override{
+		slots.push_back(&myArg);
+	}
 private:
 	Opd * myArg;
 	const DataType * myType;
@@ -370,7 +403,10 @@ public:
 	IntrinsicInputQuad(Opd * arg, const DataType * type);
 	std::string repr() override;
 	Opd * getDst(){ return myArg; }
-	void codegenX64(std::ostream& out) override;
+	const DataType * getType(){ return myType; }
+	void codegenX64(OutputSink& out) override;
+	Opd ** defSlot() override;
+	void useSlots(std::vector<Opd **>& slots) override;
 private:
 	Opd * myArg;
 	const DataType * myType;
@@ -380,16 +416,29 @@ class CallQuad : public Quad{
 public:
 	CallQuad(SemSymbol * calleeIn);
 	std::string repr() override;
-	void codegenX64(std::ostream& out) override;
+	SemSymbol * getCallee(){ return callee; }
+	void codegenX64(OutputSink& out) override;
 private:
 	SemSymbol * callee;
 };
+//A call in tail position. The caller's frame is gone by the time
+// the callee is jumped to, so the callee returns straight to the
+// caller's caller. Every argument must go in a register.
+class TailCallQuad : public CallQuad{
+public:
+	TailCallQuad(SemSymbol * calleeIn, Procedure * callerIn);
+	std::string repr() override;
+	void codegenX64(OutputSink& out) override;
+	Procedure * getCaller(){ return caller; }
+private:
+	Procedure * caller;
+};
 
 class EnterQuad : public Quad{
 public:
 	EnterQuad(Procedure * proc);
 	virtual std::string repr() override;
-	void codegenX64(std::ostream& out) override;
+	void codegenX64(OutputSink& out) override;
 private:
 	Procedure * myProc;
 };
@@ -398,7 +447,7 @@ class LeaveQuad : public Quad{
 public:
 	LeaveQuad(Procedure * proc);
 	virtual std::string repr() override;
-	void codegenX64(std::ostream& out) override;
+	void codegenX64(OutputSink& out) override;
 private:
 	Procedure * myProc;
 };
@@ -407,10 +456,13 @@ class SetArgQuad : public Quad{
 public:
 	SetArgQuad(size_t indexIn, Opd * opdIn, const DataType * typeIn);
 	std::string repr() override;
-	void codegenX64(std::ostream& out) override;
+	void codegenX64(OutputSink& out) override;
 	Opd * getSrc(){ return opd; }
 	size_t getIndex(){ return index; }
 	const DataType * getType(){ return type; }
+	void useSlots(std::vector<Opd **>& slots) override{
+		slots.push_back(&opd);
+	}
 private:
 	size_t index;
 	Opd * opd;
@@ -421,9 +473,11 @@ class GetArgQuad : public Quad{
 public:
 	GetArgQuad(size_t indexIn, size_t fsize, Opd * opdIn, bool isRecord);
 	std::string repr() override;
-	void codegenX64(std::ostream& out) override;
+	void codegenX64(OutputSink& out) override;
 	Opd * getDst(){ return opd; }
+	size_t getIndex(){ return index; }
 	bool isRecord(){ return myIsRecord; } 
+	Opd ** defSlot() override{ return &opd; }
 private:
 	size_t index, numFormals;
 	Opd * opd;
@@ -436,7 +490,10 @@ public:
 	std::string repr() override;
 	Opd * getSrc(){ return opd; }
 	bool isRecord(){ return myIsRecord; } 
-	void codegenX64(std::ostream& out) override;
+	void codegenX64(OutputSink& out) override;
+	void useSlots(std::vector<Opd **>& slots) override{
+		slots.push_back(&opd);
+	}
 private:
 	Opd * opd;
 	const bool myIsRecord;
@@ -447,13 +504,31 @@ public:
 	GetRetQuad(Opd * opdIn, bool isRecordIn);
 	std::string repr() override;
 	Opd * getDst(){ return opd; }
-	void codegenX64(std::ostream& out) override;
+	void codegenX64(OutputSink& out) override;
 	bool isRecord(){ return myIsRecord; } 
+	Opd ** defSlot() override{ return &opd; }
 private:
 	Opd * opd;
 	const bool myIsRecord;
 };
 
+//Only found in SSA form: dst takes the value of the source for
+// whichever predecessor of its block control came from, the i-th
+// source going with the block's i-th predecessor
+class PhiQuad : public Quad{
+public:
+	PhiQuad(Opd * dstIn, size_t numPreds);
+	std::string repr() override;
+	void codegenX64(OutputSink& out) override;
+	Opd * getDst(){ return dst; }
+	std::vector<Opd *>& getSrcs(){ return srcs; }
+	Opd ** defSlot() override{ return &dst; }
+	void useSlots(std::vector<Opd **>& slots) override;
+private:
+	Opd * dst;
+	std::vector<Opd *> srcs;
+};
+
 class Procedure{
 public:
 	Procedure(IRProgram * prog, std::string name);
@@ -472,14 +547,29 @@ public:
 	void gatherFormal(SemSymbol * sym);
 	SymOpd * getSymOpd(SemSymbol * sym);
 	AuxOpd * makeTmp(size_t width);
+	AuxOpd * makeTmp(size_t width, const std::string& name);
 	AddrOpd * makeAddrOpd(size_t width);
-
-	std::string toString(bool verbose=false); 
+	//A new local like one of another procedure's, for code
+	// inlined from it. It is not one of this procedure's own
+	// symbols, so getSymOpd() and isLocal() do not know it.
+	SymOpd * inlineLocal(SymOpd * orig);
+	//Whether opd is one of this procedure's formals or locals
+	bool isLocal(Opd * opd);
+	//Forget the locals, temps and address temps no quad uses any
+	// more, so they take no stack space
+	void dropUnusedOpds();
+
+	void print(OutputSink& out, bool verbose=false);
 	std::string getName();
 
 	cshanty::Label * getLeaveLabel();
+	//The label on the first quad after the GetArgQuads, which a
+	// call of the procedure from its own tail jumps to. It is
+	// made on first use; FnDeclNode places it.
+	cshanty::Label * getBodyLabel();
+	bool hasBodyLabel(){ return bodyLabel != nullptr; }
 
-	void toX64(std::ostream& out);
+	void toX64(OutputSink& out);
 	size_t arSize() const;
 	size_t numTemps() const;
 
@@ -492,9 +582,13 @@ private:
 	EnterQuad * enter;
 	LeaveQuad * leave;
 	Label * leaveLabel;
+	Label * bodyLabel = nullptr;
 
 	IRProgram * myProg;
-	std::map<SemSymbol *, SymOpd *> locals;
+	//Locals in the order they were gathered (i.e. declaration
+	// order), which is the order they are listed and laid out in
+	std::vector<SymOpd *> locals;
+	HashMap<SemSymbol *, SymOpd *> localOpds;
 	std::list<AuxOpd *> temps; 
 	std::list<SymOpd *> formals; 
 	std::list<AddrOpd *> addrOpds;
@@ -518,19 +612,22 @@ public:
 	const DataType * nodeType(ASTNode * node);
 	std::set<Opd *> globalSyms();
 
-	std::string toString(bool verbose=false);
+	void print(OutputSink& out, bool verbose=false);
 
-	void toX64(std::ostream& out);
+	void toX64(OutputSink& out);
 private:
 	TypeAnalysis * ta;
 	size_t max_label = 0;
 	size_t str_idx = 0;
 	std::list<Procedure *> * procs; 
-	HashMap<LitOpd *, std::string> strings;
-	std::map<SemSymbol *, SymOpd *> globals;
-
-	void datagenX64(std::ostream& out);
-	void allocGlobals(std::ostream& out);
+	//Both kept in creation order, so that output does not depend
+	// on where things happened to be allocated
+	std::vector<std::pair<LitOpd *, std::string>> strings;
+	std::vector<SymOpd *> globals;
+	HashMap<SemSymbol *, SymOpd *> globalOpds;
+
+	void datagenX64(OutputSink& out);
+	void allocGlobals(OutputSink& out);
 };
 
 }
@@ -1,22 +1,24 @@
+#include <algorithm>
 #include "ast.hpp"
+#include "trace.hpp"
 
 namespace cshanty{
 
 IRProgram * ProgramNode::to3AC(TypeAnalysis * ta){
 	IRProgram * prog = new IRProgram(ta);
-	for (auto global : *myGlobals){
+	for (auto global : myGlobals){
 		global->to3AC(prog);
 	}
 	return prog;
 }
 
 static void formalsTo3AC(Procedure * proc, 
-  std::list<FormalDeclNode *> * myFormals){
-	for (auto formal : *myFormals){
+  Span<FormalDeclNode *> myFormals){
+	for (auto formal : myFormals){
 		formal->to3AC(proc);
 	}
 	unsigned int argIdx = 1;
-	for (auto formal : *myFormals){
+	for (auto formal : myFormals){
 		SemSymbol * sym = formal->ID()->getSymbol();
 		SymOpd * opd = proc->getSymOpd(sym);
 		bool recordFormal = false;
@@ -24,7 +26,7 @@ static void formalsTo3AC(Procedure * proc,
 			recordFormal = true;
 		}
 		
-		Quad * inQuad = new GetArgQuad(argIdx, myFormals->size(), opd, recordFormal);
+		Quad * inQuad = new GetArgQuad(argIdx, myFormals.size(), opd, recordFormal);
 		proc->addQuad(inQuad);
 		argIdx += 1;
 	}
@@ -33,14 +35,23 @@ static void formalsTo3AC(Procedure * proc,
 void FnDeclNode::to3AC(IRProgram * prog){
 
 	SemSymbol * mySym = this->ID()->getSymbol();
+	TRACE_SPAN("FnDeclNode::to3AC", mySym->getName());
 	Procedure * proc = prog->makeProc(mySym->getName());
 
 	//Generate the getin quads
 	formalsTo3AC(proc, myFormals);
 
-	for (auto stmt : *myBody){
+	for (auto stmt : myBody){
 		stmt->to3AC(proc);
 	}
+
+	if (proc->hasBodyLabel()){
+		auto top = proc->getQuads()->begin();
+		std::advance(top, myFormals.size());
+		Quad * nop = new NopQuad();
+		nop->addLabel(proc->getBodyLabel());
+		proc->getQuads()->insert(top, nop);
+	}
 }
 
 void FnDeclNode::to3AC(Procedure * proc){
@@ -104,9 +115,9 @@ Opd * AssignExpNode::flatten(Procedure * proc){
 	return lhs;
 }
 
-static void argsTo3AC(Procedure * proc, std::list<ExpNode *> * args){
+static void argsTo3AC(Procedure * proc, Span<ExpNode *> args){
 	std::list<std::pair<Opd *, const DataType *>> argOpds;
-	for (auto argNode : *args){
+	for (auto argNode : args){
 		Opd * argOpd = argNode->flatten(proc);
 		const DataType * argType = proc->getProg()->nodeType(argNode);
 		argOpds.push_back(std::make_pair(argOpd, argType));
@@ -137,6 +148,72 @@ Opd * CallExpNode::flatten(Procedure * proc){
 	}
 }
 
+bool CallExpNode::tailCallTo3AC(Procedure * proc){
+	SemSymbol * idSym = myID->getSymbol();
+	const FnType * calleeType = idSym->getDataType()->asFn();
+	if (calleeType->getReturnType()->isRecord()){ return false; }
+	if (idSym->getName() == proc->getName()){
+		return selfTailCallTo3AC(proc);
+	}
+
+	//Arguments past the sixth go on the stack, in the frame being
+	// dropped, and a record goes by the address of a copy in it
+	if (myArgs.size() > 6){ return false; }
+	for (auto argNode : myArgs){
+		if (proc->getProg()->nodeType(argNode)->isRecord()){ return false; }
+	}
+	argsTo3AC(proc, myArgs);
+	proc->addQuad(new TailCallQuad(idSym, proc));
+	proc->addQuad(new GotoQuad(proc->getLeaveLabel()));
+	return true;
+}
+
+//A call of the procedure itself becomes a loop: the formals are
+// given the arguments' values, and the body starts over
+bool CallExpNode::selfTailCallTo3AC(Procedure * proc){
+	std::list<SymOpd *> formals = proc->getFormals();
+	auto formal = formals.begin();
+	for (auto argNode : myArgs){
+		//A record formal can only be passed on as it is, since
+		// there is nowhere else to copy another record from
+		if ((*formal)->getSym()->getDataType()->isRecord()){
+			IDNode * id = dynamic_cast<IDNode *>(argNode);
+			if (id == nullptr || id->getSymbol() != (*formal)->getSym()){
+				return false;
+			}
+		}
+		formal++;
+	}
+
+	std::vector<Opd *> vals;
+	formal = formals.begin();
+	for (auto argNode : myArgs){
+		Opd * val = argNode->flatten(proc);
+		//A formal read as it is would be read after the ones
+		// before it are given their new values
+		bool otherFormal = val != *formal
+			&& std::find(formals.begin(), formals.end(), val) != formals.end();
+		if (otherFormal){
+			Opd * tmp = proc->makeTmp(val->getWidth());
+			proc->addQuad(new AssignQuad(tmp, val, false));
+			val = tmp;
+		}
+		vals.push_back(val);
+		formal++;
+	}
+	formal = formals.begin();
+	for (Opd * val : vals){
+		if (val != *formal){
+			proc->addQuad(new AssignQuad(*formal, val, false));
+		}
+		formal++;
+	}
+	Quad * jump = new GotoQuad(proc->getBodyLabel());
+	jump->setComment("Tail call");
+	proc->addQuad(jump);
+	return true;
+}
+
 /*
 Opd * ByteToIntNode::flatten(Procedure * proc){
 	Opd * child = myChild->flatten(proc);
@@ -348,7 +425,7 @@ void IfStmtNode::to3AC(Procedure * proc){
 	afterNop->addLabel(afterLabel);
 
 	proc->addQuad(new IfzQuad(cond, afterLabel));
-	for (auto stmt : *myBody){
+	for (auto stmt : myBody){
 		stmt->to3AC(proc);
 	}
 	proc->addQuad(afterNop);
@@ -366,7 +443,7 @@ void IfElseStmtNode::to3AC(Procedure * proc){
 
 	Quad * jmpFalse = new IfzQuad(cond, elseLabel);
 	proc->addQuad(jmpFalse);
-	for (auto stmt : *myBodyTrue){
+	for (auto stmt : myBodyTrue){
 		stmt->to3AC(proc);
 	}
 	
@@ -375,7 +452,7 @@ void IfElseStmtNode::to3AC(Procedure * proc){
 
 	proc->addQuad(elseNop);
 	
-	for (auto stmt : *myBodyFalse){
+	for (auto stmt : myBodyFalse){
 		stmt->to3AC(proc);
 	}
 
@@ -396,7 +473,7 @@ void WhileStmtNode::to3AC(Procedure * proc){
 	Quad * jmpFalse = new IfzQuad(cond, afterLabel);
 	proc->addQuad(jmpFalse);
 
-	for (auto stmt : *myBody){
+	for (auto stmt : myBody){
 		stmt->to3AC(proc);
 	}
 
@@ -419,6 +496,8 @@ void CallStmtNode::to3AC(Procedure * proc){
 }
 
 void ReturnStmtNode::to3AC(Procedure * proc){
+	CallExpNode * call = dynamic_cast<CallExpNode *>(myExp);
+	if (call != nullptr && call->tailCallTo3AC(proc)){ return; }
 	if (myExp != nullptr){
 		Opd * res = myExp->flatten(proc);
 		
@@ -465,7 +544,7 @@ Opd * IndexNode::flatten(Procedure * proc){
 	assert(recordType != nullptr);
 	
 	//Opd * offOpd = myIdx->flatten(proc);
-	size_t offsetVal = recordType->getOffset(myIdx->getName());
+	size_t offsetVal = recordType->getField(myField).offset;
 	size_t width = 8;
 	LitOpd * offOpd = new LitOpd(to_string(offsetVal), 8);
 	
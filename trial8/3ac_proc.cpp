@@ -1,4 +1,5 @@
 #include "3ac.hpp"
+#include "dataflow.hpp"
 #include <algorithm>
 
 namespace cshanty{
@@ -26,42 +27,51 @@ Label * Procedure::getLeaveLabel(){
 	return leaveLabel;
 }
 
-IRProgram * Procedure::getProg(){ return myProg; }
+Label * Procedure::getBodyLabel(){
+	if (bodyLabel == nullptr){ bodyLabel = myProg->makeLabel(); }
+	return bodyLabel;
+}
 
-std::string Procedure::toString(bool verbose){
-	std::string res = "";
+IRProgram * Procedure::getProg(){ return myProg; }
 
-	res += "[BEGIN " + this->getName() + " LOCALS]\n";
+void Procedure::print(OutputSink& out, bool verbose){
+	out << "[BEGIN " << this->getName() << " LOCALS]\n";
 	for (const auto formal : this->formals){
-		res += formal->getName() + " (formal arg of " 
-			+ std::to_string(formal->getWidth()) + ")\n";
-			+ " bytes)\n";
+		out << formal->getName() << " (formal arg of " 
+			<< formal->getWidth() << ")\n";
 	}
 
 	for (auto local : this->locals){
-		res += local.second->getName() + " (local var of "
-			+ std::to_string(local.second->getWidth())
-			+ " bytes)\n";
+		out << local->getName() << " (local var of "
+			<< local->getWidth()
+			<< " bytes)\n";
 	}
 
 	for (auto tmp : temps){
-		res += tmp->locString() + " (tmp var of "
-			+ std::to_string(tmp->getWidth())
-			+ " bytes)\n";
+		out << tmp->locString() << " (tmp var of "
+			<< tmp->getWidth()
+			<< " bytes)\n";
 	}
 	for (auto loc : this->addrOpds){
-		res += loc->locString() + " (tmp loc of "
-			+ std::to_string(loc->getWidth())
-			+ " bytes)\n";
+		out << loc->locString() << " (tmp loc of "
+			<< loc->getWidth()
+			<< " bytes)\n";
 	}
-	res += "[END " + this->getName() + " LOCALS]\n";
+	out << "[END " << this->getName() << " LOCALS]\n";
 
-	res += enter->toString(verbose) + "\n";
+	HashMap<Quad *, std::vector<std::string>> notes;
+	if (verbose){ notes = Dataflow::annotate(this); }
+	enter->print(out, verbose);
 	for (auto quad : *bodyQuads){
-		res += quad->toString(verbose) + "\n";
+		auto found = notes.find(quad);
+		if (found != notes.end()){
+			for (const std::string& line : found->second){
+				out << "            " << line << '\n';
+			}
+		}
+		quad->print(out, verbose);
 	}
-	res += leave->toString(verbose) + "\n";
-	return res;
+	leave->print(out, verbose);
 }
 
 Label * Procedure::makeLabel(){
@@ -80,7 +90,9 @@ Quad * Procedure::popQuad(){
 
 void Procedure::gatherLocal(SemSymbol * sym){
 	size_t width = Opd::width(sym->getDataType());
-	locals[sym] = new SymOpd(sym, width);
+	SymOpd * opd = new SymOpd(sym, width);
+	locals.push_back(opd);
+	localOpds[sym] = opd;
 }
 
 void Procedure::gatherFormal(SemSymbol * sym){
@@ -95,8 +107,8 @@ SymOpd * Procedure::getSymOpd(SemSymbol * sym){
 		}
 	}
 
-	auto localFound = locals.find(sym);
-	if (localFound != locals.end()){
+	auto localFound = localOpds.find(sym);
+	if (localFound != localOpds.end()){
 		return localFound->second;
 	}
 	
@@ -112,6 +124,51 @@ AuxOpd * Procedure::makeTmp(size_t width){
 	return res;
 }
 
+AuxOpd * Procedure::makeTmp(size_t width, const std::string& name){
+	AuxOpd * res = new AuxOpd(name, width);
+	temps.push_back(res);
+	return res;
+}
+
+SymOpd * Procedure::inlineLocal(SymOpd * orig){
+	SymOpd * opd = new SymOpd(orig->mySym, orig->getWidth());
+	locals.push_back(opd);
+	return opd;
+}
+
+bool Procedure::isLocal(Opd * opd){
+	SymOpd * symOpd = dynamic_cast<SymOpd *>(opd);
+	if (symOpd == nullptr){ return false; }
+	for (SymOpd * formal : formals){
+		if (formal == symOpd){ return true; }
+	}
+	auto found = localOpds.find(symOpd->mySym);
+	return found != localOpds.end() && found->second == symOpd;
+}
+
+void Procedure::dropUnusedOpds(){
+	std::set<Opd *> used;
+	std::vector<Opd **> slots;
+	for (Quad * quad : *bodyQuads){
+		slots.clear();
+		quad->useSlots(slots);
+		for (Opd ** slot : slots){ used.insert(*slot); }
+		if (Opd ** def = quad->defSlot()){ used.insert(*def); }
+	}
+	auto unused = [&used](Opd * opd){ return used.count(opd) == 0; };
+	temps.remove_if(unused);
+	addrOpds.remove_if(unused);
+	std::vector<SymOpd *> keptLocals;
+	for (SymOpd * local : locals){
+		if (used.count(local) != 0){
+			keptLocals.push_back(local);
+		} else if (isLocal(local)){
+			localOpds.erase(local->mySym);
+		}
+	}
+	locals.swap(keptLocals);
+}
+
 AddrOpd * Procedure::makeAddrOpd(size_t width){
 	std::string name = "addrTmp";
 	name += std::to_string(maxTmp++);
@@ -128,7 +185,7 @@ size_t Procedure::numTemps() const{
 size_t Procedure::arSize() const{
 	size_t size = 0;
 	for (auto local : locals){
-		size += local.second->getWidth();
+		size += local->getWidth();
 	}
 	for (auto tmp : temps){
 		size += tmp->getWidth();
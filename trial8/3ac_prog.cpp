@@ -28,8 +28,9 @@ Label * IRProgram::makeLabel(){
 }
 
 SymOpd * IRProgram::getGlobal(SemSymbol * sym){
-	if (globals.find(sym) != globals.end()){
-		return globals[sym];
+	auto found = globalOpds.find(sym);
+	if (found != globalOpds.end()){
+		return found->second;
 	} 
 	return nullptr;
 }
@@ -37,40 +38,39 @@ SymOpd * IRProgram::getGlobal(SemSymbol * sym){
 void IRProgram::gatherGlobal(SemSymbol * sym){
 	size_t width = Opd::width(sym->getDataType());
 	SymOpd * res = new SymOpd(sym, width);
-	globals[sym] = res;
+	globals.push_back(res);
+	globalOpds[sym] = res;
 }
 
 Opd * IRProgram::makeString(std::string val){
 	std::string name = "str_" + std::to_string(str_idx++);
 	LitOpd * opd = new LitOpd(name, 8);
-	strings[opd] = val;
+	strings.push_back(std::make_pair(opd, val));
 	return opd;
 }
 
-std::string IRProgram::toString(bool verbose){
-	std::string res = "";
-	res += "[BEGIN GLOBALS]\n";
-	for (auto entry : globals){
-		res += entry.second->getName() + "\n"; 
+void IRProgram::print(OutputSink& out, bool verbose){
+	out << "[BEGIN GLOBALS]\n";
+	for (auto global : globals){
+		out << global->getName() << "\n"; 
 	}
 	for (auto entry : strings){
-		res += entry.first->valString();
-		res += " " + entry.second; 
-		res += "\n";
+		out << entry.first->valString();
+		out << " " << entry.second; 
+		out << "\n";
 	}
 
-	res += "[END GLOBALS]\n";
+	out << "[END GLOBALS]\n";
 
 	for (Procedure * proc : *procs){
-		res += proc->toString(verbose);
+		proc->print(out, verbose);
 	}
-	return res;
 }
 
 std::set<Opd *> IRProgram::globalSyms(){
 	std::set<Opd *> result;
-	for (auto gItr : globals){
-		result.insert(gItr.second);
+	for (auto global : globals){
+		result.insert(global);
 	}
 	return result;
 }
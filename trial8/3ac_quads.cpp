@@ -23,33 +23,30 @@ std::string Quad::commentStr(){
 	return "";
 }
 
-std::string Quad::toString(bool verbose){
-	auto res = std::string("");
-
-	auto first = true;
-
+void Quad::print(OutputSink& out, bool verbose){
 	size_t labelSpace = 12;
+	size_t width = 0;
+	auto first = true;
 	for (auto label : labels){
 		if (first){ first = false; }
-		else { res += ","; }
+		else { out << ','; width++; }
 
-		res += label->getName();
+		const std::string& name = label->getName();
+		out << name;
+		width += name.length();
 	}
-	if (!first){ res += ": "; }
-	else { res += "  "; }
-	size_t spaces;
-	if (res.length() > labelSpace){ spaces = 0; }
-	else { spaces = labelSpace - res.length(); }
-	for (size_t i = 0; i < spaces; i++){
-		res += " ";
+	if (!first){ out << ": "; }
+	else { out << "  "; }
+	width += 2;
+	for (size_t i = width; i < labelSpace; i++){
+		out << ' ';
 	}
 
-	res += this->repr();
-	if (verbose){
-		res += commentStr();
+	out << this->repr();
+	if (verbose && myComment.length() > 0){
+		out << "  #" << myComment;
 	}
-
-	return res;
+	out << '\n';
 }
 
 CallQuad::CallQuad(SemSymbol * calleeIn) : callee(calleeIn){ }
@@ -58,6 +55,13 @@ std::string CallQuad::repr(){
 	return "call " + callee->getName();
 }
 
+TailCallQuad::TailCallQuad(SemSymbol * calleeIn, Procedure * callerIn)
+: CallQuad(calleeIn), caller(callerIn){ }
+
+std::string TailCallQuad::repr(){
+	return "tailcall " + getCallee()->getName();
+}
+
 EnterQuad::EnterQuad(Procedure * procIn)
 : Quad(), myProc(procIn) { }
 
@@ -104,6 +108,9 @@ std::string BinOpQuad::oprString(BinOp opr){
 	case GT64: return "GT64";  
 	case LTE64: return "LTE64";  
 	case GTE64: return "GTE64";  
+	case SHL64: return "SHL64";
+	case SAR64: return "SAR64";
+	case SHR64: return "SHR64";
 	} 
 	throw InternalError("No such opd");
 
@@ -225,4 +232,66 @@ std::string IndexQuad::repr(){
 	return res;
 }
 
+PhiQuad::PhiQuad(Opd * dstIn, size_t numPreds)
+: dst(dstIn), srcs(numPreds, nullptr){ }
+
+std::string PhiQuad::repr(){
+	std::string res = dst->valString() + " := PHI";
+	for (Opd * src : srcs){
+		res += " ";
+		res += src == nullptr ? "?" : src->valString();
+	}
+	return res;
+}
+
+//A destination that is an AddrOpd is written through, so the
+// quad defines no operand there but reads the address
+static Opd ** valueSlot(Opd *& dst){
+	if (dynamic_cast<AddrOpd *>(dst) != nullptr){ return nullptr; }
+	return &dst;
+}
+
+static void addressSlot(Opd *& dst, std::vector<Opd **>& slots){
+	if (dynamic_cast<AddrOpd *>(dst) != nullptr){ slots.push_back(&dst); }
+}
+
+Opd ** BinOpQuad::defSlot(){ return valueSlot(dst); }
+
+void BinOpQuad::useSlots(std::vector<Opd **>& slots){
+	slots.push_back(&src1);
+	slots.push_back(&src2);
+	addressSlot(dst, slots);
+}
+
+Opd ** UnaryOpQuad::defSlot(){ return valueSlot(dst); }
+
+void UnaryOpQuad::useSlots(std::vector<Opd **>& slots){
+	slots.push_back(&src);
+	addressSlot(dst, slots);
+}
+
+Opd ** AssignQuad::defSlot(){ return valueSlot(dst); }
+
+void AssignQuad::useSlots(std::vector<Opd **>& slots){
+	slots.push_back(&src);
+	addressSlot(dst, slots);
+}
+
+void IndexQuad::useSlots(std::vector<Opd **>& slots){
+	slots.push_back(&src);
+	slots.push_back(&off);
+}
+
+Opd ** IntrinsicInputQuad::defSlot(){ return valueSlot(myArg); }
+
+void IntrinsicInputQuad::useSlots(std::vector<Opd **>& slots){
+	addressSlot(myArg, slots);
+}
+
+void PhiQuad::useSlots(std::vector<Opd **>& slots){
+	for (Opd *& src : srcs){
+		slots.push_back(&src);
+	}
+}
+
 }
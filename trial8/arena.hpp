@@ -0,0 +1,133 @@
+#ifndef CSHANTY_ARENA_HPP
+#define CSHANTY_ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "errors.hpp"
+
+namespace cshanty{
+
+//A fixed-length run of elements stored contiguously (normally
+// inside an Arena). The AST uses spans for its child sequences
+// so that traversals walk an array instead of chasing list nodes.
+template <typename T>
+class Span{
+public:
+	Span() : myData(nullptr), mySize(0){ }
+	Span(T * dataIn, size_t sizeIn) : myData(dataIn), mySize(sizeIn){ }
+	T * begin() const { return myData; }
+	T * end() const { return myData + mySize; }
+	size_t size() const { return mySize; }
+	bool empty() const { return mySize == 0; }
+	T& front() const { return myData[0]; }
+	T& back() const { return myData[mySize - 1]; }
+	T& operator[](size_t idx) const { return myData[idx]; }
+private:
+	T * myData;
+	size_t mySize;
+};
+
+//A bump allocator that owns every object created for one
+// compilation (AST nodes, their positions, child spans and
+// identifier text). Objects are never freed individually; the
+// whole arena is released at once when it is destroyed, without
+// visiting the objects in it. For that to be safe, everything
+// built with make() must be trivially destructible.
+class Arena{
+public:
+	Arena(size_t blockSizeIn = 64 * 1024)
+	: blockSize(blockSizeIn), cur(nullptr), limit(nullptr), used(0),
+	  nodes(0){ }
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+	~Arena(){
+		for (char * block : blocks){ free(block); }
+	}
+
+	void * alloc(size_t size, size_t align){
+		size_t pad = (align - (reinterpret_cast<size_t>(cur) % align)) % align;
+		if (cur == nullptr || pad + size > static_cast<size_t>(limit - cur)){
+			newBlock(size + align);
+			pad = (align - (reinterpret_cast<size_t>(cur) % align)) % align;
+		}
+		char * res = cur + pad;
+		cur = res + size;
+		used += pad + size;
+		return res;
+	}
+
+	template <typename T, typename... Args>
+	T * make(Args&&... args){
+		static_assert(std::is_trivially_destructible<T>::value,
+			"Arena objects are released without running destructors");
+		void * mem = alloc(sizeof(T), alignof(T));
+		return new (mem) T(std::forward<Args>(args)...);
+	}
+
+	//Make an AST node and give it the next dense ID. IDs count
+	// up from 0 in each arena, so analyses can keep per-node
+	// results in vectors indexed by ID instead of in maps keyed
+	// by node pointer.
+	template <typename T, typename... Args>
+	T * makeNode(Args&&... args){
+		T * res = make<T>(std::forward<Args>(args)...);
+		res->myNodeID = nodes++;
+		return res;
+	}
+	//How many nodes have been made so far (one past the last ID)
+	uint32_t nodeCount() const { return nodes; }
+
+	//Copy a (parser-built) vector into contiguous arena storage
+	// and release the vector.
+	template <typename T>
+	Span<T> seal(std::vector<T> * elts){
+		if (elts == nullptr){ return Span<T>(); }
+		size_t count = elts->size();
+		T * data = nullptr;
+		if (count > 0){
+			data = static_cast<T *>(alloc(sizeof(T) * count, alignof(T)));
+			for (size_t i = 0; i < count; i++){
+				new (data + i) T((*elts)[i]);
+			}
+		}
+		delete elts;
+		return Span<T>(data, count);
+	}
+
+	//Copy a string into the arena, returning a NUL-terminated
+	// pointer that lives as long as the arena.
+	const char * str(const std::string& text){
+		char * res = static_cast<char *>(alloc(text.size() + 1, 1));
+		memcpy(res, text.c_str(), text.size() + 1);
+		return res;
+	}
+
+	size_t bytesUsed() const { return used; }
+private:
+	void newBlock(size_t atLeast){
+		size_t size = atLeast > blockSize ? atLeast : blockSize;
+		char * block = static_cast<char *>(malloc(size));
+		if (block == nullptr){ throw std::bad_alloc(); }
+		blocks.push_back(block);
+		cur = block;
+		limit = block + size;
+	}
+
+	size_t blockSize;
+	char * cur;
+	char * limit;
+	size_t used;
+	uint32_t nodes;
+	std::vector<char *> blocks;
+};
+
+}
+
+#endif
@@ -8,10 +8,14 @@
 #include "tokens.hpp"
 #include "types.hpp"
 #include "3ac.hpp"
+#include "arena.hpp"
+#include "output_sink.hpp"
 
 namespace cshanty {
 
 class TypeAnalysis;
+class ASTWriter;
+class ASTReader;
 
 class Opd;
 
@@ -31,33 +35,40 @@ class IDNode;
 class ASTNode{
 public:
 	ASTNode(Position * pos) : myPos(pos){ }
-	virtual void unparse(std::ostream&, int) = 0;
-	virtual void transpileToC(std::ostream&, int) = 0;
+	//Dense per-compilation ID, handed out by Arena::makeNode
+	uint32_t nodeID() const { return myNodeID; }
+	virtual void unparse(OutputSink&, int) = 0;
+	virtual void transpileToC(OutputSink&, int) = 0;
 	Position * pos() { return myPos; };
 	std::string posStr(){ return pos()->span(); }
 	virtual bool nameAnalysis(SymbolTable *) = 0;
+	virtual void serialize(ASTWriter *) = 0;
 protected:
 	Position * myPos = nullptr;
+private:
+	friend class Arena;
+	uint32_t myNodeID = 0;
 };
 
 class ProgramNode : public ASTNode{
 public:
-	ProgramNode(std::list<DeclNode *> * globalsIn);
-	void unparse(std::ostream&, int) override;
-	void transpileToC(std::ostream&, int) override;
+	ProgramNode(Position * p, Span<DeclNode *> globalsIn);
+	void unparse(OutputSink&, int) override;
+	void transpileToC(OutputSink&, int) override;
+	void serialize(ASTWriter *) override;
 	virtual bool nameAnalysis(SymbolTable *) override;
 	virtual void typeAnalysis(TypeAnalysis *);
 	IRProgram * to3AC(TypeAnalysis * ta);
 private:
-	std::list<DeclNode *> * myGlobals;
+	Span<DeclNode *> myGlobals;
 };
 
 class ExpNode : public ASTNode{
 protected:
 	ExpNode(Position * p) : ASTNode(p){ }
 public:
-	virtual void unparseNested(std::ostream& out);
-	virtual void transpileToCNested(std::ostream& out);
+	virtual void unparseNested(OutputSink& out);
+	virtual void transpileToCNested(OutputSink& out);
 	virtual bool nameAnalysis(SymbolTable * symTab) override = 0;
 	virtual void typeAnalysis(TypeAnalysis *) = 0;
 	virtual Opd * flatten(Procedure * proc) = 0;
@@ -66,10 +77,10 @@ public:
 class LValNode : public ExpNode{
 public:
 	LValNode(Position * p) : ExpNode(p){}
-	void unparse(std::ostream& out, int indent) override = 0;
-	void unparseNested(std::ostream& out) override;
-	void transpileToC(std::ostream& out, int indent) override = 0;
-	void transpileToCNested(std::ostream& out) override;
+	void unparse(OutputSink& out, int indent) override = 0;
+	void unparseNested(OutputSink& out) override;
+	void transpileToC(OutputSink& out, int indent) override = 0;
+	void transpileToCNested(OutputSink& out) override;
 	bool nameAnalysis(SymbolTable * symTab) override { return false; }
 	virtual void typeAnalysis(TypeAnalysis *) override {; } 
 	virtual Opd * flatten(Procedure * proc) override = 0;
@@ -77,18 +88,20 @@ public:
 
 class IDNode : public LValNode{
 public:
-	IDNode(Position * p, std::string nameIn)
+	//The name text is owned by the compilation's arena
+	IDNode(Position * p, const char * nameIn)
 	: LValNode(p), name(nameIn), mySymbol(nullptr){}
 	std::string getName(){ return name; }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream&, int) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink&, int) override;
+	void serialize(ASTWriter *) override;
 	void attachSymbol(SemSymbol * symbolIn);
 	SemSymbol * getSymbol() const { return mySymbol; }
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * proc) override;
 private:
-	std::string name;
+	const char * name;
 	SemSymbol * mySymbol;
 };
 
@@ -96,28 +109,33 @@ class IndexNode : public LValNode{
 public:
 	IndexNode(Position * p, IDNode * base, IDNode * idx)
 	: LValNode(p), myBase(base), myIdx(idx){ }
-	virtual void unparseNested(std::ostream& out) override{
+	virtual void unparseNested(OutputSink& out) override{
 		unparse(out, 0);
 	}
-	void unparse(std::ostream& out, int indent) override;
-	virtual void transpileToCNested(std::ostream& out) override{
+	void unparse(OutputSink& out, int indent) override;
+	virtual void transpileToCNested(OutputSink& out) override{
 		transpileToC(out, 0);
 	}
-	void transpileToC(std::ostream& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * prog) override;
 	bool isString() const { return myIdx->getSymbol()->getDataType()->isString(); }
 private:
+	friend class ASTReader;
 	IDNode * myBase;
 	IDNode * myIdx;
+	//Which field of the base's record myIdx names, resolved by
+	// type analysis
+	size_t myField = RecordType::NO_FIELD;
 };
 
 class TypeNode : public ASTNode{
 public:
 	TypeNode(Position * p) : ASTNode(p){ }
-	void unparse(std::ostream&, int) override = 0;
-	void transpileToC(std::ostream&, int) override = 0;
+	void unparse(OutputSink&, int) override = 0;
+	void transpileToC(OutputSink&, int) override = 0;
 	virtual const DataType * getType() = 0;
 	virtual bool nameAnalysis(SymbolTable *) override;
 	virtual void typeAnalysis(TypeAnalysis *);
@@ -127,12 +145,14 @@ class RecordTypeNode : public TypeNode{
 public:
 	RecordTypeNode(Position * p, IDNode * IDin)
 	:TypeNode(p), myID(IDin) { }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	virtual const DataType * getType() override { return myType; }
 	virtual bool nameAnalysis(SymbolTable *) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 private:
+	friend class ASTReader;
 	IDNode * myID;
 	const RecordType * myType;
 };
@@ -140,8 +160,8 @@ private:
 class StmtNode : public ASTNode{
 public:
 	StmtNode(Position * p) : ASTNode(p){ }
-	virtual void unparse(std::ostream& out, int indent) override = 0;
-	virtual void transpileToC(std::ostream& out, int indent) override = 0;
+	virtual void unparse(OutputSink& out, int indent) override = 0;
+	virtual void transpileToC(OutputSink& out, int indent) override = 0;
 	virtual void typeAnalysis(TypeAnalysis *) = 0;
 	virtual void to3AC(Procedure * proc) = 0;
 };
@@ -149,8 +169,8 @@ public:
 class DeclNode : public StmtNode{
 public:
 	DeclNode(Position * p) : StmtNode(p){ }
-	void unparse(std::ostream& out, int indent) override =0;
-	void transpileToC(std::ostream& out, int indent) override = 0;
+	void unparse(OutputSink& out, int indent) override =0;
+	void transpileToC(OutputSink& out, int indent) override = 0;
 	virtual void typeAnalysis(TypeAnalysis *) override = 0;
 	virtual void to3AC(IRProgram * prog) = 0;
 	virtual void to3AC(Procedure * proc) override = 0;
@@ -160,11 +180,15 @@ class VarDeclNode : public DeclNode{
 public:
 	VarDeclNode(Position * p, TypeNode * typeIn, IDNode * IDIn)
 	: DeclNode(p), myType(typeIn), myID(IDIn){ }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	IDNode * ID(){ return myID; }
 	TypeNode * getTypeNode(){ return myType; }
 	bool nameAnalysis(SymbolTable * symTab) override;
+	//Declare the variable once its type node has been analyzed,
+	// typeOK saying whether that worked
+	bool declare(SymbolTable * symTab, bool typeOK);
 	void typeAnalysis(TypeAnalysis *) override;
 	virtual void to3AC(Procedure * proc) override;
 	virtual void to3AC(IRProgram * prog) override;
@@ -175,10 +199,11 @@ private:
 
 class RecordTypeDeclNode : public DeclNode{
 public:
-	RecordTypeDeclNode(Position *p, IDNode *id, std::list<VarDeclNode*> *body)
+	RecordTypeDeclNode(Position *p, IDNode *id, Span<VarDeclNode *> body)
 	: DeclNode(p), myID(id), myFields(body){ }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	TypeNode * getTypeNode(){ return nullptr; }
 	bool nameAnalysis(SymbolTable * symTab) override;
 	void typeAnalysis(TypeAnalysis * typing) override;
@@ -186,15 +211,16 @@ public:
 	virtual void to3AC(IRProgram * prog) override;
 private:
 	IDNode * myID;
-	std::list<VarDeclNode *> * myFields;
+	Span<VarDeclNode *> myFields;
 };
 
 class FormalDeclNode : public VarDeclNode{
 public:
 	FormalDeclNode(Position * p, TypeNode * type, IDNode * id) 
 	: VarDeclNode(p, type, id){ }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	virtual void to3AC(Procedure * proc) override;
 	virtual void to3AC(IRProgram * prog) override;
 };
@@ -203,19 +229,25 @@ class FnDeclNode : public DeclNode{
 public:
 	FnDeclNode(Position * p, 
 	  TypeNode * retTypeIn, IDNode * idIn,
-	  std::list<FormalDeclNode *> * formalsIn,
-	  std::list<StmtNode *> * bodyIn)
+	  Span<FormalDeclNode *> formalsIn,
+	  Span<StmtNode *> bodyIn)
 	: DeclNode(p), myRetType(retTypeIn), myID(idIn),
 	  myFormals(formalsIn), myBody(bodyIn){ 
 	}
 	IDNode * ID() const { return myID; }
-	std::list<FormalDeclNode *> * getFormals() const{
+	Span<FormalDeclNode *> getFormals() const{
 		return myFormals;
 	}
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	virtual bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
+	//typeAnalysis in two halves: the signature (return type,
+	// formals and the function's own type), then the body, which
+	// needs the signatures of every function it calls
+	void typeSignature(TypeAnalysis *);
+	void typeBody(TypeAnalysis *);
 	void to3AC(IRProgram * prog) override;
 	void to3AC(Procedure * prog) override;
 	virtual TypeNode * getRetTypeNode() { 
@@ -224,16 +256,17 @@ public:
 private:
 	TypeNode * myRetType;
 	IDNode * myID;
-	std::list<FormalDeclNode *> * myFormals;
-	std::list<StmtNode *> * myBody;
+	Span<FormalDeclNode *> myFormals;
+	Span<StmtNode *> myBody;
 };
 
 class AssignStmtNode : public StmtNode{
 public:
 	AssignStmtNode(Position * p, AssignExpNode * expIn)
 	: StmtNode(p), myExp(expIn){ }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual void to3AC(Procedure * prog) override;
@@ -245,8 +278,9 @@ class ReceiveStmtNode : public StmtNode{
 public:
 	ReceiveStmtNode(Position * p, LValNode * dstIn)
 	: StmtNode(p), myDst(dstIn){ }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual void to3AC(Procedure * prog) override;
@@ -258,8 +292,9 @@ class ReportStmtNode : public StmtNode{
 public:
 	ReportStmtNode(Position * p, ExpNode * srcIn)
 	: StmtNode(p), mySrc(srcIn){ }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual void to3AC(Procedure * prog) override;
@@ -271,8 +306,9 @@ class PostDecStmtNode : public StmtNode{
 public:
 	PostDecStmtNode(Position * p, LValNode * lvalIn)
 	: StmtNode(p), myLVal(lvalIn){ }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	virtual bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual void to3AC(Procedure * prog) override;
@@ -284,8 +320,9 @@ class PostIncStmtNode : public StmtNode{
 public:
 	PostIncStmtNode(Position * p, LValNode * lvalIn)
 	: StmtNode(p), myLVal(lvalIn){ }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	virtual bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual void to3AC(Procedure * prog) override;
@@ -296,57 +333,61 @@ private:
 class IfStmtNode : public StmtNode{
 public:
 	IfStmtNode(Position * p, ExpNode * condIn,
-	  std::list<StmtNode *> * bodyIn)
+	  Span<StmtNode *> bodyIn)
 	: StmtNode(p), myCond(condIn), myBody(bodyIn){ }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual void to3AC(Procedure * prog) override;
 private:
 	ExpNode * myCond;
-	std::list<StmtNode *> * myBody;
+	Span<StmtNode *> myBody;
 };
 
 class IfElseStmtNode : public StmtNode{
 public:
 	IfElseStmtNode(Position * p, ExpNode * condIn, 
-	  std::list<StmtNode *> * bodyTrueIn,
-	  std::list<StmtNode *> * bodyFalseIn)
+	  Span<StmtNode *> bodyTrueIn,
+	  Span<StmtNode *> bodyFalseIn)
 	: StmtNode(p), myCond(condIn),
 	  myBodyTrue(bodyTrueIn), myBodyFalse(bodyFalseIn) { }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual void to3AC(Procedure * prog) override;
 private:
 	ExpNode * myCond;
-	std::list<StmtNode *> * myBodyTrue;
-	std::list<StmtNode *> * myBodyFalse;
+	Span<StmtNode *> myBodyTrue;
+	Span<StmtNode *> myBodyFalse;
 };
 
 class WhileStmtNode : public StmtNode{
 public:
 	WhileStmtNode(Position * p, ExpNode * condIn, 
-	  std::list<StmtNode *> * bodyIn)
+	  Span<StmtNode *> bodyIn)
 	: StmtNode(p), myCond(condIn), myBody(bodyIn){ }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual void to3AC(Procedure * prog) override;
 private:
 	ExpNode * myCond;
-	std::list<StmtNode *> * myBody;
+	Span<StmtNode *> myBody;
 };
 
 class ReturnStmtNode : public StmtNode{
 public:
 	ReturnStmtNode(Position * p, ExpNode * exp)
 	: StmtNode(p), myExp(exp){ }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual void to3AC(Procedure * proc) override;
@@ -357,20 +398,26 @@ private:
 class CallExpNode : public ExpNode{
 public:
 	CallExpNode(Position * p, IDNode * id,
-	  std::list<ExpNode *> * argsIn)
+	  Span<ExpNode *> argsIn)
 	: ExpNode(p), myID(id), myArgs(argsIn){ }
-	void unparse(std::ostream& out, int indent) override;
-	void unparseNested(std::ostream& out) override;
-	void transpileToC(std::ostream& out, int indent) override;
-	void transpileToCNested(std::ostream& out) override;
+	void unparse(OutputSink& out, int indent) override;
+	void unparseNested(OutputSink& out) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
+	void transpileToCNested(OutputSink& out) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	void typeAnalysis(TypeAnalysis *) override;
 	bool isString() { return retString; }
 
 	virtual Opd * flatten(Procedure * proc) override;
+	//Lower `return` of this call as a tail call, if it can be
+	// one; returns false, having added no quads, if not
+	bool tailCallTo3AC(Procedure * proc);
 private:
+	friend class ASTReader;
+	bool selfTailCallTo3AC(Procedure * proc);
 	IDNode * myID;
-	std::list<ExpNode *> * myArgs;
+	Span<ExpNode *> myArgs;
 	bool retString;
 };
 
@@ -394,8 +441,9 @@ class PlusNode : public BinaryExpNode{
 public:
 	PlusNode(Position * p, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(p, e1, e2){ }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * prog) override;
 };
@@ -404,8 +452,9 @@ class MinusNode : public BinaryExpNode{
 public:
 	MinusNode(Position * p, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(p, e1, e2){ }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * prog) override;
 };
@@ -414,8 +463,9 @@ class TimesNode : public BinaryExpNode{
 public:
 	TimesNode(Position * p, ExpNode * e1In, ExpNode * e2In)
 	: BinaryExpNode(p, e1In, e2In){ }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * prog) override;
 };
@@ -424,8 +474,9 @@ class DivideNode : public BinaryExpNode{
 public:
 	DivideNode(Position * p, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(p, e1, e2){ }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * prog) override;
 };
@@ -434,8 +485,9 @@ class AndNode : public BinaryExpNode{
 public:
 	AndNode(Position * p, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(p, e1, e2){ }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * prog) override;
 };
@@ -444,8 +496,9 @@ class OrNode : public BinaryExpNode{
 public:
 	OrNode(Position * p, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(p, e1, e2){ }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * prog) override;
 };
@@ -454,8 +507,9 @@ class EqualsNode : public BinaryExpNode{
 public:
 	EqualsNode(Position * p, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(p, e1, e2){ }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * prog) override;
 	
@@ -465,8 +519,9 @@ class NotEqualsNode : public BinaryExpNode{
 public:
 	NotEqualsNode(Position * p, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(p, e1, e2){ }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * prog) override;
 	
@@ -476,8 +531,9 @@ class LessNode : public BinaryExpNode{
 public:
 	LessNode(Position * p, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(p, e1, e2){ }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * proc) override;
 };
@@ -486,8 +542,9 @@ class LessEqNode : public BinaryExpNode{
 public:
 	LessEqNode(Position * pos, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(pos, e1, e2){ }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * prog) override;
 };
@@ -496,8 +553,9 @@ class GreaterNode : public BinaryExpNode{
 public:
 	GreaterNode(Position * p, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(p, e1, e2){ }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * proc) override;
 };
@@ -506,8 +564,9 @@ class GreaterEqNode : public BinaryExpNode{
 public:
 	GreaterEqNode(Position * p, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(p, e1, e2){ }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * prog) override;
 };
@@ -518,8 +577,8 @@ public:
 	: ExpNode(p){
 		this->myExp = expIn;
 	}
-	virtual void unparse(std::ostream& out, int indent) override = 0;
-	void transpileToC(std::ostream& out, int indent) override = 0;
+	virtual void unparse(OutputSink& out, int indent) override = 0;
+	void transpileToC(OutputSink& out, int indent) override = 0;
 	virtual bool nameAnalysis(SymbolTable * symTab) override = 0;
 	virtual void typeAnalysis(TypeAnalysis *) override = 0;
 	virtual Opd * flatten(Procedure * prog) override = 0;
@@ -531,8 +590,9 @@ class NegNode : public UnaryExpNode{
 public:
 	NegNode(Position * p, ExpNode * exp)
 	: UnaryExpNode(p, exp){ }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * prog) override;
@@ -542,8 +602,9 @@ class NotNode : public UnaryExpNode{
 public:
 	NotNode(Position * p, ExpNode * exp)
 	: UnaryExpNode(p, exp){ }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * prog) override;
@@ -552,8 +613,9 @@ public:
 class VoidTypeNode : public TypeNode{
 public:
 	VoidTypeNode(Position * p) : TypeNode(p){}
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	virtual const DataType * getType()override { 
 		return BasicType::VOID(); 
 	}
@@ -562,24 +624,27 @@ public:
 class IntTypeNode : public TypeNode{
 public:
 	IntTypeNode(Position * p): TypeNode(p){}
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	virtual const DataType * getType() override;
 };
 
 class BoolTypeNode : public TypeNode{
 public:
 	BoolTypeNode(Position * p): TypeNode(p) { }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	virtual const DataType * getType() override;
 };
 
 class StringTypeNode : public TypeNode{
 public:
 	StringTypeNode(Position * p): TypeNode(p) { }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	virtual const DataType * getType() override;
 };
 
@@ -587,8 +652,9 @@ class AssignExpNode : public ExpNode{
 public:
 	AssignExpNode(Position * p, LValNode * dstIn, ExpNode * srcIn)
 	: ExpNode(p), myDst(dstIn), mySrc(srcIn){ }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * proc) override;
@@ -601,14 +667,15 @@ class IntLitNode : public ExpNode{
 public:
 	IntLitNode(Position * p, const int numIn)
 	: ExpNode(p), myNum(numIn){ }
-	virtual void unparseNested(std::ostream& out) override{
+	virtual void unparseNested(OutputSink& out) override{
 		unparse(out, 0);
 	}
-	void unparse(std::ostream& out, int indent) override;
-	virtual void transpileToCNested(std::ostream& out) override {
+	void unparse(OutputSink& out, int indent) override;
+	virtual void transpileToCNested(OutputSink& out) override {
 		transpileToC(out,0);
 	}
-	void transpileToC(std::ostream& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * prog) override;
@@ -618,21 +685,22 @@ private:
 
 class StrLitNode : public ExpNode{
 public:
-	StrLitNode(Position * p, const std::string strIn)
+	StrLitNode(Position * p, const char * strIn)
 	: ExpNode(p), myStr(strIn){ }
-	virtual void unparseNested(std::ostream& out) override{
+	virtual void unparseNested(OutputSink& out) override{
 		unparse(out, 0);
 	}
-	void unparse(std::ostream& out, int indent) override;
-	virtual void transpileToCNested(std::ostream& out) override {
+	void unparse(OutputSink& out, int indent) override;
+	virtual void transpileToCNested(OutputSink& out) override {
 		transpileToC(out,0);
 	}
-	void transpileToC(std::ostream& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	bool nameAnalysis(SymbolTable *) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * proc) override;
 private:
-	 const std::string myStr;
+	 const char * myStr;
 };
 
 
@@ -640,14 +708,15 @@ private:
 class TrueNode : public ExpNode{
 public:
 	TrueNode(Position * p): ExpNode(p){ }
-	virtual void unparseNested(std::ostream& out) override{
+	virtual void unparseNested(OutputSink& out) override{
 		unparse(out, 0);
 	}
-	void unparse(std::ostream& out, int indent) override;
-	virtual void transpileToCNested(std::ostream& out) override {
+	void unparse(OutputSink& out, int indent) override;
+	virtual void transpileToCNested(OutputSink& out) override {
 		transpileToC(out,0);
 	}
-	void transpileToC(std::ostream& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * prog) override;
@@ -656,14 +725,15 @@ public:
 class FalseNode : public ExpNode{
 public:
 	FalseNode(Position * p): ExpNode(p){ }
-	virtual void unparseNested(std::ostream& out) override{
+	virtual void unparseNested(OutputSink& out) override{
 		unparse(out, 0);
 	}
-	void unparse(std::ostream& out, int indent) override;
-	virtual void transpileToCNested(std::ostream& out) override {
+	void unparse(OutputSink& out, int indent) override;
+	virtual void transpileToCNested(OutputSink& out) override {
 		transpileToC(out,0);
 	}
-	void transpileToC(std::ostream& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * prog) override;
@@ -673,8 +743,9 @@ class CallStmtNode : public StmtNode{
 public:
 	CallStmtNode(Position * p, CallExpNode * expIn)
 	: StmtNode(p), myCallExp(expIn){ }
-	void unparse(std::ostream& out, int indent) override;
-	void transpileToC(std::ostream& out, int indent) override;
+	void unparse(OutputSink& out, int indent) override;
+	void transpileToC(OutputSink& out, int indent) override;
+	void serialize(ASTWriter *) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual void to3AC(Procedure * proc) override;
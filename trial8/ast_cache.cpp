@@ -0,0 +1,551 @@
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ast_cache.hpp"
+#include "type_analysis.hpp"
+
+namespace cshanty{
+
+//A cache file is only reused by the exact build that wrote it.
+// The Makefile rebuilds this file whenever any other object
+// changes, so the build stamp moves along with the compiler.
+// Bump the format number whenever the encoding below changes.
+static const char * const compilerVersion =
+	"cshantyc trial8 ast-cache format 3, built " __DATE__ " " __TIME__;
+
+static const uint32_t CACHE_MAGIC = 0x41485343; // "CSHA"
+static const uint32_t CACHE_FORMAT = 3;
+
+//Header words: magic, format, key (2 words), source length
+// (2 words), type count, type word count, symbol count, node
+// word count, string bytes, node count
+static const size_t HEADER_WORDS = 12;
+
+enum TypeTag { TYPE_BASIC, TYPE_ERROR, TYPE_RECORD, TYPE_FN };
+
+//FNV-1a, 64 bit
+static uint64_t hashBytes(uint64_t hash, const char * bytes, size_t len){
+	for (size_t i = 0; i < len; i++){
+		hash ^= static_cast<unsigned char>(bytes[i]);
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static uint32_t lo(uint64_t val){ return static_cast<uint32_t>(val); }
+static uint32_t hi(uint64_t val){ return static_cast<uint32_t>(val >> 32); }
+
+void ASTWriter::begin(ASTTag tag, ASTNode * node){
+	word(tag);
+	Position * pos = node->pos();
+	word(static_cast<uint32_t>(pos->myLineI));
+	word(static_cast<uint32_t>(pos->myColI));
+	word(static_cast<uint32_t>(pos->myLineE));
+	word(static_cast<uint32_t>(pos->myColE));
+	nodeCount++;
+	const DataType * nodeType = ta->nodeType(node);
+	if (nodeType == nullptr){
+		word(0);
+	} else {
+		type(nodeType);
+	}
+}
+
+void ASTWriter::node(ASTNode * node){
+	if (node == nullptr){
+		word(TAG_NULL);
+		return;
+	}
+	node->serialize(this);
+}
+
+void ASTWriter::str(const char * text){
+	word(strOffset(text));
+}
+
+void ASTWriter::symbol(SemSymbol * sym){
+	if (sym == nullptr){
+		word(0);
+		return;
+	}
+	auto res = symIDs.find(sym);
+	if (res != symIDs.end()){
+		word(res->second);
+		return;
+	}
+	uint32_t kind = static_cast<uint32_t>(sym->getKind());
+	uint32_t name = strOffset(sym->getName());
+	uint32_t symType = typeID(sym->getDataType());
+	symWords.push_back(kind);
+	symWords.push_back(name);
+	symWords.push_back(symType);
+	uint32_t id = static_cast<uint32_t>(symIDs.size() + 1);
+	symIDs[sym] = id;
+	word(id);
+}
+
+void ASTWriter::type(const DataType * type){
+	word(typeID(type));
+}
+
+uint32_t ASTWriter::typeID(const DataType * type){
+	if (type == nullptr){ return 0; }
+	auto res = typeIDs.find(type);
+	if (res != typeIDs.end()){ return res->second; }
+
+	//Component types get their IDs first, so the words of
+	// this type are written in one piece
+	std::vector<uint32_t> entry;
+	if (const BasicType * basic = type->asBasic()){
+		entry.push_back(TYPE_BASIC);
+		entry.push_back(static_cast<uint32_t>(basic->getBaseType()));
+	} else if (type->asError()){
+		entry.push_back(TYPE_ERROR);
+	} else if (const RecordType * record = type->asRecord()){
+		entry.push_back(TYPE_RECORD);
+		entry.push_back(strOffset(record->getString()));
+	} else if (const FnType * fn = type->asFn()){
+		entry.push_back(TYPE_FN);
+		entry.push_back(typeID(fn->getReturnType()));
+		auto formals = fn->getFormalTypes();
+		entry.push_back(static_cast<uint32_t>(formals->size()));
+		for (const DataType * formal : *formals){
+			entry.push_back(typeID(formal));
+		}
+	} else {
+		throw new InternalError("Cannot cache unknown type");
+	}
+
+	typeIndex.push_back(static_cast<uint32_t>(typeWords.size()));
+	typeWords.insert(typeWords.end(), entry.begin(), entry.end());
+	uint32_t id = static_cast<uint32_t>(typeIndex.size());
+	typeIDs[type] = id;
+	return id;
+}
+
+uint32_t ASTWriter::strOffset(const std::string& text){
+	auto res = strIDs.find(text);
+	if (res != strIDs.end()){ return res->second; }
+	uint32_t offset = static_cast<uint32_t>(strings.size());
+	strings += text;
+	strings += '\0';
+	strIDs[text] = offset;
+	return offset;
+}
+
+std::string ASTWriter::finish(uint64_t key, uint64_t sourceLen){
+	std::vector<uint32_t> header(HEADER_WORDS, 0);
+	header[0] = CACHE_MAGIC;
+	header[1] = CACHE_FORMAT;
+	header[2] = lo(key);
+	header[3] = hi(key);
+	header[4] = lo(sourceLen);
+	header[5] = hi(sourceLen);
+	header[6] = static_cast<uint32_t>(typeIndex.size());
+	header[7] = static_cast<uint32_t>(typeWords.size());
+	header[8] = static_cast<uint32_t>(symWords.size() / 3);
+	header[9] = static_cast<uint32_t>(nodeWords.size());
+	header[10] = static_cast<uint32_t>(strings.size());
+	header[11] = nodeCount;
+
+	std::string res;
+	for (auto section : {&header, &typeIndex, &typeWords, &symWords, &nodeWords}){
+		res.append(reinterpret_cast<const char *>(section->data()),
+			section->size() * sizeof(uint32_t));
+	}
+	res += strings;
+	return res;
+}
+
+ASTReader::ASTReader(const char * dataIn, size_t sizeIn, Arena * arenaIn)
+: data(dataIn), size(sizeIn), arena(arenaIn), ta(nullptr), cur(0){ }
+
+void ASTReader::corrupt(){
+	throw new InternalError("Corrupt AST cache file");
+}
+
+TypeAnalysis * ASTReader::read(uint64_t key, uint64_t sourceLen){
+	if (size < HEADER_WORDS * sizeof(uint32_t)){ corrupt(); }
+	const uint32_t * header = reinterpret_cast<const uint32_t *>(data);
+	if (header[0] != CACHE_MAGIC || header[1] != CACHE_FORMAT){ corrupt(); }
+	if (header[2] != lo(key) || header[3] != hi(key)){ corrupt(); }
+	if (header[4] != lo(sourceLen) || header[5] != hi(sourceLen)){
+		corrupt();
+	}
+	typeCount = header[6];
+	typeWordCount = header[7];
+	symCount = header[8];
+	nodeWordCount = header[9];
+	strBytes = header[10];
+
+	size_t words = HEADER_WORDS + size_t(typeCount) + typeWordCount
+		+ size_t(symCount) * 3 + nodeWordCount;
+	if (words * sizeof(uint32_t) + strBytes != size){ corrupt(); }
+	typeIndex = header + HEADER_WORDS;
+	typeWords = typeIndex + typeCount;
+	symWords = typeWords + typeWordCount;
+	nodeWords = symWords + size_t(symCount) * 3;
+	strings = reinterpret_cast<const char *>(nodeWords + nodeWordCount);
+	if (strBytes > 0 && strings[strBytes - 1] != '\0'){ corrupt(); }
+	if (header[11] > nodeWordCount){ corrupt(); }
+
+	types.assign(typeCount, nullptr);
+	symbols.assign(symCount, nullptr);
+	ta = new TypeAnalysis();
+	ta->nodeTypes.resize(header[11], nullptr);
+	ProgramNode * root = child<ProgramNode>();
+	if (root == nullptr || cur != nodeWordCount){ corrupt(); }
+	if (arena->nodeCount() != header[11]){ corrupt(); }
+	ta->ast = root;
+	return ta;
+}
+
+uint32_t ASTReader::word(){
+	if (cur >= nodeWordCount){ corrupt(); }
+	return nodeWords[cur++];
+}
+
+const char * ASTReader::str(uint32_t offset){
+	if (offset >= strBytes){ corrupt(); }
+	return strings + offset;
+}
+
+SemSymbol * ASTReader::symbol(){
+	uint32_t id = word();
+	if (id == 0){ return nullptr; }
+	if (id > symCount){ corrupt(); }
+	if (symbols[id - 1] != nullptr){ return symbols[id - 1]; }
+
+	const uint32_t * entry = symWords + size_t(id - 1) * 3;
+	std::string name = str(entry[1]);
+	const DataType * symType = type(entry[2]);
+	if (symType == nullptr){ corrupt(); }
+	SemSymbol * sym = nullptr;
+	switch (entry[0]){
+	case VAR:
+		sym = new VarSymbol(name, symType);
+		break;
+	case FN:
+		if (symType->asFn() == nullptr){ corrupt(); }
+		sym = new FnSymbol(name, symType->asFn());
+		break;
+	case RECORD:
+		if (symType->asRecord() == nullptr){ corrupt(); }
+		sym = new RecordSymbol(name, symType->asRecord());
+		break;
+	default:
+		corrupt();
+	}
+	symbols[id - 1] = sym;
+	return sym;
+}
+
+const DataType * ASTReader::type(uint32_t id){
+	if (id == 0){ return nullptr; }
+	if (id > typeCount){ corrupt(); }
+	if (types[id - 1] != nullptr){ return types[id - 1]; }
+
+	uint32_t start = typeIndex[id - 1];
+	auto at = [&](uint32_t idx){
+		if (size_t(start) + idx >= typeWordCount){ corrupt(); }
+		return typeWords[start + idx];
+	};
+	const DataType * res = nullptr;
+	switch (at(0)){
+	case TYPE_BASIC:
+		if (at(1) > BaseType::BOOL){ corrupt(); }
+		res = BasicType::produce(static_cast<BaseType>(at(1)));
+		break;
+	case TYPE_ERROR:
+		res = ErrorType::produce();
+		break;
+	case TYPE_RECORD: {
+		//Records are rebuilt at their declaration, which always
+		// comes before any use of the type
+		auto record = records.find(str(at(1)));
+		if (record == records.end()){ corrupt(); }
+		res = record->second;
+		break;
+	}
+	case TYPE_FN: {
+		const DataType * retType = type(at(1));
+		uint32_t count = at(2);
+		std::list<const DataType *> formals;
+		for (uint32_t i = 0; i < count; i++){
+			formals.push_back(type(at(3 + i)));
+		}
+		res = FnType::produce(formals, retType);
+		break;
+	}
+	default:
+		corrupt();
+	}
+	types[id - 1] = res;
+	return res;
+}
+
+template <typename T>
+T * ASTReader::binary(Position * pos){
+	ExpNode * lhs = child<ExpNode>();
+	ExpNode * rhs = child<ExpNode>();
+	if (lhs == nullptr || rhs == nullptr){ corrupt(); }
+	return arena->makeNode<T>(pos, lhs, rhs);
+}
+
+ASTNode * ASTReader::node(){
+	uint32_t tag = word();
+	if (tag == TAG_NULL){ return nullptr; }
+	uint32_t lineI = word();
+	uint32_t colI = word();
+	uint32_t lineE = word();
+	uint32_t colE = word();
+	Position * pos = arena->make<Position>(lineI, colI, lineE, colE);
+	const DataType * nodeType = type(word());
+
+	ASTNode * res = nullptr;
+	switch (tag){
+	case TAG_PROGRAM: {
+		Span<DeclNode *> globals = children<DeclNode>();
+		res = arena->makeNode<ProgramNode>(pos, globals);
+		break;
+	}
+	case TAG_ID: {
+		IDNode * id = arena->makeNode<IDNode>(pos, str(word()));
+		id->attachSymbol(symbol());
+		res = id;
+		break;
+	}
+	case TAG_INDEX: {
+		IDNode * base = required<IDNode>();
+		IDNode * idx = required<IDNode>();
+		IndexNode * index = arena->makeNode<IndexNode>(pos, base, idx);
+		index->myField = word();
+		SemSymbol * baseSym = base->getSymbol();
+		const RecordType * record = nullptr;
+		if (baseSym != nullptr && baseSym->getDataType() != nullptr){
+			record = baseSym->getDataType()->asRecord();
+		}
+		if (record == nullptr || index->myField >= record->numFields()){
+			corrupt();
+		}
+		res = index;
+		break;
+	}
+	case TAG_RECORD_TYPE: {
+		RecordTypeNode * typeNode =
+			arena->makeNode<RecordTypeNode>(pos, required<IDNode>());
+		const DataType * recordType = type(word());
+		if (recordType == nullptr || !recordType->asRecord()){ corrupt(); }
+		typeNode->myType = recordType->asRecord();
+		res = typeNode;
+		break;
+	}
+	case TAG_INT_TYPE:
+		res = arena->makeNode<IntTypeNode>(pos);
+		break;
+	case TAG_BOOL_TYPE:
+		res = arena->makeNode<BoolTypeNode>(pos);
+		break;
+	case TAG_STRING_TYPE:
+		res = arena->makeNode<StringTypeNode>(pos);
+		break;
+	case TAG_VOID_TYPE:
+		res = arena->makeNode<VoidTypeNode>(pos);
+		break;
+	case TAG_VAR_DECL: {
+		TypeNode * declType = required<TypeNode>();
+		IDNode * id = required<IDNode>();
+		res = arena->makeNode<VarDeclNode>(pos, declType, id);
+		break;
+	}
+	case TAG_FORMAL_DECL: {
+		TypeNode * declType = required<TypeNode>();
+		IDNode * id = required<IDNode>();
+		res = arena->makeNode<FormalDeclNode>(pos, declType, id);
+		break;
+	}
+	case TAG_RECORD_DECL: {
+		IDNode * id = required<IDNode>();
+		Span<VarDeclNode *> fields = children<VarDeclNode>();
+		//Mirror RecordTypeDeclNode::nameAnalysis, so that the
+		// record is laid out exactly as it was when cached
+		std::vector<RecordField> recordFields;
+		for (VarDeclNode * field : fields){
+			const DataType * fieldType = field->getTypeNode()->getType();
+			if (fieldType == nullptr){ corrupt(); }
+			recordFields.push_back({field->ID()->getName(), fieldType, 0, 0});
+		}
+		records[id->getName()] =
+			RecordType::produce(id->getName(), recordFields);
+		res = arena->makeNode<RecordTypeDeclNode>(pos, id, fields);
+		break;
+	}
+	case TAG_FN_DECL: {
+		TypeNode * retType = required<TypeNode>();
+		IDNode * id = required<IDNode>();
+		Span<FormalDeclNode *> formals = children<FormalDeclNode>();
+		Span<StmtNode *> body = children<StmtNode>();
+		res = arena->makeNode<FnDeclNode>(pos, retType, id, formals, body);
+		break;
+	}
+	case TAG_ASSIGN_STMT:
+		res = arena->makeNode<AssignStmtNode>(pos, required<AssignExpNode>());
+		break;
+	case TAG_RECEIVE:
+		res = arena->makeNode<ReceiveStmtNode>(pos, required<LValNode>());
+		break;
+	case TAG_REPORT:
+		res = arena->makeNode<ReportStmtNode>(pos, required<ExpNode>());
+		break;
+	case TAG_POST_DEC:
+		res = arena->makeNode<PostDecStmtNode>(pos, required<LValNode>());
+		break;
+	case TAG_POST_INC:
+		res = arena->makeNode<PostIncStmtNode>(pos, required<LValNode>());
+		break;
+	case TAG_IF: {
+		ExpNode * cond = required<ExpNode>();
+		Span<StmtNode *> body = children<StmtNode>();
+		res = arena->makeNode<IfStmtNode>(pos, cond, body);
+		break;
+	}
+	case TAG_IF_ELSE: {
+		ExpNode * cond = required<ExpNode>();
+		Span<StmtNode *> bodyTrue = children<StmtNode>();
+		Span<StmtNode *> bodyFalse = children<StmtNode>();
+		res = arena->makeNode<IfElseStmtNode>(pos, cond, bodyTrue, bodyFalse);
+		break;
+	}
+	case TAG_WHILE: {
+		ExpNode * cond = required<ExpNode>();
+		Span<StmtNode *> body = children<StmtNode>();
+		res = arena->makeNode<WhileStmtNode>(pos, cond, body);
+		break;
+	}
+	case TAG_RETURN:
+		res = arena->makeNode<ReturnStmtNode>(pos, child<ExpNode>());
+		break;
+	case TAG_CALL_STMT:
+		res = arena->makeNode<CallStmtNode>(pos, required<CallExpNode>());
+		break;
+	case TAG_CALL_EXP: {
+		IDNode * id = required<IDNode>();
+		Span<ExpNode *> args = children<ExpNode>();
+		CallExpNode * call = arena->makeNode<CallExpNode>(pos, id, args);
+		call->retString = word() != 0;
+		res = call;
+		break;
+	}
+	case TAG_PLUS: res = binary<PlusNode>(pos); break;
+	case TAG_MINUS: res = binary<MinusNode>(pos); break;
+	case TAG_TIMES: res = binary<TimesNode>(pos); break;
+	case TAG_DIVIDE: res = binary<DivideNode>(pos); break;
+	case TAG_AND: res = binary<AndNode>(pos); break;
+	case TAG_OR: res = binary<OrNode>(pos); break;
+	case TAG_EQUALS: res = binary<EqualsNode>(pos); break;
+	case TAG_NOT_EQUALS: res = binary<NotEqualsNode>(pos); break;
+	case TAG_LESS: res = binary<LessNode>(pos); break;
+	case TAG_LESS_EQ: res = binary<LessEqNode>(pos); break;
+	case TAG_GREATER: res = binary<GreaterNode>(pos); break;
+	case TAG_GREATER_EQ: res = binary<GreaterEqNode>(pos); break;
+	case TAG_NEG:
+		res = arena->makeNode<NegNode>(pos, required<ExpNode>());
+		break;
+	case TAG_NOT:
+		res = arena->makeNode<NotNode>(pos, required<ExpNode>());
+		break;
+	case TAG_ASSIGN_EXP: {
+		LValNode * dst = required<LValNode>();
+		ExpNode * src = required<ExpNode>();
+		res = arena->makeNode<AssignExpNode>(pos, dst, src);
+		break;
+	}
+	case TAG_INT_LIT:
+		res = arena->makeNode<IntLitNode>(pos, static_cast<int>(word()));
+		break;
+	case TAG_STR_LIT:
+		res = arena->makeNode<StrLitNode>(pos, str(word()));
+		break;
+	case TAG_TRUE:
+		res = arena->makeNode<TrueNode>(pos);
+		break;
+	case TAG_FALSE:
+		res = arena->makeNode<FalseNode>(pos);
+		break;
+	default:
+		corrupt();
+	}
+	if (nodeType != nullptr){ ta->nodeType(res, nodeType); }
+	return res;
+}
+
+ASTCache::ASTCache(const char * dirIn, const std::string& source)
+: sourceLen(source.size()), mapping(nullptr), mappingSize(0){
+	uint64_t hash = 14695981039346656037ULL;
+	hash = hashBytes(hash, compilerVersion, strlen(compilerVersion) + 1);
+	key = hashBytes(hash, source.c_str(), source.size());
+
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.ast",
+		static_cast<unsigned long long>(key));
+	path = std::string(dirIn) + "/" + name;
+}
+
+ASTCache::~ASTCache(){
+	if (mapping != nullptr){ munmap(mapping, mappingSize); }
+}
+
+TypeAnalysis * ASTCache::load(Arena * arena){
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0){ return nullptr; }
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size <= 0){
+		close(fd);
+		return nullptr;
+	}
+	size_t len = static_cast<size_t>(info.st_size);
+	void * map = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED){ return nullptr; }
+
+	ASTReader reader(static_cast<const char *>(map), len, arena);
+	try {
+		TypeAnalysis * ta = reader.read(key, sourceLen);
+		mapping = map;
+		mappingSize = len;
+		return ta;
+	} catch (InternalError * e){
+		//A stale or damaged entry is just a miss; it will be
+		// overwritten once this compilation succeeds
+		delete e;
+		munmap(map, len);
+		return nullptr;
+	}
+}
+
+void ASTCache::store(TypeAnalysis * ta){
+	ASTWriter writer(ta);
+	ta->ast->serialize(&writer);
+	std::string bytes = writer.finish(key, sourceLen);
+
+	//Write to a private name and rename into place, so that
+	// concurrent compilations never map a half-written file. The
+	// counter keeps apart threads of one process (-j) storing the
+	// same source.
+	static std::atomic<unsigned int> stores(0);
+	std::string tmpPath = path + ".tmp" + std::to_string(getpid())
+		+ "." + std::to_string(stores++);
+	std::ofstream out(tmpPath, std::ios::binary);
+	if (!out.good()){ return; }
+	out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+	out.close();
+	if (!out.good() || rename(tmpPath.c_str(), path.c_str()) != 0){
+		remove(tmpPath.c_str());
+	}
+}
+
+}
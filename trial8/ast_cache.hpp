@@ -0,0 +1,155 @@
+#ifndef CSHANTY_AST_CACHE_HPP
+#define CSHANTY_AST_CACHE_HPP
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "arena.hpp"
+#include "ast.hpp"
+
+namespace cshanty{
+
+class TypeAnalysis;
+
+//Every node kind has a tag that leads its record in a
+// serialized AST. The values are part of the file format.
+enum ASTTag {
+	TAG_NULL, TAG_PROGRAM, TAG_ID, TAG_INDEX,
+	TAG_RECORD_TYPE, TAG_INT_TYPE, TAG_BOOL_TYPE,
+	TAG_STRING_TYPE, TAG_VOID_TYPE,
+	TAG_VAR_DECL, TAG_FORMAL_DECL, TAG_RECORD_DECL, TAG_FN_DECL,
+	TAG_ASSIGN_STMT, TAG_RECEIVE, TAG_REPORT,
+	TAG_POST_DEC, TAG_POST_INC, TAG_IF, TAG_IF_ELSE, TAG_WHILE,
+	TAG_RETURN, TAG_CALL_STMT, TAG_CALL_EXP,
+	TAG_PLUS, TAG_MINUS, TAG_TIMES, TAG_DIVIDE, TAG_AND, TAG_OR,
+	TAG_EQUALS, TAG_NOT_EQUALS, TAG_LESS, TAG_LESS_EQ,
+	TAG_GREATER, TAG_GREATER_EQ, TAG_NEG, TAG_NOT,
+	TAG_ASSIGN_EXP, TAG_INT_LIT, TAG_STR_LIT, TAG_TRUE, TAG_FALSE
+};
+
+//Flattens a type-checked AST, together with the symbols and
+// types attached to it, into the words of a cache file. Each
+// node writes itself through its serialize() method (see
+// serialize.cpp): a tag, its position and type, then its own
+// fields and children in pre-order.
+class ASTWriter{
+public:
+	ASTWriter(TypeAnalysis * taIn) : ta(taIn), nodeCount(0){ }
+	void begin(ASTTag tag, ASTNode * node);
+	void node(ASTNode * node);
+	template <typename T>
+	void nodes(Span<T *> elts){
+		word(static_cast<uint32_t>(elts.size()));
+		for (T * elt : elts){ node(elt); }
+	}
+	void word(uint32_t val){ nodeWords.push_back(val); }
+	void str(const char * text);
+	void symbol(SemSymbol * sym);
+	void type(const DataType * type);
+	std::string finish(uint64_t key, uint64_t sourceLen);
+private:
+	uint32_t typeID(const DataType * type);
+	uint32_t strOffset(const std::string& text);
+
+	TypeAnalysis * ta;
+	uint32_t nodeCount;
+	std::vector<uint32_t> nodeWords;
+	std::vector<uint32_t> typeIndex;
+	std::vector<uint32_t> typeWords;
+	std::vector<uint32_t> symWords;
+	std::string strings;
+	std::unordered_map<const DataType *, uint32_t> typeIDs;
+	std::unordered_map<SemSymbol *, uint32_t> symIDs;
+	std::unordered_map<std::string, uint32_t> strIDs;
+};
+
+//Rebuilds an AST from a mapped cache file. Nodes, positions and
+// spans go into the compilation's arena; identifier and string
+// literal text point straight into the mapping. Symbols and types
+// are decoded the first time they are referenced, so that every
+// node sharing a symbol gets the same SemSymbol back. Any
+// inconsistency in the file throws an InternalError.
+class ASTReader{
+public:
+	ASTReader(const char * dataIn, size_t sizeIn, Arena * arenaIn);
+	TypeAnalysis * read(uint64_t key, uint64_t sourceLen);
+private:
+	ASTNode * node();
+	//An optional child (nullptr if absent) of the given kind
+	template <typename T>
+	T * child(){
+		ASTNode * n = node();
+		if (n == nullptr){ return nullptr; }
+		T * res = dynamic_cast<T *>(n);
+		if (res == nullptr){ corrupt(); }
+		return res;
+	}
+	template <typename T>
+	T * required(){
+		T * res = child<T>();
+		if (res == nullptr){ corrupt(); }
+		return res;
+	}
+	template <typename T>
+	T * binary(Position * pos);
+	template <typename T>
+	Span<T *> children(){
+		std::vector<T *> * elts = new std::vector<T *>();
+		uint32_t count = word();
+		for (uint32_t i = 0; i < count; i++){
+			elts->push_back(required<T>());
+		}
+		return arena->seal(elts);
+	}
+	uint32_t word();
+	const char * str(uint32_t offset);
+	SemSymbol * symbol();
+	const DataType * type(uint32_t id);
+	[[noreturn]] void corrupt();
+
+	const char * data;
+	size_t size;
+	Arena * arena;
+	TypeAnalysis * ta;
+
+	const uint32_t * typeIndex;
+	const uint32_t * typeWords;
+	const uint32_t * symWords;
+	const uint32_t * nodeWords;
+	const char * strings;
+	uint32_t typeCount, typeWordCount, symCount;
+	uint32_t nodeWordCount, strBytes;
+	size_t cur;
+
+	std::vector<const DataType *> types;
+	std::vector<SemSymbol *> symbols;
+	std::unordered_map<std::string, const RecordType *> records;
+};
+
+//A directory of type-checked ASTs, one file per distinct
+// (source text, compiler build) pair. A hit lets a compilation
+// skip scanning, parsing, name analysis and type analysis. The
+// file that was hit stays mapped for the life of the cache
+// object, since the loaded AST points into it.
+class ASTCache{
+public:
+	ASTCache(const char * dirIn, const std::string& source);
+	~ASTCache();
+	//The analysis of the cached AST (its ast field set), or
+	// nullptr if there is no usable entry
+	TypeAnalysis * load(Arena * arena);
+	//Save a successfully type-checked AST. Failures to write
+	// are not errors; the next run just misses again.
+	void store(TypeAnalysis * ta);
+private:
+	std::string path;
+	uint64_t key;
+	uint64_t sourceLen;
+	void * mapping;
+	size_t mappingSize;
+};
+
+}
+
+#endif
@@ -0,0 +1,771 @@
+#!/usr/bin/env python3
+"""Generate valid, type-correct CShanty programs of a chosen size.
+
+The same seed and knobs always give the same program. Every program
+reads no input and is run once by the generator itself as it is
+written, so alongside <out>.cshanty it writes <out>.in (empty) and
+<out>.out.expected, in the layout of t8_tests; a compiled program
+that prints anything else is miscompiled.
+
+Programs are built so that running them is safe and cheap:
+  - every int assignment is followed by a reduction that keeps the
+    variable within (-997, 997), and expressions are shallow, so no
+    value ever needs more than 32 bits
+  - divisors have the form (x * x + 1), so they are never zero
+  - loops count a dedicated counter up to a small constant, and
+    nest at most three deep
+  - calls only go to lower-numbered functions, in chains of
+    --chain functions that main starts, so each function runs once
+  - calls never appear inside conditions, so the evaluation order
+    of && and || is never observable
+
+Usage:
+  gen_cshanty.py -o out/big --functions 2000 --stmts 40 --seed 7
+  gen_cshanty.py --help
+"""
+
+import argparse
+import random
+import sys
+
+INT_BOUND = 997
+MAX_LOOP_DEPTH = 3
+
+#Each keyword's spellings: the plain one first, then its aliases
+ALIASES = {
+	"{": ["{", "ahoy"],
+	"}": ["}", "shove off"],
+	";": [";", "heave and go", "roll and go"],
+	"return": ["return", "we'll take our leave and go"],
+	"true": ["true", "aye"],
+	"false": ["false", "nay"],
+	"+": ["+", "plus"],
+	"-": ["-", "minus"],
+	"*": ["*", "times"],
+	"/": ["/", "divide"],
+	"&&": ["&&", "and"],
+	"||": ["||", "or"],
+	"==": ["==", "equals"],
+	"=": ["=", "gets"],
+}
+
+
+class GenError(Exception):
+	pass
+
+
+def trunc_div(a, b):
+	"""Integer division rounding toward zero, as the target does"""
+	q = abs(a) // abs(b)
+	return q if (a >= 0) == (b >= 0) else -q
+
+
+class Writer:
+	"""Spells out tokens, choosing an alias with probability mix"""
+
+	def __init__(self, rng, mix):
+		self.rng = rng
+		self.mix = mix
+		self.lines = []
+
+	def tok(self, tok):
+		forms = ALIASES.get(tok)
+		if forms is None or self.mix <= 0 or self.rng.random() >= self.mix:
+			return tok
+		return self.rng.choice(forms[1:])
+
+	def line(self, indent, *parts):
+		self.lines.append("\t" * indent + " ".join(parts))
+
+
+#Expressions. Each can spell itself and evaluate in an environment.
+
+class Lit:
+	def __init__(self, val):
+		self.val = val
+
+	def text(self, w):
+		if self.val < 0:
+			return "(" + w.tok("-") + " " + str(-self.val) + ")"
+		return str(self.val)
+
+	def eval(self, env):
+		return self.val
+
+
+class BoolLit:
+	def __init__(self, val):
+		self.val = val
+
+	def text(self, w):
+		return w.tok("true" if self.val else "false")
+
+	def eval(self, env):
+		return self.val
+
+
+class Str:
+	def __init__(self, val):
+		self.val = val
+
+	def text(self, w):
+		return '"' + self.val.replace("\n", "\\n") + '"'
+
+	def eval(self, env):
+		return self.val
+
+
+class Var:
+	def __init__(self, name):
+		self.name = name
+
+	def text(self, w):
+		return self.name
+
+	def eval(self, env):
+		return env.get(self.name)
+
+	def store(self, env, val):
+		env.set(self.name, val)
+
+
+class Field:
+	def __init__(self, var, field):
+		self.var = var
+		self.field = field
+
+	def text(self, w):
+		return self.var + "[" + self.field + "]"
+
+	def eval(self, env):
+		return env.get(self.var)[self.field]
+
+	def store(self, env, val):
+		env.get(self.var)[self.field] = val
+
+
+class Bin:
+	def __init__(self, op, lhs, rhs):
+		self.op = op
+		self.lhs = lhs
+		self.rhs = rhs
+
+	def text(self, w):
+		return "(" + self.lhs.text(w) + " " + w.tok(self.op) + " " \
+			+ self.rhs.text(w) + ")"
+
+	def eval(self, env):
+		a = self.lhs.eval(env)
+		b = self.rhs.eval(env)
+		op = self.op
+		if op == "+": return a + b
+		if op == "-": return a - b
+		if op == "*": return a * b
+		if op == "/": return trunc_div(a, b)
+		if op == "&&": return a and b
+		if op == "||": return a or b
+		if op == "==": return a == b
+		if op == "!=": return a != b
+		if op == "<": return a < b
+		if op == "<=": return a <= b
+		if op == ">": return a > b
+		if op == ">=": return a >= b
+		raise GenError("bad operator " + op)
+
+
+class Not:
+	def __init__(self, exp):
+		self.exp = exp
+
+	def text(self, w):
+		return "(!" + self.exp.text(w) + ")"
+
+	def eval(self, env):
+		return not self.exp.eval(env)
+
+
+class Neg:
+	def __init__(self, exp):
+		self.exp = exp
+
+	def text(self, w):
+		return "(" + w.tok("-") + " " + self.exp.text(w) + ")"
+
+	def eval(self, env):
+		return -self.exp.eval(env)
+
+
+class Call:
+	def __init__(self, fn, args):
+		self.fn = fn
+		self.args = args
+
+	def text(self, w):
+		return self.fn.name + "(" + ", ".join(a.text(w) for a in self.args) + ")"
+
+	def eval(self, env):
+		return self.fn.run(env.program, [a.eval(env) for a in self.args])
+
+
+#Statements
+
+class Assign:
+	def __init__(self, lval, exp):
+		self.lval = lval
+		self.exp = exp
+
+	def write(self, w, indent):
+		w.line(indent, self.lval.text(w), w.tok("="), self.exp.text(w) + " " + w.tok(";"))
+
+	def run(self, env):
+		val = self.exp.eval(env)
+		if isinstance(val, int) and not isinstance(val, bool) \
+		  and abs(val) >= 2 ** 31:
+			raise GenError("value out of range")
+		self.lval.store(env, val)
+
+
+class Step:
+	def __init__(self, lval, op):
+		self.lval = lval
+		self.op = op
+
+	def write(self, w, indent):
+		w.line(indent, self.lval.text(w) + self.op, w.tok(";"))
+
+	def run(self, env):
+		delta = 1 if self.op == "++" else -1
+		self.lval.store(env, self.lval.eval(env) + delta)
+
+
+class Report:
+	def __init__(self, exp):
+		self.exp = exp
+
+	def write(self, w, indent):
+		w.line(indent, "report", self.exp.text(w), w.tok(";"))
+
+	def run(self, env):
+		env.program.out.append(str(self.exp.eval(env)))
+
+
+class If:
+	def __init__(self, cond, body, other=None):
+		self.cond = cond
+		self.body = body
+		self.other = other
+
+	def write(self, w, indent):
+		w.line(indent, "if (" + self.cond.text(w) + ")", w.tok("{"))
+		for stmt in self.body:
+			stmt.write(w, indent + 1)
+		if self.other is None:
+			w.line(indent, w.tok("}"))
+			return
+		w.line(indent, w.tok("}"), "else", w.tok("{"))
+		for stmt in self.other:
+			stmt.write(w, indent + 1)
+		w.line(indent, w.tok("}"))
+
+	def run(self, env):
+		if self.cond.eval(env):
+			return run_block(self.body, env)
+		if self.other is not None:
+			return run_block(self.other, env)
+		return None
+
+
+class While:
+	def __init__(self, cond, body):
+		self.cond = cond
+		self.body = body
+
+	def write(self, w, indent):
+		w.line(indent, "while (" + self.cond.text(w) + ")", w.tok("{"))
+		for stmt in self.body:
+			stmt.write(w, indent + 1)
+		w.line(indent, w.tok("}"))
+
+	def run(self, env):
+		while self.cond.eval(env):
+			res = run_block(self.body, env)
+			if res is not None:
+				return res
+		return None
+
+
+class CallStmt:
+	def __init__(self, call):
+		self.call = call
+
+	def write(self, w, indent):
+		w.line(indent, self.call.text(w), w.tok(";"))
+
+	def run(self, env):
+		self.call.eval(env)
+
+
+class Return:
+	def __init__(self, exp):
+		self.exp = exp
+
+	def write(self, w, indent):
+		if self.exp is None:
+			w.line(indent, w.tok("return"), w.tok(";"))
+		else:
+			w.line(indent, w.tok("return"), self.exp.text(w), w.tok(";"))
+
+	def run(self, env):
+		return ("ret", None if self.exp is None else self.exp.eval(env))
+
+
+class Decl:
+	def __init__(self, typ, name):
+		self.typ = typ
+		self.name = name
+
+	def write(self, w, indent):
+		w.line(indent, self.typ, self.name, w.tok(";"))
+
+	def run(self, env):
+		env.declare(self.name, self.typ)
+
+
+def run_block(stmts, env):
+	for stmt in stmts:
+		res = stmt.run(env)
+		if res is not None:
+			return res
+	return None
+
+
+class Env:
+	def __init__(self, program, frame):
+		self.program = program
+		self.frame = frame
+
+	def declare(self, name, typ):
+		self.frame[name] = self.program.fresh(typ)
+
+	def get(self, name):
+		if name in self.frame:
+			val = self.frame[name]
+		else:
+			val = self.program.globals[name]
+		if val is None:
+			raise GenError("read of unset " + name)
+		return val
+
+	def set(self, name, val):
+		if name in self.frame:
+			self.frame[name] = val
+		else:
+			self.program.globals[name] = val
+
+
+class Function:
+	def __init__(self, name, ret, formals):
+		self.name = name
+		self.ret = ret
+		self.formals = formals
+		self.body = []
+
+	def write(self, w):
+		formals = ", ".join(t + " " + n for t, n in self.formals)
+		w.line(0, self.ret, self.name + "(" + formals + ")", w.tok("{"))
+		for stmt in self.body:
+			stmt.write(w, 1)
+		w.line(0, w.tok("}"))
+
+	def run(self, program, args):
+		frame = {}
+		for (typ, name), val in zip(self.formals, args):
+			#Records go by value
+			frame[name] = dict(val) if isinstance(val, dict) else val
+		res = run_block(self.body, Env(program, frame))
+		return None if res is None else res[1]
+
+
+class Program:
+	def __init__(self):
+		self.records = {}
+		self.record_order = []
+		self.global_decls = []
+		self.globals = {}
+		self.functions = []
+		self.out = []
+
+	def fresh(self, typ):
+		"""The value of a newly declared variable: unset"""
+		if typ in self.records:
+			return {f: None for f, _ in self.records[typ]}
+		return None
+
+
+class Generator:
+	def __init__(self, opts):
+		self.opts = opts
+		self.rng = random.Random(opts.seed)
+		self.prog = Program()
+		self.counter = 0
+
+	def name(self, prefix):
+		"""A fresh identifier, padded out to --id-len"""
+		self.counter += 1
+		base = prefix + str(self.counter)
+		pad = self.opts.id_len - len(base)
+		if pad > 0:
+			base += "_" + "x" * (pad - 1)
+		return base
+
+	#Scope: what a function body can see
+
+	def int_leaf(self, scope):
+		rng = self.rng
+		pick = rng.random()
+		if pick < 0.25 or not scope["ints"]:
+			return Lit(rng.randint(-50, 999))
+		fields = scope["fields"] + scope["ro_fields"]
+		if pick < 0.45 and fields:
+			var, field = rng.choice(fields)
+			return Field(var, field)
+		return Var(rng.choice(scope["ints"]))
+
+	def int_term(self, scope):
+		rng = self.rng
+		pick = rng.random()
+		leaf = self.int_leaf(scope)
+		if pick < 0.2:
+			return Bin("*", leaf, self.int_leaf(scope))
+		if pick < 0.3:
+			other = self.int_leaf(scope)
+			divisor = Bin("+", Bin("*", other, other), Lit(1))
+			return Bin("/", leaf, divisor)
+		if pick < 0.35:
+			return Neg(leaf)
+		return leaf
+
+	def int_exp(self, scope):
+		exp = self.int_term(scope)
+		for _ in range(self.rng.randint(0, 2)):
+			exp = Bin(self.rng.choice("+-"), exp, self.int_term(scope))
+		return exp
+
+	def bool_exp(self, scope, depth=0):
+		rng = self.rng
+		pick = rng.random()
+		if pick < 0.15 and scope["bools"]:
+			return Var(rng.choice(scope["bools"]))
+		if pick < 0.25 and depth < 2:
+			op = rng.choice(["&&", "||"])
+			return Bin(op, self.bool_exp(scope, depth + 1),
+				self.bool_exp(scope, depth + 1))
+		if pick < 0.3 and depth < 2:
+			return Not(self.bool_exp(scope, depth + 1))
+		if pick < 0.33:
+			return BoolLit(rng.random() < 0.5)
+		op = rng.choice(["==", "!=", "<", "<=", ">", ">="])
+		return Bin(op, self.int_leaf(scope), self.int_leaf(scope))
+
+	def reduce(self, lval):
+		#lval = lval - lval / 997 * 997, within (-997, 997)
+		quot = Bin("*", Bin("/", lval, Lit(INT_BOUND)), Lit(INT_BOUND))
+		return Assign(lval, Bin("-", lval, quot))
+
+	def int_lval(self, scope):
+		if scope["fields"] and self.rng.random() < 0.3:
+			var, field = self.rng.choice(scope["fields"])
+			return Field(var, field)
+		return Var(self.rng.choice(scope["ints"]))
+
+	def stmts(self, fn, scope, count, depth, loops):
+		rng = self.rng
+		res = []
+		while count > 0:
+			pick = rng.random()
+			if depth < self.opts.depth and count > 3 and pick < 0.15:
+				inner = rng.randint(1, min(count - 1, 8))
+				count -= inner + 1
+				cond = self.bool_exp(scope)
+				body = self.stmts(fn, scope, inner, depth + 1, loops)
+				if rng.random() < 0.4:
+					other = self.stmts(fn, scope, max(1, inner // 2),
+						depth + 1, loops)
+					res.append(If(cond, body, other))
+				else:
+					res.append(If(cond, body))
+				continue
+			if depth < self.opts.depth and loops < MAX_LOOP_DEPTH \
+			  and count > 3 and pick < 0.25:
+				inner = rng.randint(1, min(count - 1, 6))
+				count -= inner + 1
+				ctr = self.name("k")
+				fn.body.insert(0, Decl("int", ctr))
+				res.append(Assign(Var(ctr), Lit(0)))
+				body = self.stmts(fn, scope, inner, depth + 1, loops + 1)
+				body.append(Step(Var(ctr), "++"))
+				limit = Lit(rng.randint(1, 4))
+				res.append(While(Bin("<", Var(ctr), limit), body))
+				continue
+			count -= 1
+			if pick < 0.32 and scope["bools"]:
+				res.append(Assign(Var(rng.choice(scope["bools"])),
+					self.bool_exp(scope)))
+			elif pick < 0.38:
+				lval = self.int_lval(scope)
+				res.append(Step(lval, rng.choice(["++", "--"])))
+				res.append(self.reduce(lval))
+			elif pick < 0.38 + self.opts.report_rate:
+				res.append(Report(self.int_leaf(scope)))
+				res.append(Report(Str(" ")))
+			else:
+				lval = self.int_lval(scope)
+				res.append(Assign(lval, self.int_exp(scope)))
+				res.append(self.reduce(lval))
+		return res
+
+	def record_types(self):
+		for _ in range(self.opts.records):
+			rname = self.name("R")
+			fields = []
+			for _ in range(self.opts.fields):
+				typ = "int" if self.rng.random() < 0.75 else "bool"
+				fields.append((self.name("f"), typ))
+			self.prog.records[rname] = fields
+			self.prog.record_order.append(rname)
+
+	def record_vars(self, decls, scope, count):
+		"""Declare record variables; returns their names and types"""
+		made = []
+		for _ in range(count):
+			if not self.prog.record_order:
+				break
+			rtype = self.rng.choice(self.prog.record_order)
+			var = self.name("r")
+			decls.append(Decl(rtype, var))
+			made.append((var, rtype))
+			for field, typ in self.prog.records[rtype]:
+				if typ == "int":
+					scope["fields"].append((var, field))
+		return made
+
+	def init_record(self, var, rtype):
+		res = []
+		for field, typ in self.prog.records[rtype]:
+			val = Lit(self.rng.randint(0, 99)) if typ == "int" \
+				else BoolLit(self.rng.random() < 0.5)
+			res.append(Assign(Field(var, field), val))
+		return res
+
+	def function(self, idx, callee):
+		rng = self.rng
+		ret = "int" if rng.random() < 0.7 else "void"
+		formals = []
+		for _ in range(rng.randint(0, 4)):
+			typ = "int" if rng.random() < 0.75 else "bool"
+			formals.append((typ, self.name("a")))
+		rec_formal = None
+		if self.prog.record_order and rng.random() < 0.15:
+			rec_formal = (rng.choice(self.prog.record_order), self.name("p"))
+			formals.append(rec_formal)
+		fn = Function(self.name("fn"), ret, formals)
+
+		scope = {
+			"ints": [n for t, n in formals if t == "int"] + self.global_ints,
+			"bools": [n for t, n in formals if t == "bool"] + self.global_bools,
+			"fields": list(self.global_fields),
+			#A record formal's fields are only read
+			"ro_fields": [],
+		}
+		if rec_formal is not None:
+			rtype, var = rec_formal
+			scope["ro_fields"] = [(var, f)
+				for f, t in self.prog.records[rtype] if t == "int"]
+
+		decls = []
+		init = []
+		for _ in range(rng.randint(1, 4)):
+			var = self.name("v")
+			decls.append(Decl("int", var))
+			init.append(Assign(Var(var), Lit(rng.randint(0, 99))))
+			scope["ints"].append(var)
+		for _ in range(rng.randint(0, 2)):
+			var = self.name("b")
+			decls.append(Decl("bool", var))
+			init.append(Assign(Var(var), BoolLit(rng.random() < 0.5)))
+			scope["bools"].append(var)
+		for var, rtype in self.record_vars(decls, scope, rng.randint(0, 1)):
+			init += self.init_record(var, rtype)
+
+		body = self.stmts(fn, scope, self.opts.stmts, 0, 0)
+
+		#The chain call, then a return
+		tail = []
+		if callee is not None:
+			args = []
+			for typ, _ in callee.formals:
+				if typ == "int":
+					args.append(self.int_leaf(scope))
+				elif typ == "bool":
+					args.append(self.bool_exp(scope))
+				else:
+					args.append(Var(self.record_arg(typ, scope, decls, init)))
+			call = Call(callee, args)
+			if callee.ret == "int":
+				dst = Var(rng.choice(scope["ints"]))
+				tail.append(Assign(dst, call))
+				tail.append(self.reduce(dst))
+			else:
+				tail.append(CallStmt(call))
+		if ret == "int":
+			tail.append(Return(self.int_exp(scope)))
+		elif rng.random() < 0.5:
+			tail.append(Return(None))
+
+		#Loop counters were put at the front of fn.body as they
+		# were made; the other locals go after them
+		fn.body = fn.body + decls + init + body + tail
+		return fn
+
+	def record_arg(self, rtype, scope, decls, init):
+		"""A variable of record type rtype to pass as an argument"""
+		var = self.name("r")
+		decls.append(Decl(rtype, var))
+		init += self.init_record(var, rtype)
+		return var
+
+	def generate(self):
+		opts = self.opts
+		prog = self.prog
+		self.record_types()
+
+		self.global_ints = []
+		self.global_bools = []
+		self.global_fields = []
+		gscope = {"ints": self.global_ints, "bools": [],
+			"fields": self.global_fields, "ro_fields": []}
+		for _ in range(opts.globals):
+			var = self.name("g")
+			prog.global_decls.append(Decl("int", var))
+			self.global_ints.append(var)
+		var = self.name("gb")
+		prog.global_decls.append(Decl("bool", var))
+		self.global_bools.append(var)
+		grecs = self.record_vars(prog.global_decls, gscope,
+			min(2, len(prog.record_order)))
+
+		#Function i calls i - 1, except at the start of a chain
+		heads = []
+		for idx in range(opts.functions):
+			callee = None
+			if idx % opts.chain != 0:
+				callee = prog.functions[-1]
+			fn = self.function(idx, callee)
+			prog.functions.append(fn)
+			if idx % opts.chain == opts.chain - 1 or idx == opts.functions - 1:
+				heads.append(fn)
+
+		main = Function("main", "int", [])
+		scope = {"ints": list(self.global_ints),
+			"bools": list(self.global_bools),
+			"fields": list(self.global_fields), "ro_fields": []}
+		decls = []
+		init = []
+		for var in self.global_ints:
+			init.append(Assign(Var(var), Lit(self.rng.randint(0, 99))))
+		for var in self.global_bools:
+			init.append(Assign(Var(var), BoolLit(True)))
+		for var, rtype in grecs:
+			init += self.init_record(var, rtype)
+		calls = []
+		for head in heads:
+			args = []
+			for typ, _ in head.formals:
+				if typ == "int":
+					args.append(self.int_leaf(scope))
+				elif typ == "bool":
+					args.append(self.bool_exp(scope))
+				else:
+					args.append(Var(self.record_arg(typ, scope, decls, init)))
+			if head.ret == "int":
+				calls.append(Report(Call(head, args)))
+				calls.append(Report(Str("\n")))
+			else:
+				calls.append(CallStmt(Call(head, args)))
+		for var in self.global_ints[:4]:
+			calls.append(Report(Var(var)))
+			calls.append(Report(Str("\n")))
+		main.body = decls + init + calls + [Return(Lit(0))]
+		prog.functions.append(main)
+		return prog
+
+
+def write_program(prog, opts, argv):
+	w = Writer(random.Random(opts.seed * 7919 + 1), opts.alias_mix)
+	w.line(0, "// Generated by gen_cshanty.py " + " ".join(argv))
+	for rname in prog.record_order:
+		w.line(0, "record", rname, w.tok("{"))
+		for field, typ in prog.records[rname]:
+			w.line(1, typ, field, w.tok(";"))
+		w.line(0, w.tok("}"))
+	for decl in prog.global_decls:
+		decl.write(w, 0)
+	for fn in prog.functions:
+		fn.write(w)
+	return "\n".join(w.lines) + "\n"
+
+
+def run_program(prog):
+	for decl in prog.global_decls:
+		prog.globals[decl.name] = prog.fresh(decl.typ)
+	main = prog.functions[-1]
+	main.run(prog, [])
+	return "".join(prog.out)
+
+
+def main():
+	parser = argparse.ArgumentParser(
+		description="Generate a CShanty program and its expected output")
+	parser.add_argument("-o", "--out", required=True,
+		help="output path, without extension")
+	parser.add_argument("--seed", type=int, default=1)
+	parser.add_argument("--functions", type=int, default=100)
+	parser.add_argument("--stmts", type=int, default=20,
+		help="statements per function body")
+	parser.add_argument("--depth", type=int, default=4,
+		help="deepest nesting of if/while")
+	parser.add_argument("--records", type=int, default=3,
+		help="record types")
+	parser.add_argument("--fields", type=int, default=4,
+		help="fields per record type")
+	parser.add_argument("--globals", type=int, default=8,
+		help="global int variables")
+	parser.add_argument("--id-len", type=int, default=6,
+		help="pad identifiers out to this length")
+	parser.add_argument("--alias-mix", type=float, default=0.0,
+		help="chance (0-1) of spelling a keyword with an alias")
+	parser.add_argument("--chain", type=int, default=16,
+		help="functions per call chain started from main")
+	parser.add_argument("--report-rate", type=float, default=0.05,
+		help="share of statements that report a value")
+	opts = parser.parse_args()
+	if opts.functions < 1 or opts.chain < 1 or opts.stmts < 1:
+		parser.error("--functions, --chain and --stmts must be positive")
+
+	sys.setrecursionlimit(max(10000, 50 * opts.chain + 1000))
+	prog = Generator(opts).generate()
+	try:
+		expected = run_program(prog)
+	except GenError as e:
+		sys.exit("gen_cshanty: generated a bad program (" + str(e)
+			+ "); this is a generator bug")
+	with open(opts.out + ".cshanty", "w") as f:
+		f.write(write_program(prog, opts, sys.argv[1:]))
+	with open(opts.out + ".in", "w") as f:
+		pass
+	with open(opts.out + ".out.expected", "w") as f:
+		f.write(expected)
+
+
+if __name__ == "__main__":
+	main()
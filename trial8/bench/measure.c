@@ -0,0 +1,65 @@
+// Runs a command and writes its wall time (s), peak RSS (KB) and wait
+// status to <result>. run_bench.py uses this rather than timing the
+// child itself because Linux carries the high-water RSS of whatever
+// forked a process over into that process's ru_maxrss, and Python's
+// own RSS would swamp a small program's.
+//
+// Usage: measure <result> <stdin|-> <stdout|-> <cmd> [args...]
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+static void redirect(const char * path, int fd, int flags){
+	if (path[0] == '-' && path[1] == '\0'){ return; }
+	int opened = open(path, flags, 0644);
+	if (opened < 0 || dup2(opened, fd) < 0){
+		perror(path);
+		_exit(127);
+	}
+	close(opened);
+}
+
+int main(int argc, char ** argv){
+	if (argc < 5){
+		fprintf(stderr, "Usage: measure <result> <stdin|-> <stdout|->"
+			" <cmd> [args...]\n");
+		return 2;
+	}
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	pid_t pid = fork();
+	if (pid < 0){
+		perror("fork");
+		return 2;
+	}
+	if (pid == 0){
+		redirect(argv[2], 0, O_RDONLY);
+		redirect(argv[3], 1, O_WRONLY | O_CREAT | O_TRUNC);
+		execvp(argv[4], argv + 4);
+		perror(argv[4]);
+		_exit(127);
+	}
+	int status = 0;
+	struct rusage usage;
+	if (wait4(pid, &status, 0, &usage) < 0){
+		perror("wait4");
+		return 2;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double seconds = (double)(end.tv_sec - start.tv_sec)
+		+ (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+
+	FILE * result = fopen(argv[1], "w");
+	if (result == NULL){
+		perror(argv[1]);
+		return 2;
+	}
+	fprintf(result, "%.9f %ld %d\n", seconds, usage.ru_maxrss, status);
+	fclose(result);
+	return 0;
+}
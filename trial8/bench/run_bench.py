@@ -0,0 +1,382 @@
+#!/usr/bin/env python3
+"""Run the CShanty workloads in bench/workloads through every backend.
+
+Each workload is a .cshanty program, with an optional .in that is
+fed to it and a .out.expected that its output must match. The
+backends are:
+  interp        the trial5 tree-walking interpreter (dragoninterp)
+  x64           this compiler's x64 output (-o), assembled and linked
+  x64-peephole  trial7's x64 output, which runs its peephole pass
+  c             this compiler's C transpilation (-l), built with cc -O2
+
+For every workload and backend the program is compiled and run
+--repeat times (after --warmup untimed runs), recording the wall
+time and peak RSS of the compiler and of the program; both are
+taken by measure.c, which is built with --cc when the run starts. Only our own
+compilers are timed as "compile": as, ld and cc are not. The one
+exception is clang: cshantyc -l runs it on the C it writes, to emit
+LLVM, so when clang is installed the c backend's compile time and
+RSS include it. The interpreter has no compile step, and since it
+reports values in its own format (strings quoted, one report per
+line, 32-bit ints) its output is not checked.
+
+A backend whose tool is missing is skipped. With --save-baseline
+the medians are written out; with --baseline they are compared to
+an earlier run, and any that got worse by more than --threshold is
+flagged. The exit status is 1 if a workload failed or regressed.
+
+Usage:
+  run_bench.py --repeat 10 --save-baseline base.json
+  run_bench.py --baseline base.json --backends x64,c
+"""
+
+import argparse
+import json
+import os
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+BENCH_DIR = os.path.dirname(os.path.abspath(__file__))
+TRIAL8_DIR = os.path.dirname(BENCH_DIR)
+REPO_DIR = os.path.dirname(TRIAL8_DIR)
+
+BACKENDS = ["interp", "x64", "x64-peephole", "c"]
+
+#Differences smaller than these are noise, whatever the threshold
+TIME_FLOOR_S = 0.002
+RSS_FLOOR_KB = 256
+
+
+class BenchError(Exception):
+	pass
+
+
+class Sample:
+	"""Wall time (s) and peak RSS (KB) of one child process"""
+	def __init__(self, seconds, rss_kb):
+		self.seconds = seconds
+		self.rss_kb = rss_kb
+
+
+def measure(launcher, cmd, stdin_path=None, stdout_path=None, check=True):
+	"""Run cmd to completion through the measure launcher, which
+	times it and reads its peak RSS"""
+	result = tempfile.NamedTemporaryFile(prefix="measure-", delete=False)
+	result.close()
+	err = tempfile.TemporaryFile()
+	try:
+		launch = subprocess.run([launcher, result.name, stdin_path or "-",
+			stdout_path or "/dev/null"] + cmd, stderr=err)
+		with open(result.name) as f:
+			fields = f.read().split()
+		err.seek(0)
+		msg = err.read().decode(errors="replace").strip()
+	finally:
+		err.close()
+		os.remove(result.name)
+	if launch.returncode != 0 or len(fields) != 3:
+		raise BenchError("could not run " + " ".join(cmd) + ": " + msg)
+	seconds, rss_kb, status = float(fields[0]), int(fields[1]), int(fields[2])
+	if check and status != 0:
+		reason = msg.splitlines()[-1] if msg else "wait status %d" % status
+		raise BenchError(" ".join(cmd) + " failed: " + reason)
+	return Sample(seconds, rss_kb)
+
+
+def run_tool(cmd):
+	"""Run an untimed helper (as, cc, ...)"""
+	res = subprocess.run(cmd, stdout=subprocess.DEVNULL,
+		stderr=subprocess.PIPE)
+	if res.returncode != 0:
+		raise BenchError(" ".join(cmd) + " failed: "
+			+ res.stderr.decode(errors="replace").strip())
+
+
+class Backend:
+	"""How to turn a workload into something runnable. build() returns
+	the command that runs the program and the compile step to time,
+	if there is one, as a zero-argument function returning a Sample."""
+	def __init__(self, name, tool, work, cc, launcher):
+		self.name = name
+		self.tool = tool
+		self.work = work
+		self.cc = cc
+		self.launcher = launcher
+		self.checks_output = name != "interp"
+		self.runtime = None
+
+	def available(self):
+		return self.tool is not None and os.access(self.tool, os.X_OK)
+
+	def stdcshanty(self):
+		"""The runtime library compiled programs are linked against"""
+		if self.runtime is None:
+			self.runtime = os.path.join(self.work, "stdcshanty.o")
+			if not os.path.exists(self.runtime):
+				run_tool([self.cc, "-c", "-O2", "-o", self.runtime,
+					os.path.join(TRIAL8_DIR, "stdcshanty.c")])
+		return self.runtime
+
+	def build(self, src, base):
+		if self.name == "interp":
+			#The interpreter runs top-level statements and never
+			# calls main itself
+			prog = base + ".interp.cshanty"
+			with open(src) as f:
+				text = f.read()
+			with open(prog, "w") as f:
+				f.write(text + "\nmain();\n")
+			return [self.tool, prog], None
+
+		exe = base + "." + self.name
+		if self.name in ("x64", "x64-peephole"):
+			asm = exe + ".s"
+			compile_cmd = [self.tool, src, "-o", asm]
+			def link():
+				run_tool([self.cc, "-no-pie", "-o", exe, asm,
+					self.stdcshanty()])
+		else:
+			#-l transpiles to <file>.c and then hands that to clang
+			# for LLVM; only the C is needed here, so a missing
+			# clang is not a failure. A present one is timed
+			# along with the transpile.
+			ll = exe + ".ll"
+			compile_cmd = [self.tool, src, "-l", ll]
+			def link():
+				if not os.path.exists(ll + ".c"):
+					raise BenchError(" ".join(compile_cmd)
+						+ " wrote no C")
+				run_tool([self.cc, "-O2", "-w", "-o", exe, ll + ".c",
+					os.path.join(TRIAL8_DIR, "stdcshanty.c")])
+		check = self.name != "c"
+
+		def compile_step():
+			for path in (exe, exe + ".s", exe + ".ll.c"):
+				if os.path.exists(path):
+					os.remove(path)
+			sample = measure(self.launcher, compile_cmd, check=check)
+			link()
+			return sample
+		return [exe], compile_step
+
+
+def summarize(values):
+	res = {
+		"min": min(values),
+		"median": statistics.median(values),
+		"mean": statistics.mean(values),
+		"stdev": statistics.stdev(values) if len(values) > 1 else 0.0,
+	}
+	return res
+
+
+def bench_one(backend, workload, src, opts):
+	base = os.path.join(backend.work, workload)
+	in_path = os.path.splitext(src)[0] + ".in"
+	if not os.path.exists(in_path):
+		in_path = None
+	expected_path = os.path.splitext(src)[0] + ".out.expected"
+	out_path = base + "." + backend.name + ".out"
+
+	run_cmd, compile_step = backend.build(src, base)
+	compiles = []
+	runs = []
+	for i in range(opts.warmup + opts.repeat):
+		if compile_step is not None:
+			sample = compile_step()
+			if i >= opts.warmup:
+				compiles.append(sample)
+		sample = measure(backend.launcher, run_cmd, in_path, out_path)
+		if i >= opts.warmup:
+			runs.append(sample)
+		if i == 0 and backend.checks_output \
+			and os.path.exists(expected_path):
+			with open(out_path, "rb") as got, \
+				open(expected_path, "rb") as want:
+				if got.read() != want.read():
+					raise BenchError("output differs from "
+						+ os.path.basename(expected_path))
+
+	res = {
+		"run_s": summarize([s.seconds for s in runs]),
+		"run_rss_kb": max(s.rss_kb for s in runs),
+	}
+	if compiles:
+		res["compile_s"] = summarize([s.seconds for s in compiles])
+		res["compile_rss_kb"] = max(s.rss_kb for s in compiles)
+	return res
+
+
+def fmt_time(stats):
+	if stats is None:
+		return "-"
+	return "%8.2f ±%6.2f" % (stats["median"] * 1000, stats["stdev"] * 1000)
+
+
+def print_row(workload, backend, res):
+	if "error" in res:
+		print("%-12s %-13s FAILED: %s" % (workload, backend, res["error"]))
+		return
+	print("%-12s %-13s %17s %8s %17s %9.2f %9d" % (workload, backend,
+		fmt_time(res.get("compile_s")),
+		res.get("compile_rss_kb", "-"),
+		fmt_time(res["run_s"]),
+		res["run_s"]["min"] * 1000,
+		res["run_rss_kb"]))
+
+
+#Metrics compared against a baseline: (name, how to read it, floor)
+METRICS = [
+	("compile ms", lambda r: r["compile_s"]["median"], TIME_FLOOR_S),
+	("compile KB", lambda r: r["compile_rss_kb"], RSS_FLOOR_KB),
+	("run ms", lambda r: r["run_s"]["median"], TIME_FLOOR_S),
+	("run KB", lambda r: r["run_rss_kb"], RSS_FLOOR_KB),
+]
+
+
+def compare(results, baseline, threshold):
+	"""Print how each result moved since the baseline; returns the
+	number of regressions"""
+	regressions = 0
+	print("\nCompared with the baseline (threshold %.0f%%):"
+		% (threshold * 100))
+	for key in sorted(results):
+		new = results[key]
+		old = baseline.get(key)
+		if old is None or "error" in new or "error" in old:
+			continue
+		for name, get, floor in METRICS:
+			try:
+				before = get(old)
+				after = get(new)
+			except KeyError:
+				continue
+			if before <= 0:
+				continue
+			change = (after - before) / before
+			if abs(after - before) < floor or abs(change) <= threshold:
+				continue
+			scale = 1000 if name.endswith("ms") else 1
+			verdict = "REGRESSION" if change > 0 else "improved"
+			if change > 0:
+				regressions += 1
+			print("  %-26s %-10s %10.2f -> %10.2f (%+.1f%%) %s" % (key,
+				name, before * scale, after * scale, change * 100, verdict))
+	missing = [key for key in baseline if key not in results]
+	if missing:
+		print("  %d baseline result(s) not run this time" % len(missing))
+	if regressions == 0:
+		print("  no regressions")
+	return regressions
+
+
+def main():
+	parser = argparse.ArgumentParser(
+		description="Benchmark the CShanty workloads on every backend")
+	parser.add_argument("--workloads", default=os.path.join(BENCH_DIR,
+		"workloads"), help="directory of .cshanty workloads")
+	parser.add_argument("--only", default=None,
+		help="comma-separated workload names to run")
+	parser.add_argument("--backends", default=",".join(BACKENDS),
+		help="comma-separated subset of " + ",".join(BACKENDS))
+	parser.add_argument("--repeat", type=int, default=5,
+		help="timed runs per workload and backend")
+	parser.add_argument("--warmup", type=int, default=1,
+		help="untimed runs before those")
+	parser.add_argument("--baseline", default=None,
+		help="compare against results saved by --save-baseline")
+	parser.add_argument("--save-baseline", default=None,
+		help="write this run's results here")
+	parser.add_argument("--threshold", type=float, default=0.10,
+		help="relative slowdown that counts as a regression")
+	parser.add_argument("--cshantyc", default=os.path.join(TRIAL8_DIR,
+		"cshantyc"))
+	parser.add_argument("--peephole-cshantyc", default=os.path.join(
+		REPO_DIR, "trial7", "cshantyc"))
+	parser.add_argument("--interp", default=os.path.join(REPO_DIR,
+		"trial5", "dragoninterp"))
+	parser.add_argument("--cc", default=os.environ.get("CC", "cc"))
+	parser.add_argument("--keep", action="store_true",
+		help="keep the build directory and say where it is")
+	opts = parser.parse_args()
+	if opts.repeat < 1 or opts.warmup < 0:
+		parser.error("--repeat must be positive and --warmup not negative")
+
+	names = opts.backends.split(",")
+	for name in names:
+		if name not in BACKENDS:
+			parser.error("unknown backend " + name)
+	workloads = sorted(f[:-len(".cshanty")] for f in os.listdir(
+		opts.workloads) if f.endswith(".cshanty"))
+	if opts.only:
+		wanted = opts.only.split(",")
+		for name in wanted:
+			if name not in workloads:
+				parser.error("no workload named " + name)
+		workloads = [w for w in workloads if w in wanted]
+
+	work = tempfile.mkdtemp(prefix="cshanty-bench-")
+	tools = {
+		"interp": opts.interp,
+		"x64": opts.cshantyc,
+		"x64-peephole": opts.peephole_cshantyc,
+		"c": opts.cshantyc,
+	}
+	launcher = os.path.join(work, "measure")
+	run_tool([opts.cc, "-O2", "-o", launcher,
+		os.path.join(BENCH_DIR, "measure.c")])
+	backends = []
+	for name in names:
+		backend = Backend(name, tools[name], work, opts.cc, launcher)
+		if backend.available():
+			backends.append(backend)
+		else:
+			print("skipping %s: no %s" % (name, tools[name]))
+
+	print("%d timed run(s) each; times in ms as median ±stdev\n"
+		% opts.repeat)
+	print("%-12s %-13s %17s %8s %17s %9s %9s" % ("workload", "backend",
+		"compile", "comp KB", "run", "run min", "run KB"))
+	results = {}
+	failures = 0
+	try:
+		for workload in workloads:
+			src = os.path.join(os.path.abspath(opts.workloads),
+				workload + ".cshanty")
+			for backend in backends:
+				key = workload + "/" + backend.name
+				try:
+					res = bench_one(backend, workload, src, opts)
+				except BenchError as e:
+					res = {"error": str(e)}
+					failures += 1
+				results[key] = res
+				print_row(workload, backend.name, res)
+				sys.stdout.flush()
+	finally:
+		if opts.keep:
+			print("\nbuilds kept in " + work)
+		else:
+			shutil.rmtree(work, ignore_errors=True)
+
+	regressions = 0
+	if opts.baseline:
+		with open(opts.baseline) as f:
+			saved = json.load(f)
+		regressions = compare(results, saved["results"], opts.threshold)
+	if opts.save_baseline:
+		with open(opts.save_baseline, "w") as f:
+			json.dump({"repeat": opts.repeat, "results": results}, f,
+				indent=1, sort_keys=True)
+			f.write("\n")
+	if failures:
+		print("\n%d workload(s) failed" % failures)
+	return 1 if failures or regressions else 0
+
+
+if __name__ == "__main__":
+	sys.exit(main())
@@ -0,0 +1,109 @@
+//Micro-benchmarks for SymbolTable. Build with "make symtab_bench"
+// and run bench/symtab_bench [scale]; each case prints the time per
+// operation. The cases mirror what name analysis does to the table:
+//  deep:    nested scopes, each shadowing the same names, with
+//           lookups that resolve both nearby and at global scope
+//  globals: 100k globals, then many small function scopes that
+//           look them up
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "../symbol_table.hpp"
+
+using namespace cshanty;
+
+using Clock = std::chrono::steady_clock;
+
+static double nsPer(Clock::time_point start, size_t ops){
+	std::chrono::duration<double, std::nano> spent = Clock::now() - start;
+	return spent.count() / static_cast<double>(ops);
+}
+
+static std::vector<std::string> names(const char * prefix, size_t count){
+	std::vector<std::string> res;
+	res.reserve(count);
+	for (size_t i = 0; i < count; i++){
+		res.push_back(prefix + std::to_string(i));
+	}
+	return res;
+}
+
+//Shadow a handful of names at every level of a deep nest, looking
+// them (and some globals) up on the way down
+static void deep(size_t scale){
+	const DataType * intType = BasicType::produce(INT);
+	size_t depth = 2000 * scale;
+	std::vector<std::string> globals = names("g", 64);
+	std::vector<std::string> locals = names("v", 4);
+	size_t found = 0;
+	size_t ops = 0;
+
+	Clock::time_point start = Clock::now();
+	for (int rep = 0; rep < 10; rep++){
+		SymbolTable table;
+		table.enterScope();
+		for (const std::string& name : globals){ table.addVar(name, intType); }
+		for (size_t d = 0; d < depth; d++){
+			table.enterScope();
+			for (const std::string& name : locals){
+				table.addVar(name, intType);
+			}
+			for (size_t i = 0; i < 8; i++){
+				found += table.find(locals[i % locals.size()]) != nullptr;
+				found += table.find(globals[(d + i) % globals.size()]) != nullptr;
+			}
+			ops += locals.size() + 16;
+		}
+		for (size_t d = 0; d < depth; d++){ table.leaveScope(); }
+		table.leaveScope();
+	}
+	double ns = nsPer(start, ops);
+	printf("deep     depth=%zu  %.1f ns/op (%zu found)\n", depth, ns, found);
+}
+
+//A large global scope, then one short-lived scope per "function"
+static void manyGlobals(size_t scale){
+	const DataType * intType = BasicType::produce(INT);
+	size_t count = 100000 * scale;
+	std::vector<std::string> globals = names("global_", count);
+	std::vector<std::string> locals = names("local_", 8);
+	size_t found = 0;
+
+	SymbolTable table;
+	table.enterScope();
+	Clock::time_point start = Clock::now();
+	for (const std::string& name : globals){ table.addVar(name, intType); }
+	double insertNs = nsPer(start, count);
+
+	start = Clock::now();
+	size_t ops = 0;
+	unsigned long long seed = 12345;
+	for (size_t fn = 0; fn < count / 4; fn++){
+		table.enterScope();
+		for (const std::string& name : locals){ table.addVar(name, intType); }
+		for (size_t i = 0; i < 16; i++){
+			seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+			size_t pick = static_cast<size_t>(seed >> 33) % count;
+			found += table.find(globals[pick]) != nullptr;
+			found += table.find(locals[i % locals.size()]) != nullptr;
+		}
+		table.leaveScope();
+		ops += locals.size() + 32;
+	}
+	double lookupNs = nsPer(start, ops);
+	table.leaveScope();
+	printf("globals  n=%zu  insert %.1f ns/op, "
+		"scoped lookups %.1f ns/op (%zu found)\n",
+		count, insertNs, lookupNs, found);
+}
+
+int main(int argc, char * argv[]){
+	size_t scale = 1;
+	if (argc > 1){ scale = static_cast<size_t>(atol(argv[1])); }
+	if (scale == 0){ scale = 1; }
+	deep(scale);
+	manyGlobals(scale);
+	return 0;
+}
@@ -0,0 +1,566 @@
+#include <algorithm>
+#include <iterator>
+#include "cfg.hpp"
+
+namespace cshanty{
+
+IfzQuad * BasicBlock::getIfz() const{
+	if (quads.empty()){ return nullptr; }
+	return dynamic_cast<IfzQuad *>(quads.back());
+}
+
+static void removeOne(std::vector<BasicBlock *>& list, BasicBlock * block){
+	auto found = std::find(list.begin(), list.end(), block);
+	if (found != list.end()){ list.erase(found); }
+}
+
+//Take pred out of block's predecessors, along with the operand
+// each of block's phis has for it
+static void dropPred(BasicBlock * block, BasicBlock * pred){
+	auto found = std::find(block->preds.begin(), block->preds.end(), pred);
+	if (found == block->preds.end()){ return; }
+	size_t idx = static_cast<size_t>(found - block->preds.begin());
+	for (Quad * quad : block->quads){
+		PhiQuad * phi = dynamic_cast<PhiQuad *>(quad);
+		if (phi == nullptr){ break; }
+		phi->getSrcs().erase(phi->getSrcs().begin()
+			+ static_cast<std::ptrdiff_t>(idx));
+	}
+	block->preds.erase(found);
+}
+
+BasicBlock * CFG::makeBlock(){
+	BasicBlock * block = new BasicBlock();
+	block->id = blocks.size();
+	return block;
+}
+
+CFG * CFG::build(Procedure * proc){
+	CFG * cfg = new CFG(proc);
+	cfg->entry = cfg->makeBlock();
+	cfg->blocks.push_back(cfg->entry);
+	cfg->exit = new BasicBlock();
+	cfg->exit->label = proc->getLeaveLabel();
+
+	//Where each block's goto or IFZ went, by label, until every
+	// label has been seen
+	HashMap<Label *, BasicBlock *> labelBlocks;
+	labelBlocks[proc->getLeaveLabel()] = cfg->exit;
+	std::vector<Label *> jumps;
+	std::vector<bool> fallsThrough;
+	jumps.push_back(nullptr);
+	fallsThrough.push_back(true);
+
+	BasicBlock * cur = cfg->makeBlock();
+	cfg->blocks.push_back(cur);
+	jumps.push_back(nullptr);
+	fallsThrough.push_back(true);
+	auto startBlock = [&](bool reachedByFall){
+		fallsThrough.back() = reachedByFall;
+		cur = cfg->makeBlock();
+		cfg->blocks.push_back(cur);
+		jumps.push_back(nullptr);
+		fallsThrough.push_back(true);
+	};
+	for (Quad * quad : *proc->getQuads()){
+		if (!quad->getLabels().empty()){
+			if (!cur->quads.empty()){ startBlock(true); }
+			for (Label * label : quad->getLabels()){
+				labelBlocks[label] = cur;
+			}
+			if (cur->label == nullptr){ cur->label = quad->getLabel(); }
+		}
+		if (dynamic_cast<NopQuad *>(quad) != nullptr){ continue; }
+		if (GotoQuad * jmp = dynamic_cast<GotoQuad *>(quad)){
+			jumps.back() = jmp->getTarget();
+			startBlock(false);
+		} else if (IfzQuad * ifz = dynamic_cast<IfzQuad *>(quad)){
+			cur->quads.push_back(ifz);
+			jumps.back() = ifz->getTarget();
+			startBlock(true);
+		} else {
+			cur->quads.push_back(quad);
+		}
+	}
+	cfg->blocks.push_back(cfg->exit);
+	cfg->exit->id = cfg->blocks.size() - 1;
+
+	for (size_t i = 0; i + 1 < cfg->blocks.size(); i++){
+		BasicBlock * block = cfg->blocks[i];
+		if (fallsThrough[i]){
+			cfg->addEdge(block, cfg->blocks[i + 1]);
+		}
+		if (jumps[i] == nullptr){ continue; }
+		auto found = labelBlocks.find(jumps[i]);
+		if (found == labelBlocks.end()){
+			throw new InternalError("Branch to a label outside its procedure");
+		}
+		BasicBlock * target = found->second;
+		if (fallsThrough[i] && target == block->succs[0]){
+			//An IFZ to where it would fall anyway
+			block->quads.pop_back();
+			continue;
+		}
+		cfg->addEdge(block, target);
+	}
+	return cfg;
+}
+
+CFG::~CFG(){
+	for (BasicBlock * block : blocks){ delete block; }
+	for (Loop * loop : loops){ delete loop; }
+}
+
+BasicBlock * CFG::addBlock(BasicBlock * before){
+	BasicBlock * block = makeBlock();
+	auto pos = std::find(blocks.begin(), blocks.end(), before);
+	blocks.insert(pos, block);
+	return block;
+}
+
+void CFG::addEdge(BasicBlock * from, BasicBlock * to){
+	from->succs.push_back(to);
+	to->preds.push_back(from);
+}
+
+BasicBlock * CFG::splitEdge(BasicBlock * from, BasicBlock * to){
+	BasicBlock * mid = addBlock(to);
+	std::replace(from->succs.begin(), from->succs.end(), to, mid);
+	std::replace(to->preds.begin(), to->preds.end(), from, mid);
+	mid->preds.push_back(from);
+	mid->succs.push_back(to);
+	return mid;
+}
+
+void CFG::redirect(BasicBlock * from, BasicBlock * oldTo,
+	BasicBlock * newTo){
+	removeOne(oldTo->preds, from);
+	bool already = std::find(from->succs.begin(), from->succs.end(),
+		newTo) != from->succs.end();
+	if (already){
+		//Both ways out of the IFZ now lead to the same place
+		removeOne(from->succs, oldTo);
+		from->quads.pop_back();
+		return;
+	}
+	std::replace(from->succs.begin(), from->succs.end(), oldTo, newTo);
+	newTo->preds.push_back(from);
+}
+
+void CFG::removeEdge(BasicBlock * from, BasicBlock * to){
+	if (from->getIfz() == nullptr || from->succs.size() != 2){
+		throw new InternalError("Removing a block's only way out");
+	}
+	from->quads.pop_back();
+	removeOne(from->succs, to);
+	dropPred(to, from);
+}
+
+BasicBlock * CFG::addPreheader(Loop * loop){
+	BasicBlock * header = loop->header;
+	std::vector<BasicBlock *> inside;
+	std::vector<BasicBlock *> outside;
+	for (BasicBlock * pred : header->preds){
+		if (loop->contains(pred)){ inside.push_back(pred); }
+		else { outside.push_back(pred); }
+	}
+	if (outside.size() == 1){
+		BasicBlock * pred = outside.front();
+		//The entry stays empty
+		if (pred != entry && pred->succs.size() == 1){ return pred; }
+		return splitEdge(pred, header);
+	}
+
+	BasicBlock * pre = addBlock(header);
+	for (Quad * quad : header->quads){
+		PhiQuad * phi = dynamic_cast<PhiQuad *>(quad);
+		if (phi == nullptr){ break; }
+		Opd * dst = proc->makeTmp(phi->getDst()->getWidth());
+		PhiQuad * merged = new PhiQuad(dst, outside.size());
+		std::vector<Opd *> srcs;
+		size_t next = 0;
+		for (size_t i = 0; i < header->preds.size(); i++){
+			if (loop->contains(header->preds[i])){
+				srcs.push_back(phi->getSrcs()[i]);
+			} else {
+				merged->getSrcs()[next++] = phi->getSrcs()[i];
+			}
+		}
+		srcs.push_back(dst);
+		phi->getSrcs().swap(srcs);
+		pre->quads.push_back(merged);
+	}
+	header->preds.swap(inside);
+	header->preds.push_back(pre);
+	for (BasicBlock * pred : outside){
+		std::replace(pred->succs.begin(), pred->succs.end(), header, pre);
+		pre->preds.push_back(pred);
+	}
+	pre->succs.push_back(header);
+	return pre;
+}
+
+bool CFG::removeUnreachable(){
+	for (BasicBlock * block : blocks){ block->reached = false; }
+	std::vector<BasicBlock *> work;
+	entry->reached = true;
+	work.push_back(entry);
+	while (!work.empty()){
+		BasicBlock * block = work.back();
+		work.pop_back();
+		for (BasicBlock * succ : block->succs){
+			if (!succ->reached){
+				succ->reached = true;
+				work.push_back(succ);
+			}
+		}
+	}
+
+	std::vector<BasicBlock *> kept;
+	std::vector<BasicBlock *> dropped;
+	for (BasicBlock * block : blocks){
+		if (block->reached || block == exit){
+			kept.push_back(block);
+		} else {
+			dropped.push_back(block);
+		}
+	}
+	//A dropped block's predecessors are all dropped too, so only
+	// the kept blocks it leads to need fixing
+	for (BasicBlock * block : dropped){
+		for (BasicBlock * succ : block->succs){
+			if (succ->reached || succ == exit){ dropPred(succ, block); }
+		}
+	}
+	for (BasicBlock * block : dropped){ delete block; }
+	bool changed = kept.size() != blocks.size();
+	blocks.swap(kept);
+	return changed;
+}
+
+bool CFG::simplify(){
+	bool changed = removeUnreachable();
+	bool again = true;
+	while (again){
+		again = false;
+		for (size_t i = 0; i < blocks.size(); i++){
+			BasicBlock * block = blocks[i];
+			if (block == entry || block == exit){ continue; }
+			if (block->succs.size() != 1){ continue; }
+			BasicBlock * next = block->succs[0];
+			if (next == block){ continue; }
+			if (block->quads.empty()){
+				//Nothing happens here, so go straight on
+				std::vector<BasicBlock *> preds = block->preds;
+				for (BasicBlock * pred : preds){
+					redirect(pred, block, next);
+				}
+				again = again || !preds.empty();
+			} else if (next != exit && next->preds.size() == 1){
+				//Only this block leads to next, so they are one
+				block->quads.insert(block->quads.end(),
+					next->quads.begin(), next->quads.end());
+				next->quads.clear();
+				block->succs = next->succs;
+				for (BasicBlock * succ : next->succs){
+					std::replace(succ->preds.begin(), succ->preds.end(),
+						next, block);
+				}
+				next->succs.clear();
+				next->preds.clear();
+				again = true;
+			}
+		}
+		again = removeUnreachable() || again;
+		changed = changed || again;
+	}
+	return changed;
+}
+
+void CFG::analyze(){
+	for (size_t i = 0; i < blocks.size(); i++){
+		BasicBlock * block = blocks[i];
+		block->id = i;
+		block->reached = false;
+		block->idom = nullptr;
+		block->domKids.clear();
+		block->frontier.clear();
+		block->loop = nullptr;
+	}
+
+	//Reverse postorder, by a depth-first walk that takes each
+	// block's successors in order
+	std::vector<BasicBlock *> post;
+	std::vector<std::pair<BasicBlock *, size_t>> stack;
+	entry->reached = true;
+	stack.push_back(std::make_pair(entry, 0));
+	while (!stack.empty()){
+		BasicBlock * block = stack.back().first;
+		size_t next = stack.back().second;
+		if (next < block->succs.size()){
+			stack.back().second++;
+			BasicBlock * succ = block->succs[next];
+			if (!succ->reached){
+				succ->reached = true;
+				stack.push_back(std::make_pair(succ, 0));
+			}
+			continue;
+		}
+		post.push_back(block);
+		stack.pop_back();
+	}
+	order.assign(post.rbegin(), post.rend());
+	for (size_t i = 0; i < order.size(); i++){
+		order[i]->rpoIndex = i;
+	}
+
+	//Dominators, as in Cooper, Harvey and Kennedy's "A Simple,
+	// Fast Dominance Algorithm": refine each block's immediate
+	// dominator to the meet of its predecessors' until none change
+	entry->idom = entry;
+	bool changed = true;
+	while (changed){
+		changed = false;
+		for (size_t i = 1; i < order.size(); i++){
+			BasicBlock * block = order[i];
+			BasicBlock * idom = nullptr;
+			for (BasicBlock * pred : block->preds){
+				if (pred->idom == nullptr){ continue; }
+				if (idom == nullptr){
+					idom = pred;
+					continue;
+				}
+				BasicBlock * a = pred;
+				BasicBlock * b = idom;
+				while (a != b){
+					while (a->rpoIndex > b->rpoIndex){ a = a->idom; }
+					while (b->rpoIndex > a->rpoIndex){ b = b->idom; }
+				}
+				idom = a;
+			}
+			if (block->idom != idom){
+				block->idom = idom;
+				changed = true;
+			}
+		}
+	}
+	entry->idom = nullptr;
+	for (size_t i = 1; i < order.size(); i++){
+		order[i]->idom->domKids.push_back(order[i]);
+	}
+
+	//A join point is in the frontier of each block that dominates
+	// one of its predecessors but not the join point itself
+	for (BasicBlock * block : order){
+		if (block->preds.size() < 2){ continue; }
+		for (BasicBlock * pred : block->preds){
+			if (!pred->reached){ continue; }
+			for (BasicBlock * runner = pred; runner != block->idom;
+				runner = runner->idom){
+				if (runner->frontier.empty()
+				  || runner->frontier.back() != block){
+					runner->frontier.push_back(block);
+				}
+			}
+		}
+	}
+
+	//Number the dominator tree so dominates() is two comparisons
+	size_t pre = 0;
+	size_t postNum = 0;
+	stack.clear();
+	stack.push_back(std::make_pair(entry, 0));
+	entry->domPre = pre++;
+	while (!stack.empty()){
+		BasicBlock * block = stack.back().first;
+		size_t next = stack.back().second;
+		if (next < block->domKids.size()){
+			stack.back().second++;
+			BasicBlock * kid = block->domKids[next];
+			kid->domPre = pre++;
+			stack.push_back(std::make_pair(kid, 0));
+			continue;
+		}
+		block->domPost = postNum++;
+		stack.pop_back();
+	}
+
+	findLoops();
+}
+
+bool CFG::dominates(const BasicBlock * a, const BasicBlock * b) const{
+	if (!a->reached || !b->reached){ return false; }
+	return a->domPre <= b->domPre && b->domPost <= a->domPost;
+}
+
+void CFG::findLoops(){
+	for (Loop * loop : loops){ delete loop; }
+	loops.clear();
+
+	//Each back edge goes to a block that dominates its source;
+	// all those to one header make one loop. Headers are met in
+	// reverse postorder, so an enclosing loop comes before any
+	// loop it contains.
+	std::vector<Loop *> byHeader(blocks.size(), nullptr);
+	for (BasicBlock * block : order){
+		for (BasicBlock * succ : block->succs){
+			if (!dominates(succ, block)){ continue; }
+			Loop *& loop = byHeader[succ->id];
+			if (loop == nullptr){
+				loop = new Loop();
+				loop->header = succ;
+				loops.push_back(loop);
+			}
+			loop->latches.push_back(block);
+		}
+	}
+	std::sort(loops.begin(), loops.end(), [](Loop * a, Loop * b){
+		return a->header->rpoIndex < b->header->rpoIndex;
+	});
+
+	std::vector<bool> inLoop(blocks.size(), false);
+	for (Loop * loop : loops){
+		std::fill(inLoop.begin(), inLoop.end(), false);
+		inLoop[loop->header->id] = true;
+		loop->blocks.push_back(loop->header);
+		std::vector<BasicBlock *> work;
+		for (BasicBlock * latch : loop->latches){
+			if (!inLoop[latch->id]){
+				inLoop[latch->id] = true;
+				work.push_back(latch);
+			}
+		}
+		while (!work.empty()){
+			BasicBlock * block = work.back();
+			work.pop_back();
+			loop->blocks.push_back(block);
+			for (BasicBlock * pred : block->preds){
+				if (pred->reached && !inLoop[pred->id]){
+					inLoop[pred->id] = true;
+					work.push_back(pred);
+				}
+			}
+		}
+		std::sort(loop->blocks.begin() + 1, loop->blocks.end(),
+			[](BasicBlock * a, BasicBlock * b){
+				return a->rpoIndex < b->rpoIndex;
+			});
+
+		//Whatever loop the header was in so far encloses this
+		// one, since its header dominates this one's
+		loop->parent = loop->header->loop;
+		if (loop->parent != nullptr){
+			loop->depth = loop->parent->depth + 1;
+		}
+		for (BasicBlock * block : loop->blocks){
+			block->loop = loop;
+		}
+	}
+}
+
+void CFG::writeBack(){
+	//Which blocks must be jumped to, given the layout
+	std::vector<bool> jumpedTo(blocks.size(), false);
+	for (size_t i = 0; i < blocks.size(); i++){
+		blocks[i]->id = i;
+	}
+	for (size_t i = 0; i + 1 < blocks.size(); i++){
+		BasicBlock * block = blocks[i];
+		if (block->getIfz() != nullptr){
+			jumpedTo[block->succs[1]->id] = true;
+		}
+		if (!block->succs.empty() && block->succs[0] != blocks[i + 1]){
+			jumpedTo[block->succs[0]->id] = true;
+		}
+	}
+	auto labelOf = [this](BasicBlock * block){
+		if (block->label == nullptr){ block->label = proc->makeLabel(); }
+		return block->label;
+	};
+
+	//Labels move to wherever the new layout needs them
+	std::list<Quad *> * body = proc->getQuads();
+	for (Quad * quad : *body){ quad->clearLabels(); }
+	body->clear();
+	for (size_t i = 0; i + 1 < blocks.size(); i++){
+		BasicBlock * block = blocks[i];
+		bool wasEmpty = body->empty();
+		auto last = wasEmpty ? body->end() : std::prev(body->end());
+		for (Quad * quad : block->quads){
+			body->push_back(quad);
+		}
+		if (IfzQuad * ifz = block->getIfz()){
+			ifz->setTarget(labelOf(block->succs[1]));
+		}
+		if (!block->succs.empty() && block->succs[0] != blocks[i + 1]){
+			body->push_back(new GotoQuad(labelOf(block->succs[0])));
+		}
+		if (!jumpedTo[i]){ continue; }
+		auto head = wasEmpty ? body->begin() : std::next(last);
+		if (head == body->end()){
+			body->push_back(new NopQuad());
+			head = std::prev(body->end());
+		}
+		(*head)->addLabel(labelOf(block));
+	}
+}
+
+//An operand whose address is taken lives in memory: passes must
+// leave it where it is
+static bool addressTaken(Quad * quad, Opd * opd){
+	if (IndexQuad * index = dynamic_cast<IndexQuad *>(quad)){
+		return index->getSrc() == opd;
+	}
+	if (SetArgQuad * arg = dynamic_cast<SetArgQuad *>(quad)){
+		return arg->getType()->isRecord();
+	}
+	return false;
+}
+
+static bool scalar(Procedure * proc, Opd * opd){
+	if (opd->getWidth() > 8){ return false; }
+	if (dynamic_cast<AuxOpd *>(opd) != nullptr){ return true; }
+	if (!proc->isLocal(opd)){ return false; }
+	const SemSymbol * sym = static_cast<SymOpd *>(opd)->getSym();
+	return !sym->getDataType()->isRecord();
+}
+
+const size_t VarIndex::NONE;
+
+VarIndex::VarIndex(CFG * cfg){
+	Procedure * proc = cfg->getProc();
+	std::set<Opd *> pinned;
+	std::vector<Opd **> slots;
+	for (BasicBlock * block : cfg->getBlocks()){
+		for (Quad * quad : block->quads){
+			slots.clear();
+			quad->useSlots(slots);
+			if (Opd ** def = quad->defSlot()){ slots.push_back(def); }
+			for (Opd ** slot : slots){
+				Opd * opd = *slot;
+				if (addressTaken(quad, opd)){
+					pinned.insert(opd);
+				} else if (ids.count(opd) == 0 && scalar(proc, opd)){
+					add(opd);
+				}
+			}
+		}
+	}
+	if (pinned.empty()){ return; }
+	std::vector<Opd *> kept;
+	for (Opd * opd : opds){
+		if (pinned.count(opd) == 0){ kept.push_back(opd); }
+	}
+	ids.clear();
+	opds.clear();
+	for (Opd * opd : kept){ add(opd); }
+}
+
+size_t VarIndex::add(Opd * opd){
+	size_t id = opds.size();
+	ids[opd] = id;
+	opds.push_back(opd);
+	return id;
+}
+
+}
@@ -0,0 +1,177 @@
+#ifndef CSHANTY_CFG_HPP
+#define CSHANTY_CFG_HPP
+
+#include <cstdint>
+#include <vector>
+#include "3ac.hpp"
+
+namespace cshanty{
+
+class Loop;
+class CFG;
+
+//A run of quads that is only ever entered at its first quad and
+// left after its last. Branches are not kept as quads: where a
+// block goes next is given by its successors, and CFG::writeBack()
+// puts back whatever gotos the final layout needs. The one
+// exception is an IFZ, which stays as the block's last quad since
+// it has a condition; such a block has exactly two successors:
+// first the one it falls into when the condition is true, then the
+// IFZ's target. Any other block has one successor, except the exit.
+class BasicBlock{
+public:
+	//The block's position in CFG::getBlocks() as of the last
+	// CFG::analyze(); analyses use it to index per-block tables
+	size_t getID() const { return id; }
+	IfzQuad * getIfz() const;
+
+	std::vector<Quad *> quads;
+	std::vector<BasicBlock *> succs;
+	std::vector<BasicBlock *> preds;
+	//The label branches to this block use, made when first needed
+	Label * label = nullptr;
+
+	//The rest is filled in by CFG::analyze(). Blocks that cannot
+	// be reached from the entry have no dominator and no order;
+	// nor does the entry itself have a dominator.
+	bool isReached() const { return reached; }
+	BasicBlock * idom = nullptr;
+	std::vector<BasicBlock *> domKids;
+	//The blocks where this one's dominance ends: those it does not
+	// strictly dominate but that have a predecessor it dominates
+	std::vector<BasicBlock *> frontier;
+	//The innermost loop containing this block, if any
+	Loop * loop = nullptr;
+	size_t rpoIndex = 0;
+private:
+	friend class CFG;
+	size_t id = 0;
+	bool reached = false;
+	//Preorder and postorder positions in the dominator tree
+	size_t domPre = 0;
+	size_t domPost = 0;
+};
+
+//A natural loop: its header, which dominates every block in the
+// loop, and every block that can reach one of its latches (the
+// sources of its back edges) without passing through the header
+class Loop{
+public:
+	BasicBlock * header;
+	std::vector<BasicBlock *> latches;
+	//Header first, the rest in reverse postorder
+	std::vector<BasicBlock *> blocks;
+	//The closest enclosing loop, and how many loops enclose this
+	// one (0 for an outermost loop)
+	Loop * parent = nullptr;
+	size_t depth = 0;
+
+	bool contains(const BasicBlock * block) const{
+		for (Loop * l = block->loop; l != nullptr; l = l->parent){
+			if (l == this){ return true; }
+		}
+		return false;
+	}
+};
+
+//Numbers the operands that passes may treat as plain values:
+// a procedure's scalar locals, formals and temps, unless their
+// address is taken somewhere. Globals (which any call may change)
+// and records (only reached through addresses) are not numbered.
+class VarIndex{
+public:
+	static const size_t NONE = SIZE_MAX;
+	VarIndex(CFG * cfg);
+	//The operand's number, or NONE if it is not tracked
+	size_t id(Opd * opd) const{
+		auto found = ids.find(opd);
+		return found == ids.end() ? NONE : found->second;
+	}
+	Opd * opd(size_t id) const{ return opds[id]; }
+	size_t size() const{ return opds.size(); }
+	//Track a temp made by a pass
+	size_t add(Opd * opd);
+private:
+	HashMap<Opd *, size_t> ids;
+	std::vector<Opd *> opds;
+};
+
+//The control-flow graph of one procedure's body. The entry block
+// is always empty with no predecessors and the exit block stands
+// for the procedure's leave quad, so every path through the body
+// runs from the one to the other. A CFG is built from the body,
+// edited in place by the optimization passes, and then written
+// back over the body. Building one leaves the body as it was, so
+// a CFG may also be built just to analyze the code.
+class CFG{
+public:
+	static CFG * build(Procedure * proc);
+	~CFG();
+	CFG(const CFG&) = delete;
+	CFG& operator=(const CFG&) = delete;
+
+	Procedure * getProc(){ return proc; }
+	BasicBlock * getEntry(){ return entry; }
+	BasicBlock * getExit(){ return exit; }
+	//Every block, in layout order: entry first and exit last
+	const std::vector<BasicBlock *>& getBlocks(){ return blocks; }
+
+	//A new empty block, laid out just before the given one
+	BasicBlock * addBlock(BasicBlock * before);
+	void addEdge(BasicBlock * from, BasicBlock * to);
+	//Put a new empty block on the edge from from to to, laid out
+	// just before to. It takes from's place among to's
+	// predecessors, so phis in to need no change.
+	BasicBlock * splitEdge(BasicBlock * from, BasicBlock * to);
+	//Make from go to newTo wherever it went to oldTo. If from
+	// then has both successors the same, its IFZ is dropped.
+	void redirect(BasicBlock * from, BasicBlock * oldTo, BasicBlock * newTo);
+	//Make from, which ends in an IFZ, go only to its other
+	// successor, dropping the IFZ. Phis in to lose from's operand.
+	void removeEdge(BasicBlock * from, BasicBlock * to);
+	//The block control passes through, and only through, on its
+	// way into the loop from outside: the header's one predecessor
+	// outside the loop, with no other successor. If there is none
+	// one is made, taking over every edge into the header from
+	// outside; in SSA form each header phi then gets a phi in the
+	// new block to merge the operands for those edges. The CFG
+	// must be analyzed again before its loops are used.
+	BasicBlock * addPreheader(Loop * loop);
+	//Drop every block the entry cannot reach (bar the exit), and
+	// the phi operands for them in the blocks they led to
+	bool removeUnreachable();
+	//Skip empty blocks and merge straight-line chains of blocks.
+	// Returns whether anything changed.
+	bool simplify();
+
+	//Number the blocks and compute the reverse postorder, the
+	// dominator tree, dominance frontiers and the loops. Needed
+	// again after any pass that changes the edges.
+	void analyze();
+	//Blocks reachable from the entry, in reverse postorder
+	const std::vector<BasicBlock *>& rpo(){ return order; }
+	//Whether every path from the entry to b goes through a
+	// (so a dominates itself)
+	bool dominates(const BasicBlock * a, const BasicBlock * b) const;
+	//Every loop, outermost ones before those they contain
+	const std::vector<Loop *>& getLoops(){ return loops; }
+
+	//Lay the blocks out as the procedure's body, with labels and
+	// gotos wherever a block is not simply fallen into
+	void writeBack();
+private:
+	CFG(Procedure * procIn) : proc(procIn){ }
+	BasicBlock * makeBlock();
+	void findLoops();
+
+	Procedure * proc;
+	BasicBlock * entry = nullptr;
+	BasicBlock * exit = nullptr;
+	std::vector<BasicBlock *> blocks;
+	std::vector<BasicBlock *> order;
+	std::vector<Loop *> loops;
+};
+
+}
+
+#endif
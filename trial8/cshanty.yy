@@ -9,9 +9,10 @@
 %token-table
 
 %code requires{
-	#include <list>
+	#include <vector>
 	#include "tokens.hpp"
 	#include "ast.hpp"
+	#include "arena.hpp"
 	namespace cshanty {
 		class Scanner;
 	}
@@ -31,6 +32,7 @@
 
 %parse-param { cshanty::Scanner &scanner }
 %parse-param { cshanty::ProgramNode** root }
+%parse-param { cshanty::Arena * arena }
 %code{
    // C std code for utility functions
    #include <iostream>
@@ -45,7 +47,13 @@
   //Request tokens from our scanner member, not 
   // from a global function
   #undef yylex
-  #define yylex scanner.yylex
+  #define yylex scanner.nextToken
+
+  //Copy a token's position into the arena, so that the AST
+  // never points at scanner-owned memory
+  static cshanty::Position * at(cshanty::Arena * arena, cshanty::Token * tok){
+    return arena->make<cshanty::Position>(*tok->pos());
+  }
 }
 
 %union {
@@ -57,23 +65,23 @@
    cshanty::StrToken*                      transStrToken;
    cshanty::ProgramNode*                   transProgram;
    cshanty::DeclNode *                     transDecl;
-   std::list<cshanty::DeclNode *> *        transDeclList;
+   std::vector<cshanty::DeclNode *> *        transDeclList;
    cshanty::RecordTypeDeclNode *           transRecordDecl;
    cshanty::VarDeclNode *                  transVarDecl;
-   std::list<cshanty::VarDeclNode *> *     transVarDeclList;
+   std::vector<cshanty::VarDeclNode *> *     transVarDeclList;
    cshanty::FormalDeclNode *               transFormal;
-   std::list<cshanty::FormalDeclNode *> *  transFormalList;
+   std::vector<cshanty::FormalDeclNode *> *  transFormalList;
    cshanty::TypeNode *                     transType;
    cshanty::LValNode *                     transLVal;
    cshanty::IDNode *                       transID;
    cshanty::FnDeclNode *                   transFn;
-   std::list<cshanty::VarDeclNode *> *     transVarDecls;
-   std::list<cshanty::StmtNode *> *        transStmts;
+   std::vector<cshanty::VarDeclNode *> *     transVarDecls;
+   std::vector<cshanty::StmtNode *> *        transStmts;
    cshanty::StmtNode *                     transStmt;
    cshanty::ExpNode *                      transExp;
    cshanty::AssignExpNode *                transAssignExp;
    cshanty::CallExpNode *                  transCallExp;
-   std::list<cshanty::ExpNode *> *         transActuals;
+   std::vector<cshanty::ExpNode *> *         transActuals;
 }
 
 %define parse.assert
@@ -156,7 +164,8 @@
 
 program 	: globals
 		  {
-		  $$ = new ProgramNode($1);
+		  Position * p = arena->make<Position>(0,0,0,0);
+		  $$ = arena->makeNode<ProgramNode>(p, arena->seal($1));
 		  *root = $$;
 		  }
 
@@ -168,7 +177,7 @@ globals 	: globals decl
 	  	  }
 		| /* epsilon */
 		  {
-		  $$ = new std::list<DeclNode * >();
+		  $$ = new std::vector<DeclNode * >();
 		  }
 
 decl 		: varDecl
@@ -180,19 +189,19 @@ decl 		: varDecl
 
 recordDecl	: RECORD id OPEN varDeclList CLOSE
 		  {
-		  Position * p = new Position($1->pos(), $5->pos());
-		  $$ = new RecordTypeDeclNode(p, $2, $4);
+		  Position * p = arena->make<Position>($1->pos(), $5->pos());
+		  $$ = arena->makeNode<RecordTypeDeclNode>(p, $2, arena->seal($4));
 		  }
 
 varDecl 	: type id SEMICOL
 		  {
-		  Position * p = new Position($1->pos(), $2->pos());
-		  $$ = new VarDeclNode(p, $1, $2);
+		  Position * p = arena->make<Position>($1->pos(), $2->pos());
+		  $$ = arena->makeNode<VarDeclNode>(p, $1, $2);
 		  }
 
 varDeclList     : varDecl
 		  {
-		  $$ = new std::list<VarDeclNode *>();
+		  $$ = new std::vector<VarDeclNode *>();
 		  $$->push_back($1);
 		  }
 		| varDeclList varDecl
@@ -203,40 +212,41 @@ varDeclList     : varDecl
 
 type 		: INT
 	  	  { 
-		  $$ = new IntTypeNode($1->pos());
+		  $$ = arena->makeNode<IntTypeNode>(at(arena, $1));
 		  }
 		| BOOL
 		  {
-		  $$ = new BoolTypeNode($1->pos());
+		  $$ = arena->makeNode<BoolTypeNode>(at(arena, $1));
 		  }
 		| id
 		  {
-		  $$ = new RecordTypeNode($1->pos(), $1);
+		  $$ = arena->makeNode<RecordTypeNode>($1->pos(), $1);
 		  }
 		| STRING
 		  {
-		  $$ = new StringTypeNode($1->pos());
+		  $$ = arena->makeNode<StringTypeNode>(at(arena, $1));
 		  }
 		| VOID
 		  {
-		  $$ = new VoidTypeNode($1->pos());
+		  $$ = arena->makeNode<VoidTypeNode>(at(arena, $1));
 		  }
 
 fnDecl 		: type id LPAREN RPAREN OPEN stmtList CLOSE
 		  {
-		  Position * pos = new Position($1->pos(), $7->pos());
-		  std::list<FormalDeclNode *> * f = new std::list<FormalDeclNode *>();
-		  $$ = new FnDeclNode(pos, $1, $2, f, $6);
+		  Position * pos = arena->make<Position>($1->pos(), $7->pos());
+		  Span<FormalDeclNode *> f;
+		  $$ = arena->makeNode<FnDeclNode>(pos, $1, $2, f, arena->seal($6));
 		  }
 		| type id LPAREN formals RPAREN OPEN stmtList CLOSE
 		  {
-		  Position * pos = new Position($1->pos(), $8->pos());
-		  $$ = new FnDeclNode(pos, $1, $2, $4, $7);
+		  Position * pos = arena->make<Position>($1->pos(), $8->pos());
+		  $$ = arena->makeNode<FnDeclNode>(pos, $1, $2,
+		    arena->seal($4), arena->seal($7));
 		  }
 
 formals 	: formalDecl
 		  {
-		  $$ = new std::list<FormalDeclNode *>();
+		  $$ = new std::vector<FormalDeclNode *>();
 		  $$->push_back($1);
 		  }
 		| formals COMMA formalDecl
@@ -248,7 +258,7 @@ formals 	: formalDecl
  /*
   declList	: varDecl
 		  {
-		  $$ = new std::list<DeclNode *>();
+		  $$ = new std::vector<DeclNode *>();
 		  $$->push_back($1);
 		  }
 		| varDecl COMMA declList 
@@ -260,13 +270,13 @@ formals 	: formalDecl
 
 formalDecl 	: type id
 		  {
-		  Position * pos = new Position($1->pos(), $2->pos());
-		  $$ = new FormalDeclNode(pos, $1, $2);
+		  Position * pos = arena->make<Position>($1->pos(), $2->pos());
+		  $$ = arena->makeNode<FormalDeclNode>(pos, $1, $2);
 		  }
 
 stmtList 	: /* epsilon */
 	   	  {
-		  $$ = new std::list<StmtNode *>();
+		  $$ = new std::vector<StmtNode *>();
 		  //$$->push_back($1);
 	   	  }
 		| stmtList stmt
@@ -278,162 +288,162 @@ stmtList 	: /* epsilon */
 stmt		: varDecl
 		  {
 		  Position * p = $1->pos();
-		  $$ = new VarDeclNode(p, $1->getTypeNode(), $1->ID());
+		  $$ = arena->makeNode<VarDeclNode>(p, $1->getTypeNode(), $1->ID());
 		  }
 		| assignExp SEMICOL
 		  {
-		  Position * p = new Position($1->pos(), $2->pos());
-		  $$ = new AssignStmtNode(p, $1); 
+		  Position * p = arena->make<Position>($1->pos(), $2->pos());
+		  $$ = arena->makeNode<AssignStmtNode>(p, $1); 
 		  }
 		| lval DEC SEMICOL
 		  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new PostDecStmtNode(p, $1);
+		  Position * p = arena->make<Position>($1->pos(), $3->pos());
+		  $$ = arena->makeNode<PostDecStmtNode>(p, $1);
 		  }
 		| lval INC SEMICOL
 		  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new PostIncStmtNode(p, $1);
+		  Position * p = arena->make<Position>($1->pos(), $3->pos());
+		  $$ = arena->makeNode<PostIncStmtNode>(p, $1);
 		  }
 		| RECEIVE lval SEMICOL
 		  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new ReceiveStmtNode(p, $2);
+		  Position * p = arena->make<Position>($1->pos(), $3->pos());
+		  $$ = arena->makeNode<ReceiveStmtNode>(p, $2);
 		  }
 		| REPORT exp SEMICOL
 		  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new ReportStmtNode(p, $2);
+		  Position * p = arena->make<Position>($1->pos(), $3->pos());
+		  $$ = arena->makeNode<ReportStmtNode>(p, $2);
 		  }
 		| IF LPAREN exp RPAREN OPEN stmtList CLOSE
 		  {
-		  Position * p = new Position($1->pos(), $7->pos());
-		  $$ = new IfStmtNode(p, $3, $6);
+		  Position * p = arena->make<Position>($1->pos(), $7->pos());
+		  $$ = arena->makeNode<IfStmtNode>(p, $3, arena->seal($6));
 		  }
 		| IF LPAREN exp RPAREN OPEN stmtList CLOSE ELSE OPEN stmtList CLOSE
 		  {
-		  Position * p = new Position($1->pos(), $11->pos());
-		  $$ = new IfElseStmtNode(p, $3, $6, $10);
+		  Position * p = arena->make<Position>($1->pos(), $11->pos());
+		  $$ = arena->makeNode<IfElseStmtNode>(p, $3,
+		    arena->seal($6), arena->seal($10));
 		  }
 		| WHILE LPAREN exp RPAREN OPEN stmtList CLOSE
 		  {
-		  Position * p = new Position($1->pos(), $7->pos());
-		  $$ = new WhileStmtNode(p, $3, $6);
+		  Position * p = arena->make<Position>($1->pos(), $7->pos());
+		  $$ = arena->makeNode<WhileStmtNode>(p, $3, arena->seal($6));
 		  }
 		| RETURN exp SEMICOL
 		  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new ReturnStmtNode(p, $2);
+		  Position * p = arena->make<Position>($1->pos(), $3->pos());
+		  $$ = arena->makeNode<ReturnStmtNode>(p, $2);
 		  }
 		| RETURN SEMICOL
 		  {
-		  Position * p = new Position($1->pos(), $2->pos());
-		  $$ = new ReturnStmtNode(p, nullptr);
+		  Position * p = arena->make<Position>($1->pos(), $2->pos());
+		  $$ = arena->makeNode<ReturnStmtNode>(p, nullptr);
 		  }
 		| callExp SEMICOL
 		  { 
-		  Position * p = new Position($1->pos(), $2->pos());
-		  $$ = new CallStmtNode(p, $1); 
+		  Position * p = arena->make<Position>($1->pos(), $2->pos());
+		  $$ = arena->makeNode<CallStmtNode>(p, $1); 
 		  }
 
 exp		: assignExp 
 		  { $$ = $1; } 
 		| exp MINUS exp
 	  	  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new MinusNode(p, $1, $3);
+		  Position * p = arena->make<Position>($1->pos(), $3->pos());
+		  $$ = arena->makeNode<MinusNode>(p, $1, $3);
 		  }
 		| exp PLUS exp
 	  	  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new PlusNode(p, $1, $3);
+		  Position * p = arena->make<Position>($1->pos(), $3->pos());
+		  $$ = arena->makeNode<PlusNode>(p, $1, $3);
 		  }
 		| exp TIMES exp
 	  	  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new TimesNode(p, $1, $3);
+		  Position * p = arena->make<Position>($1->pos(), $3->pos());
+		  $$ = arena->makeNode<TimesNode>(p, $1, $3);
 		  }
 		| exp DIVIDE exp
 	  	  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new DivideNode(p, $1, $3);
+		  Position * p = arena->make<Position>($1->pos(), $3->pos());
+		  $$ = arena->makeNode<DivideNode>(p, $1, $3);
 		  }
 		| exp AND exp
 	  	  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new AndNode(p, $1, $3);
+		  Position * p = arena->make<Position>($1->pos(), $3->pos());
+		  $$ = arena->makeNode<AndNode>(p, $1, $3);
 		  }
 		| exp OR exp
 	  	  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new OrNode(p, $1, $3);
+		  Position * p = arena->make<Position>($1->pos(), $3->pos());
+		  $$ = arena->makeNode<OrNode>(p, $1, $3);
 		  }
 		| exp EQUALS exp
 	  	  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new EqualsNode(p, $1, $3);
+		  Position * p = arena->make<Position>($1->pos(), $3->pos());
+		  $$ = arena->makeNode<EqualsNode>(p, $1, $3);
 		  }
 		| exp NOTEQUALS exp
 	  	  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new NotEqualsNode(p, $1, $3);
+		  Position * p = arena->make<Position>($1->pos(), $3->pos());
+		  $$ = arena->makeNode<NotEqualsNode>(p, $1, $3);
 		  }
 		| exp GREATER exp
 	  	  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new GreaterNode(p, $1, $3);
+		  Position * p = arena->make<Position>($1->pos(), $3->pos());
+		  $$ = arena->makeNode<GreaterNode>(p, $1, $3);
 		  }
 		| exp GREATEREQ exp
 	  	  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new GreaterEqNode(p, $1, $3);
+		  Position * p = arena->make<Position>($1->pos(), $3->pos());
+		  $$ = arena->makeNode<GreaterEqNode>(p, $1, $3);
 		  }
 		| exp LESS exp
 	  	  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new LessNode(p, $1, $3);
+		  Position * p = arena->make<Position>($1->pos(), $3->pos());
+		  $$ = arena->makeNode<LessNode>(p, $1, $3);
 		  }
 		| exp LESSEQ exp
 	  	  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new LessEqNode(p, $1, $3);
+		  Position * p = arena->make<Position>($1->pos(), $3->pos());
+		  $$ = arena->makeNode<LessEqNode>(p, $1, $3);
 		  }
 		| NOT exp
 	  	  {
-		  Position * p = new Position($1->pos(), $2->pos());
-		  $$ = new NotNode(p, $2);
+		  Position * p = arena->make<Position>($1->pos(), $2->pos());
+		  $$ = arena->makeNode<NotNode>(p, $2);
 		  }
 		| MINUS term
 	  	  {
-		  Position * p = new Position($1->pos(), $2->pos());
-		  $$ = new NegNode(p, $2);
+		  Position * p = arena->make<Position>($1->pos(), $2->pos());
+		  $$ = arena->makeNode<NegNode>(p, $2);
 		  }
 		| term 
 	  	  { $$ = $1; }
 
 assignExp	: lval ASSIGN exp
 		  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new AssignExpNode(p, $1, $3);
+		  Position * p = arena->make<Position>($1->pos(), $3->pos());
+		  $$ = arena->makeNode<AssignExpNode>(p, $1, $3);
 		  }
 
 callExp		: id LPAREN RPAREN
 		  {
-		  Position * p = new Position($1->pos(), $3->pos());
-		  std::list<ExpNode *> * noargs =
-		    new std::list<ExpNode *>();
-		  $$ = new CallExpNode(p, $1, noargs);
+		  Position * p = arena->make<Position>($1->pos(), $3->pos());
+		  Span<ExpNode *> noargs;
+		  $$ = arena->makeNode<CallExpNode>(p, $1, noargs);
 		  }
 		| id LPAREN actualsList RPAREN
 		  {
-		  Position * p = new Position($1->pos(), $4->pos());
-		  $$ = new CallExpNode(p, $1, $3);
+		  Position * p = arena->make<Position>($1->pos(), $4->pos());
+		  $$ = arena->makeNode<CallExpNode>(p, $1, arena->seal($3));
 		  }
 
 actualsList	: exp
 		  {
-		  std::list<ExpNode *> * list =
-		    new std::list<ExpNode *>();
+		  std::vector<ExpNode *> * list =
+		    new std::vector<ExpNode *>();
 		  list->push_back($1);
 		  $$ = list;
 		  }
@@ -446,13 +456,13 @@ actualsList	: exp
 term 		: lval
 		  { $$ = $1; }
 		| INTLITERAL 
-		  { $$ = new IntLitNode($1->pos(), $1->num()); }
+		  { $$ = arena->makeNode<IntLitNode>(at(arena, $1), $1->num()); }
 		| STRLITERAL 
-		  { $$ = new StrLitNode($1->pos(), $1->str()); }
+		  { $$ = arena->makeNode<StrLitNode>(at(arena, $1), arena->str($1->str())); }
 		| TRUE
-		  { $$ = new TrueNode($1->pos()); }
+		  { $$ = arena->makeNode<TrueNode>(at(arena, $1)); }
 		| FALSE
-		  { $$ = new FalseNode($1->pos()); }
+		  { $$ = arena->makeNode<FalseNode>(at(arena, $1)); }
 		| LPAREN exp RPAREN
 		  { $$ = $2; }
 		| callExp
@@ -466,19 +476,19 @@ lval		: id
 		  }
 		| id LBRACE id RBRACE
 		  {
-		  Position * pos = new Position($1->pos(), $4->pos());
-		  $$ = new IndexNode(pos, $1, $3);
+		  Position * pos = arena->make<Position>($1->pos(), $4->pos());
+		  $$ = arena->makeNode<IndexNode>(pos, $1, $3);
 		  }
 
 id		: ID
 		  {
-		  Position * pos = $1->pos();
-		  $$ = new IDNode(pos, $1->value()); 
+		  Position * pos = at(arena, $1);
+		  $$ = arena->makeNode<IDNode>(pos, arena->str($1->value()));
 		  }
 	
 %%
 
 void cshanty::Parser::error(const std::string& msg){
-	std::cout << msg << std::endl;
-	std::cerr << "syntax error" << std::endl;
+	Console::out() << msg << std::endl;
+	Report::fatal("syntax error");
 }
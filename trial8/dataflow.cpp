@@ -0,0 +1,274 @@
+#include <functional>
+#include <queue>
+#include "dataflow.hpp"
+
+namespace cshanty{
+
+void BitSet::setAll(){
+	for (uint64_t& word : words){ word = ~uint64_t(0); }
+	if (bits % 64 != 0){
+		words.back() = (uint64_t(1) << (bits % 64)) - 1;
+	}
+}
+
+void BitSet::clear(){
+	for (uint64_t& word : words){ word = 0; }
+}
+
+size_t BitSet::count() const{
+	size_t res = 0;
+	for (uint64_t word : words){
+		res += static_cast<size_t>(__builtin_popcountll(word));
+	}
+	return res;
+}
+
+bool BitSet::unionWith(const BitSet& other){
+	uint64_t changed = 0;
+	for (size_t i = 0; i < words.size(); i++){
+		uint64_t word = words[i] | other.words[i];
+		changed |= word ^ words[i];
+		words[i] = word;
+	}
+	return changed != 0;
+}
+
+bool BitSet::intersectWith(const BitSet& other){
+	uint64_t changed = 0;
+	for (size_t i = 0; i < words.size(); i++){
+		uint64_t word = words[i] & other.words[i];
+		changed |= word ^ words[i];
+		words[i] = word;
+	}
+	return changed != 0;
+}
+
+bool BitSet::subtract(const BitSet& other){
+	uint64_t changed = 0;
+	for (size_t i = 0; i < words.size(); i++){
+		uint64_t word = words[i] & ~other.words[i];
+		changed |= word ^ words[i];
+		words[i] = word;
+	}
+	return changed != 0;
+}
+
+bool BitSet::transfer(const BitSet& in, const BitSet& gen,
+	const BitSet& kill){
+	uint64_t changed = 0;
+	for (size_t i = 0; i < words.size(); i++){
+		uint64_t word = gen.words[i] | (in.words[i] & ~kill.words[i]);
+		changed |= word ^ words[i];
+		words[i] = word;
+	}
+	return changed != 0;
+}
+
+Dataflow::Dataflow(CFG * cfgIn, size_t width, Direction dirIn,
+	Meet meetIn)
+: cfg(cfgIn), dir(dirIn), meet(meetIn){
+	size_t numBlocks = cfg->getBlocks().size();
+	gen.assign(numBlocks, BitSet(width));
+	kill.assign(numBlocks, BitSet(width));
+	boundary = BitSet(width);
+}
+
+void Dataflow::solve(){
+	const std::vector<BasicBlock *>& order = cfg->rpo();
+	size_t numBlocks = cfg->getBlocks().size();
+	size_t width = boundary.size();
+	bool forward = dir == FORWARD;
+
+	//Under INTERSECTION every value starts full, so that the first
+	// pass over a loop does not lose what its back edge brings
+	BitSet top(width);
+	if (meet == INTERSECTION){ top.setAll(); }
+	ins.assign(numBlocks, BitSet(width));
+	outs.assign(numBlocks, BitSet(width));
+	for (BasicBlock * block : order){
+		ins[block->getID()] = top;
+		outs[block->getID()] = top;
+	}
+
+	//The worklist holds positions in the visiting order, so that
+	// the block visited next is always the earliest one pending
+	std::vector<size_t> position(numBlocks, 0);
+	std::vector<bool> queued(numBlocks, false);
+	std::priority_queue<size_t, std::vector<size_t>, std::greater<size_t>> work;
+	for (size_t i = 0; i < order.size(); i++){
+		BasicBlock * block = forward ? order[i] : order[order.size() - 1 - i];
+		position[block->getID()] = i;
+		queued[block->getID()] = true;
+		work.push(i);
+	}
+
+	visits = 0;
+	BitSet joined(width);
+	while (!work.empty()){
+		size_t pos = work.top();
+		work.pop();
+		BasicBlock * block = forward ? order[pos] : order[order.size() - 1 - pos];
+		size_t id = block->getID();
+		queued[id] = false;
+		visits++;
+
+		const std::vector<BasicBlock *>& sources =
+			forward ? block->preds : block->succs;
+		if (sources.empty()){
+			joined = boundary;
+		} else {
+			joined = top;
+			for (BasicBlock * source : sources){
+				//Unreachable blocks have no say
+				if (!source->isReached()){ continue; }
+				const BitSet& flow = forward ? outs[source->getID()]
+					: ins[source->getID()];
+				if (meet == UNION){ joined.unionWith(flow); }
+				else { joined.intersectWith(flow); }
+			}
+		}
+		std::vector<BitSet>& before = forward ? ins : outs;
+		std::vector<BitSet>& after = forward ? outs : ins;
+		before[id] = joined;
+		if (!after[id].transfer(joined, gen[id], kill[id])){ continue; }
+		const std::vector<BasicBlock *>& sinks =
+			forward ? block->succs : block->preds;
+		for (BasicBlock * sink : sinks){
+			size_t sinkID = sink->getID();
+			if (queued[sinkID] || !sink->isReached()){ continue; }
+			queued[sinkID] = true;
+			work.push(position[sinkID]);
+		}
+	}
+}
+
+Liveness::Liveness(CFG * cfg, const VarIndex& varsIn)
+: Dataflow(cfg, varsIn.size(), BACKWARD, UNION), vars(varsIn){
+	std::vector<Opd **> slots;
+	for (BasicBlock * block : cfg->rpo()){
+		BitSet& blockGen = gen[block->getID()];
+		BitSet& blockKill = kill[block->getID()];
+		for (auto itr = block->quads.rbegin(); itr != block->quads.rend(); itr++){
+			Quad * quad = *itr;
+			Opd ** def = quad->defSlot();
+			size_t var = def == nullptr ? VarIndex::NONE : vars.id(*def);
+			if (var != VarIndex::NONE){
+				blockKill.set(var);
+				blockGen.reset(var);
+			}
+			slots.clear();
+			quad->useSlots(slots);
+			for (Opd ** slot : slots){
+				size_t used = vars.id(*slot);
+				if (used != VarIndex::NONE){ blockGen.set(used); }
+			}
+		}
+	}
+	solve();
+}
+
+void Liveness::step(Quad * quad, BitSet& live) const{
+	Opd ** def = quad->defSlot();
+	size_t var = def == nullptr ? VarIndex::NONE : vars.id(*def);
+	if (var != VarIndex::NONE){ live.reset(var); }
+	std::vector<Opd **> slots;
+	quad->useSlots(slots);
+	for (Opd ** slot : slots){
+		size_t used = vars.id(*slot);
+		if (used != VarIndex::NONE){ live.set(used); }
+	}
+}
+
+ReachingDefs::ReachingDefs(CFG * cfg, const VarIndex& varsIn)
+: Dataflow(cfg, 0, FORWARD, UNION), vars(varsIn){
+	for (BasicBlock * block : cfg->getBlocks()){
+		for (Quad * quad : block->quads){
+			Opd ** def = quad->defSlot();
+			size_t var = def == nullptr ? VarIndex::NONE : vars.id(*def);
+			if (var == VarIndex::NONE){ continue; }
+			defIDs[quad] = defs.size();
+			defs.push_back(quad);
+			defBlocks.push_back(block);
+			defVars.push_back(var);
+		}
+	}
+	size_t width = defs.size();
+	varDefs.assign(vars.size(), BitSet(width));
+	for (size_t d = 0; d < width; d++){ varDefs[defVars[d]].set(d); }
+
+	//A block generates the last definition of each operand it
+	// writes, and kills every other definition of those operands
+	boundary = BitSet(width);
+	gen.assign(gen.size(), BitSet(width));
+	kill.assign(kill.size(), BitSet(width));
+	for (size_t d = 0; d < width; d++){
+		size_t id = defBlocks[d]->getID();
+		BitSet& blockGen = gen[id];
+		blockGen.subtract(varDefs[defVars[d]]);
+		blockGen.set(d);
+		kill[id].unionWith(varDefs[defVars[d]]);
+	}
+	solve();
+}
+
+void ReachingDefs::step(Quad * quad, BitSet& reaching) const{
+	auto found = defIDs.find(quad);
+	if (found == defIDs.end()){ return; }
+	reaching.subtract(varDefs[defVars[found->second]]);
+	reaching.set(found->second);
+}
+
+//The operands in a set, as 3AC prints them
+static std::string opdList(const BitSet& set, const VarIndex& vars){
+	std::string res;
+	set.forEach([&](size_t var){
+		res += " " + vars.opd(var)->valString();
+	});
+	return res.empty() ? " (none)" : res;
+}
+
+HashMap<Quad *, std::vector<std::string>> Dataflow::annotate(
+	Procedure * proc){
+	HashMap<Quad *, std::vector<std::string>> notes;
+	CFG * cfg = CFG::build(proc);
+	cfg->analyze();
+	VarIndex vars(cfg);
+	Liveness live(cfg, vars);
+	ReachingDefs reaching(cfg, vars);
+
+	for (BasicBlock * block : cfg->getBlocks()){
+		if (block->quads.empty()){ continue; }
+		std::vector<std::string>& lines = notes[block->quads.front()];
+		std::string head = "#B" + std::to_string(block->getID()) + " from";
+		for (BasicBlock * pred : block->preds){
+			head += " B" + std::to_string(pred->getID());
+		}
+		if (!block->isReached()){ head += " (unreachable)"; }
+		lines.push_back(head);
+		lines.push_back("#  live in:" + opdList(live.in(block), vars));
+		lines.push_back("#  live out:" + opdList(live.out(block), vars));
+
+		//Only the definitions of operands the block may read are
+		// of interest. A definition reaches a block only from the
+		// end of the block that made it, so naming that block is
+		// enough.
+		const BitSet& liveIn = live.in(block);
+		std::vector<std::string> sites(vars.size());
+		reaching.in(block).forEach([&](size_t def){
+			if (!liveIn.test(reaching.getVar(def))){ return; }
+			std::string& site = sites[reaching.getVar(def)];
+			site += site.empty() ? "@B" : ",B";
+			site += std::to_string(reaching.getDefBlock(def)->getID());
+		});
+		std::string defs;
+		for (size_t var = 0; var < vars.size(); var++){
+			if (sites[var].empty()){ continue; }
+			defs += " " + vars.opd(var)->valString() + sites[var];
+		}
+		lines.push_back("#  reaching:" + (defs.empty() ? " (none)" : defs));
+	}
+	delete cfg;
+	return notes;
+}
+
+}
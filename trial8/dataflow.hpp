@@ -0,0 +1,130 @@
+#ifndef CSHANTY_DATAFLOW_HPP
+#define CSHANTY_DATAFLOW_HPP
+
+#include <cstdint>
+#include <vector>
+#include "cfg.hpp"
+
+namespace cshanty{
+
+//A fixed-size set of small integers (VarIndex ids, definition
+// numbers), one bit each
+class BitSet{
+public:
+	BitSet(size_t sizeIn = 0) : words((sizeIn + 63) / 64, 0), bits(sizeIn){ }
+	size_t size() const{ return bits; }
+	void set(size_t i){ words[i / 64] |= uint64_t(1) << (i % 64); }
+	void reset(size_t i){ words[i / 64] &= ~(uint64_t(1) << (i % 64)); }
+	bool test(size_t i) const{ return (words[i / 64] >> (i % 64)) & 1; }
+	void setAll();
+	void clear();
+	size_t count() const;
+	//Each returns whether this set changed
+	bool unionWith(const BitSet& other);
+	bool intersectWith(const BitSet& other);
+	bool subtract(const BitSet& other);
+	//this = gen | (in & ~kill): the transfer function of every
+	// problem the solver handles. Returns whether this changed.
+	bool transfer(const BitSet& in, const BitSet& gen, const BitSet& kill);
+	bool operator==(const BitSet& other) const{ return words == other.words; }
+
+	//Call visit on each member, in increasing order
+	template <typename F> void forEach(F visit) const{
+		for (size_t i = 0; i < words.size(); i++){
+			uint64_t word = words[i];
+			while (word != 0){
+				size_t bit = static_cast<size_t>(__builtin_ctzll(word));
+				visit(i * 64 + bit);
+				word &= word - 1;
+			}
+		}
+	}
+private:
+	std::vector<uint64_t> words;
+	size_t bits;
+};
+
+//An iterative solver for gen/kill dataflow problems over a CFG.
+// A problem sets each block's gen and kill sets (indexed by
+// BasicBlock::getID()) and the value at the boundary (the entry
+// for a forward problem, the exit for a backward one), then calls
+// solve(). The CFG must be analyzed; blocks the entry cannot
+// reach are left with empty sets.
+class Dataflow{
+public:
+	enum Direction { FORWARD, BACKWARD };
+	//How the values flowing into a block from several others
+	// combine: UNION for "on some path", INTERSECTION for "on
+	// every path"
+	enum Meet { UNION, INTERSECTION };
+
+	//The value on entry to and exit from the block. For a
+	// backward problem in() is still the value at the top.
+	const BitSet& in(const BasicBlock * block) const{
+		return ins[block->getID()];
+	}
+	const BitSet& out(const BasicBlock * block) const{
+		return outs[block->getID()];
+	}
+	//How many blocks the last solve() visited
+	size_t getVisits() const{ return visits; }
+
+	//The facts verbose -a output shows for a procedure: liveness
+	// and reaching definitions for each block that has any quads,
+	// as lines to print above the block's first quad
+	static HashMap<Quad *, std::vector<std::string>> annotate(Procedure * proc);
+protected:
+	Dataflow(CFG * cfgIn, size_t width, Direction dirIn, Meet meetIn);
+	//Run a worklist, in reverse postorder for a forward problem
+	// (postorder for a backward one), until nothing changes
+	void solve();
+
+	CFG * cfg;
+	std::vector<BitSet> gen;
+	std::vector<BitSet> kill;
+	BitSet boundary;
+private:
+	Direction dir;
+	Meet meet;
+	std::vector<BitSet> ins;
+	std::vector<BitSet> outs;
+	size_t visits = 0;
+};
+
+//Which VarIndex operands are live (may yet be read before being
+// written) at the top and bottom of each block
+class Liveness : public Dataflow{
+public:
+	Liveness(CFG * cfg, const VarIndex& varsIn);
+	//Step a set of live operands backward over one quad
+	void step(Quad * quad, BitSet& live) const;
+private:
+	const VarIndex& vars;
+};
+
+//Which definitions of VarIndex operands may reach the top and
+// bottom of each block. Definitions are numbered in layout order.
+class ReachingDefs : public Dataflow{
+public:
+	ReachingDefs(CFG * cfg, const VarIndex& varsIn);
+	size_t numDefs() const{ return defs.size(); }
+	Quad * getDef(size_t def) const{ return defs[def]; }
+	BasicBlock * getDefBlock(size_t def) const{ return defBlocks[def]; }
+	//The operand the definition writes
+	size_t getVar(size_t def) const{ return defVars[def]; }
+	//Every definition of the operand
+	const BitSet& defsOf(size_t var) const{ return varDefs[var]; }
+	//Step a set of reaching definitions forward over one quad
+	void step(Quad * quad, BitSet& reaching) const;
+private:
+	const VarIndex& vars;
+	std::vector<Quad *> defs;
+	std::vector<BasicBlock *> defBlocks;
+	std::vector<size_t> defVars;
+	HashMap<Quad *, size_t> defIDs;
+	std::vector<BitSet> varDefs;
+};
+
+}
+
+#endif
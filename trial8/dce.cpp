@@ -0,0 +1,70 @@
+#include <set>
+#include "opt.hpp"
+#include "cfg.hpp"
+
+namespace cshanty{
+
+bool cannotTrap(Quad * quad){
+	BinOpQuad * bin = dynamic_cast<BinOpQuad *>(quad);
+	if (bin == nullptr || bin->getOp() != DIV64){ return true; }
+	int64_t divisor;
+	if (!literalValue(bin->getSrc2(), divisor)){ return false; }
+	return divisor != 0 && divisor != -1;
+}
+
+//Whether the quad does nothing but compute its destination: a
+// tracked operand, or the address in an AddrOpd
+static bool pure(Quad * quad, const VarIndex& vars){
+	if (dynamic_cast<PhiQuad *>(quad) != nullptr){ return true; }
+	if (dynamic_cast<IndexQuad *>(quad) != nullptr){ return true; }
+	Opd ** def = quad->defSlot();
+	if (def == nullptr || vars.id(*def) == VarIndex::NONE){ return false; }
+	if (dynamic_cast<BinOpQuad *>(quad) != nullptr){ return cannotTrap(quad); }
+	return dynamic_cast<UnaryOpQuad *>(quad) != nullptr
+		|| dynamic_cast<AssignQuad *>(quad) != nullptr;
+}
+
+size_t DCE::run(CFG * cfg){
+	VarIndex vars(cfg);
+
+	//Where each operand is defined
+	HashMap<Opd *, std::vector<Quad *>> defs;
+	std::vector<Quad *> work;
+	for (BasicBlock * block : cfg->getBlocks()){
+		for (Quad * quad : block->quads){
+			if (Opd ** def = quad->defSlot()){ defs[*def].push_back(quad); }
+			if (!pure(quad, vars)){ work.push_back(quad); }
+		}
+	}
+
+	//Every quad with an effect is needed, and so is whatever
+	// computes an operand a needed quad reads
+	std::set<Quad *> needed(work.begin(), work.end());
+	std::vector<Opd **> slots;
+	while (!work.empty()){
+		Quad * quad = work.back();
+		work.pop_back();
+		slots.clear();
+		quad->useSlots(slots);
+		for (Opd ** slot : slots){
+			auto found = defs.find(*slot);
+			if (found == defs.end()){ continue; }
+			for (Quad * def : found->second){
+				if (needed.insert(def).second){ work.push_back(def); }
+			}
+		}
+	}
+
+	size_t removed = 0;
+	for (BasicBlock * block : cfg->getBlocks()){
+		std::vector<Quad *> kept;
+		for (Quad * quad : block->quads){
+			if (needed.count(quad) != 0){ kept.push_back(quad); }
+		}
+		removed += block->quads.size() - kept.size();
+		block->quads.swap(kept);
+	}
+	return removed;
+}
+
+}
@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <tuple>
+#include "errors.hpp"
+
+namespace cshanty{
+
+void Diagnostics::add(Position * pos, Kind kind, const char * msg){
+	Entry entry;
+	if (pos == nullptr){
+		entry.lineI = entry.colI = entry.lineE = entry.colE = 0;
+	} else {
+		entry.lineI = pos->myLineI;
+		entry.colI = pos->myColI;
+		entry.lineE = pos->myLineE;
+		entry.colE = pos->myColE;
+	}
+	entry.kind = kind;
+	entry.msg = msg;
+	add(std::move(entry));
+}
+
+void Diagnostics::add(Entry&& entry){
+	EntryKey key = std::make_tuple(entry.lineI, entry.colI, entry.lineE,
+		entry.colE, entry.kind, entry.msg);
+	if (seen.count(key) != 0){ return; }
+	if (entry.kind == FATAL){
+		if (limit != 0 && errors == limit){
+			stopped = true;
+			throw new ErrorLimit(limit);
+		}
+		errors++;
+	}
+	reports++;
+	seen.insert(std::move(key));
+	entries.push_back(std::move(entry));
+}
+
+void Diagnostics::take(Diagnostics& other){
+	std::vector<Entry> taken;
+	taken.swap(other.entries);
+	other.seen.clear();
+	other.errors = 0;
+	other.reports = 0;
+	for (Entry& entry : taken){
+		add(std::move(entry));
+	}
+	if (other.stopped){
+		other.stopped = false;
+		//The other buffer gave up at its limit, which is never
+		// more than ours, so there is more to report than fits
+		stopped = true;
+		throw new ErrorLimit(limit);
+	}
+}
+
+static void appendSpan(std::string& text, size_t lineI, size_t colI,
+	size_t lineE, size_t colE){
+	text += '[';
+	text += std::to_string(lineI);
+	text += ',';
+	text += std::to_string(colI);
+	text += "]-[";
+	text += std::to_string(lineE);
+	text += ',';
+	text += std::to_string(colE);
+	text += ']';
+}
+
+void Diagnostics::flush(std::ostream& out){
+	if (entries.empty() && !stopped){ return; }
+
+	//Notes have no position, and go after everything else
+	auto key = [](const Entry& e){
+		return std::make_tuple(e.kind == NOTE,
+			e.lineI, e.colI, e.lineE, e.colE, e.kind, std::cref(e.msg));
+	};
+	std::stable_sort(entries.begin(), entries.end(),
+		[&](const Entry& a, const Entry& b){ return key(a) < key(b); });
+
+	std::string text;
+	for (const Entry& entry : entries){
+		if (entry.kind == FATAL){
+			text += "FATAL ";
+			appendSpan(text, entry.lineI, entry.colI,
+				entry.lineE, entry.colE);
+			text += ": ";
+		} else if (entry.kind == WARN){
+			text += "WARNING ";
+			appendSpan(text, entry.lineI, entry.colI,
+				entry.lineE, entry.colE);
+			text += ' ';
+		}
+		text += entry.msg;
+		text += '\n';
+	}
+	if (stopped){
+		text += "Too many errors (limit ";
+		text += std::to_string(limit);
+		text += "); stopping\n";
+	}
+	out.write(text.data(), static_cast<std::streamsize>(text.size()));
+	out.flush();
+
+	//The error count carries on, so the limit covers the
+	// whole compilation
+	entries.clear();
+	seen.clear();
+	stopped = false;
+}
+
+}
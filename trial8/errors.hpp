@@ -7,6 +7,10 @@
 #define TODO(x) throw new ToDoError(CODELOC #x);
 
 #include <iostream>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
 #include "position.hpp"
 
 namespace cshanty{
@@ -27,13 +31,127 @@ private:
 	const char * myMsg;
 };
 
+//Thrown by Report::fatal when an error would go past the
+// compilation's error limit; the phase that was running stops
+class ErrorLimit{
+public:
+	ErrorLimit(size_t limitIn) : myLimit(limitIn){}
+	size_t limit(){ return myLimit; }
+private:
+	size_t myLimit;
+};
+
+//Where a compilation's console output goes: std::cout and
+// std::cerr, unless the thread running it has redirected them.
+// Compilations running on worker threads write into their own
+// buffers, which the driver prints in input order once they
+// finish, so that the output of different files never mixes.
+class Console{
+public:
+	static std::ostream& out(){ return *outStream(); }
+	static std::ostream& err(){ return *errStream(); }
+	static void redirect(std::ostream * outIn, std::ostream * errIn){
+		outStream() = outIn;
+		errStream() = errIn;
+	}
+private:
+	static std::ostream *& outStream(){
+		static thread_local std::ostream * stream = &std::cout;
+		return stream;
+	}
+	static std::ostream *& errStream(){
+		static thread_local std::ostream * stream = &std::cerr;
+		return stream;
+	}
+};
+
+//Diagnostics held back until the end of a phase. While a buffer
+// is installed on a thread (see Use), Report adds to it instead of
+// writing to the console; flush() then reports everything in one
+// write, sorted by position, with duplicates dropped. Positions
+// are only formatted then. With a limit, the error that would go
+// past it is dropped and ErrorLimit thrown instead.
+class Diagnostics{
+public:
+	//A limit of 0 means no limit
+	explicit Diagnostics(size_t limitIn = 0) : limit(limitIn){ }
+
+	//The buffer installed on this thread, or nullptr
+	static Diagnostics * current(){ return installed(); }
+
+	//Installs a buffer on this thread for the lifetime of the
+	// Use object
+	class Use{
+	public:
+		Use(Diagnostics * diags) : prev(installed()){
+			installed() = diags;
+		}
+		~Use(){ installed() = prev; }
+	private:
+		Diagnostics * prev;
+	};
+
+	void fatal(Position * pos, const char * msg){
+		add(pos, FATAL, msg);
+	}
+	void warn(Position * pos, const char * msg){
+		add(pos, WARN, msg);
+	}
+	//A message with no position, reported after all the others
+	void note(const char * msg){ add(nullptr, NOTE, msg); }
+
+	//Take over the diagnostics another buffer collected (on a
+	// worker thread, say), as if they were reported here, and
+	// clear it
+	void take(Diagnostics& other);
+
+	void setLimit(size_t limitIn){ limit = limitIn; }
+	size_t getLimit() const { return limit; }
+	size_t errorCount() const { return errors; }
+	//Every diagnostic added so far, of any kind
+	size_t reportCount() const { return reports; }
+
+	//Report and clear everything collected so far
+	void flush(std::ostream& out);
+private:
+	enum Kind { FATAL, WARN, NOTE };
+	struct Entry{
+		size_t lineI, colI, lineE, colE;
+		Kind kind;
+		std::string msg;
+	};
+	typedef std::tuple<size_t, size_t, size_t, size_t, Kind, std::string>
+		EntryKey;
+
+	static Diagnostics *& installed(){
+		static thread_local Diagnostics * diags = nullptr;
+		return diags;
+	}
+	void add(Position * pos, Kind kind, const char * msg);
+	void add(Entry&& entry);
+
+	std::vector<Entry> entries;
+	//What is in entries, so that a repeat is neither kept nor
+	// counted against the limit
+	std::set<EntryKey> seen;
+	size_t limit;
+	size_t errors = 0;
+	size_t reports = 0;
+	bool stopped = false;
+};
+
 class Report{
 public:
 	static void fatal(
 		Position * pos,
 		const char * msg
 	){
-		std::cerr << "FATAL " 
+		Diagnostics * diags = Diagnostics::current();
+		if (diags != nullptr){
+			diags->fatal(pos, msg);
+			return;
+		}
+		Console::err() << "FATAL " 
 		<< pos->span()
 		<< ": " 
 		<< msg  << std::endl;
@@ -46,11 +164,26 @@ public:
 		fatal(pos,msg.c_str());
 	}
 
+	//A fatal error with no position (a syntax error, say)
+	static void fatal(const char * msg){
+		Diagnostics * diags = Diagnostics::current();
+		if (diags != nullptr){
+			diags->note(msg);
+			return;
+		}
+		Console::err() << msg << std::endl;
+	}
+
 	static void warn(
 		Position * pos,
 		const char * msg
 	){
-		std::cerr << "WARNING "
+		Diagnostics * diags = Diagnostics::current();
+		if (diags != nullptr){
+			diags->warn(pos, msg);
+			return;
+		}
+		Console::err() << "WARNING "
 		<< pos->span()
 		<< " " 
 		<< msg  << std::endl;
@@ -0,0 +1,232 @@
+#include "opt.hpp"
+#include "cfg.hpp"
+
+namespace cshanty{
+
+static bool commutative(BinOp op){
+	switch (op){
+	case ADD64: case MULT64: case EQ64: case NEQ64: case OR64: case AND64:
+		return true;
+	default:
+		return false;
+	}
+}
+
+//The state of one run of value numbering over one CFG
+class ValueNumberer{
+public:
+	ValueNumberer(CFG * cfgIn) : cfg(cfgIn), vars(cfgIn){ }
+	size_t run();
+private:
+	void visit(BasicBlock * block);
+	bool visitPhi(PhiQuad * phi, BasicBlock * block);
+	bool writesMemory(Quad * quad);
+	Opd * current(Opd * opd);
+	std::string operandKey(Opd * opd);
+	std::string exprKey(Quad * quad);
+	void rewriteUses(Quad * quad);
+
+	CFG * cfg;
+	VarIndex vars;
+	//The block defining each numbered operand
+	HashMap<Opd *, BasicBlock *> defBlocks;
+	//AddrOpds some IndexQuad defines, and how many do
+	HashMap<Opd *, size_t> addrDefs;
+	//The operand standing in for each one whose definition went
+	HashMap<Opd *, Opd *> replaced;
+	//The operand holding each expression's value, for the
+	// expressions computed in the blocks dominating this one
+	HashMap<std::string, Opd *> available;
+	std::vector<std::string> added;
+	//Values read from memory are only known to be the same
+	// between two writes to it in the one block. Every block
+	// starts, and every write to memory starts, a new epoch.
+	size_t epoch = 0;
+	size_t removed = 0;
+	std::vector<Opd **> slots;
+};
+
+Opd * ValueNumberer::current(Opd * opd){
+	auto found = replaced.find(opd);
+	return found == replaced.end() ? opd : found->second;
+}
+
+void ValueNumberer::rewriteUses(Quad * quad){
+	slots.clear();
+	quad->useSlots(slots);
+	for (Opd ** slot : slots){ *slot = current(*slot); }
+}
+
+//Whether the quad may change an operand that is not numbered:
+// a global, an address-taken local, or memory behind an AddrOpd
+bool ValueNumberer::writesMemory(Quad * quad){
+	if (dynamic_cast<CallQuad *>(quad) != nullptr){ return true; }
+	//Only the address is written, into the AddrOpd's own slot
+	if (dynamic_cast<IndexQuad *>(quad) != nullptr){ return false; }
+	if (Opd ** def = quad->defSlot()){ return vars.id(*def) == VarIndex::NONE; }
+	//Without a defined operand, these store through an AddrOpd
+	return dynamic_cast<BinOpQuad *>(quad) != nullptr
+		|| dynamic_cast<UnaryOpQuad *>(quad) != nullptr
+		|| dynamic_cast<AssignQuad *>(quad) != nullptr
+		|| dynamic_cast<IntrinsicInputQuad *>(quad) != nullptr;
+}
+
+std::string ValueNumberer::operandKey(Opd * opd){
+	if (LitOpd * lit = dynamic_cast<LitOpd *>(opd)){
+		return "#" + lit->valString() + ":" + std::to_string(lit->getWidth());
+	}
+	size_t var = vars.id(opd);
+	if (var != VarIndex::NONE){ return "v" + std::to_string(var); }
+	return "m" + std::to_string(reinterpret_cast<uintptr_t>(opd))
+		+ "@" + std::to_string(epoch);
+}
+
+//A string naming the value the quad computes, the same for any
+// two quads sure to compute the same value; empty if the quad is
+// not one value numbering handles
+std::string ValueNumberer::exprKey(Quad * quad){
+	if (IndexQuad * index = dynamic_cast<IndexQuad *>(quad)){
+		//The address of a record, or one an AddrOpd holds, does
+		// not change while the procedure runs
+		if (addrDefs[index->getDst()] != 1){ return ""; }
+		return "i" + std::to_string(reinterpret_cast<uintptr_t>(index->getSrc()))
+			+ "+" + operandKey(index->getOff());
+	}
+	Opd ** def = quad->defSlot();
+	if (def == nullptr || vars.id(*def) == VarIndex::NONE){ return ""; }
+	std::string width = ":" + std::to_string((*def)->getWidth());
+	if (BinOpQuad * bin = dynamic_cast<BinOpQuad *>(quad)){
+		std::string l = operandKey(bin->getSrc1());
+		std::string r = operandKey(bin->getSrc2());
+		if (commutative(bin->getOp()) && r < l){ std::swap(l, r); }
+		return "b" + BinOpQuad::oprString(bin->getOp()) + width
+			+ " " + l + " " + r;
+	}
+	if (UnaryOpQuad * un = dynamic_cast<UnaryOpQuad *>(quad)){
+		return "u" + std::to_string(static_cast<int>(un->getOp())) + width
+			+ " " + operandKey(un->getSrc());
+	}
+	if (AssignQuad * assign = dynamic_cast<AssignQuad *>(quad)){
+		//Only loads: a copy of a plain value is propagated instead
+		if (vars.id(assign->getSrc()) != VarIndex::NONE){ return ""; }
+		if (dynamic_cast<LitOpd *>(assign->getSrc()) != nullptr){ return ""; }
+		return "l" + width + " " + operandKey(assign->getSrc());
+	}
+	return "";
+}
+
+//A phi whose sources all hold the one value defined above its
+// block is that value. Returns whether the phi went.
+bool ValueNumberer::visitPhi(PhiQuad * phi, BasicBlock * block){
+	Opd * same = nullptr;
+	for (Opd * src : phi->getSrcs()){
+		src = current(src);
+		if (src == phi->getDst()){ continue; }
+		if (same != nullptr && src != same){ return false; }
+		same = src;
+	}
+	if (same == nullptr){ return false; }
+	auto def = defBlocks.find(same);
+	if (def == defBlocks.end() || def->second == block){ return false; }
+	if (!cfg->dominates(def->second, block)){ return false; }
+	replaced[phi->getDst()] = same;
+	return true;
+}
+
+void ValueNumberer::visit(BasicBlock * block){
+	epoch++;
+	std::vector<Quad *> kept;
+	for (Quad * quad : block->quads){
+		if (PhiQuad * phi = dynamic_cast<PhiQuad *>(quad)){
+			if (visitPhi(phi, block)){
+				removed++;
+			} else {
+				kept.push_back(quad);
+			}
+			continue;
+		}
+		rewriteUses(quad);
+		if (AssignQuad * assign = dynamic_cast<AssignQuad *>(quad)){
+			Opd * src = assign->getSrc();
+			Opd ** def = quad->defSlot();
+			if (def != nullptr && vars.id(*def) != VarIndex::NONE
+			  && vars.id(src) != VarIndex::NONE
+			  && src->getWidth() == (*def)->getWidth()){
+				replaced[*def] = src;
+				removed++;
+				continue;
+			}
+		}
+		std::string key = exprKey(quad);
+		if (!key.empty()){
+			Opd * dst = *quad->defSlot();
+			auto found = available.find(key);
+			if (found != available.end()){
+				replaced[dst] = found->second;
+				removed++;
+				continue;
+			}
+			available[key] = dst;
+			added.push_back(key);
+		}
+		if (writesMemory(quad)){ epoch++; }
+		kept.push_back(quad);
+	}
+	block->quads.swap(kept);
+}
+
+size_t ValueNumberer::run(){
+	for (BasicBlock * block : cfg->getBlocks()){
+		for (Quad * quad : block->quads){
+			if (IndexQuad * index = dynamic_cast<IndexQuad *>(quad)){
+				addrDefs[index->getDst()]++;
+			}
+			Opd ** def = quad->defSlot();
+			if (def != nullptr && vars.id(*def) != VarIndex::NONE){
+				defBlocks[*def] = block;
+			}
+		}
+	}
+
+	//Walk the dominator tree, so that every expression in the table
+	// was computed on every path to the block being visited
+	std::vector<std::pair<BasicBlock *, size_t>> stack;
+	std::vector<size_t> marks;
+	stack.push_back(std::make_pair(cfg->getEntry(), 0));
+	bool entering = true;
+	while (!stack.empty()){
+		BasicBlock * block = stack.back().first;
+		if (entering){
+			marks.push_back(added.size());
+			visit(block);
+		}
+		size_t next = stack.back().second;
+		if (next < block->domKids.size()){
+			stack.back().second++;
+			stack.push_back(std::make_pair(block->domKids[next], 0));
+			entering = true;
+			continue;
+		}
+		for (size_t i = marks.back(); i < added.size(); i++){
+			available.erase(added[i]);
+		}
+		added.resize(marks.back());
+		marks.pop_back();
+		stack.pop_back();
+		entering = false;
+	}
+
+	//Phi sources on back edges were read before the blocks they
+	// come from were visited
+	for (BasicBlock * block : cfg->getBlocks()){
+		for (Quad * quad : block->quads){ rewriteUses(quad); }
+	}
+	return removed;
+}
+
+size_t GVN::run(CFG * cfg){
+	ValueNumberer numberer(cfg);
+	return numberer.run();
+}
+
+}
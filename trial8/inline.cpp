@@ -0,0 +1,388 @@
+#include <algorithm>
+#include <iterator>
+#include <set>
+#include "opt.hpp"
+
+namespace cshanty{
+
+CallGraph::CallGraph(IRProgram * prog){
+	for (Procedure * proc : *prog->getProcs()){
+		byName[proc->getName()] = proc;
+	}
+	for (Procedure * proc : *prog->getProcs()){
+		std::vector<Procedure *>& out = calls[proc];
+		for (Quad * quad : *proc->getQuads()){
+			CallQuad * call = dynamic_cast<CallQuad *>(quad);
+			if (call == nullptr){ continue; }
+			Procedure * callee = this->callee(call);
+			if (callee != nullptr){ out.push_back(callee); }
+		}
+	}
+
+	//Tarjan's algorithm, without recursion. A cycle of calls is
+	// finished only after every procedure it calls, so finishing
+	// order is callees first.
+	HashMap<Procedure *, size_t> index;
+	HashMap<Procedure *, size_t> low;
+	std::vector<Procedure *> stack;
+	std::vector<std::pair<Procedure *, size_t>> walk;
+	for (Procedure * root : *prog->getProcs()){
+		if (index.count(root) != 0){ continue; }
+		walk.push_back(std::make_pair(root, 0));
+		while (!walk.empty()){
+			Procedure * proc = walk.back().first;
+			size_t next = walk.back().second;
+			if (next == 0){
+				size_t number = index.size();
+				index[proc] = number;
+				low[proc] = number;
+				stack.push_back(proc);
+			}
+			std::vector<Procedure *>& out = calls[proc];
+			if (next < out.size()){
+				walk.back().second++;
+				Procedure * callee = out[next];
+				if (index.count(callee) == 0){
+					walk.push_back(std::make_pair(callee, 0));
+				} else if (cycle.count(callee) == 0){
+					low[proc] = std::min(low[proc], index[callee]);
+				}
+				continue;
+			}
+			walk.pop_back();
+			if (!walk.empty()){
+				Procedure * caller = walk.back().first;
+				low[caller] = std::min(low[caller], low[proc]);
+			}
+			if (low[proc] != index[proc]){ continue; }
+			Procedure * member;
+			do {
+				member = stack.back();
+				stack.pop_back();
+				cycle[member] = index[proc];
+				order.push_back(member);
+			} while (member != proc);
+		}
+	}
+}
+
+Procedure * CallGraph::callee(CallQuad * call) const{
+	auto found = byName.find(call->getCallee()->getName());
+	return found == byName.end() ? nullptr : found->second;
+}
+
+bool CallGraph::recursive(Procedure * caller, Procedure * callee) const{
+	return cycle.at(caller) == cycle.at(callee);
+}
+
+//Where the quad stores through an AddrOpd, or nullptr
+static Opd * storedTo(Quad * quad){
+	Opd * dst = nullptr;
+	if (BinOpQuad * bin = dynamic_cast<BinOpQuad *>(quad)){
+		dst = bin->getDst();
+	} else if (UnaryOpQuad * un = dynamic_cast<UnaryOpQuad *>(quad)){
+		dst = un->getDst();
+	} else if (AssignQuad * assign = dynamic_cast<AssignQuad *>(quad)){
+		dst = assign->getDst();
+	} else if (IntrinsicInputQuad * in = dynamic_cast<IntrinsicInputQuad *>(quad)){
+		dst = in->getDst();
+	}
+	return dynamic_cast<AddrOpd *>(dst);
+}
+
+//A copy of a quad of a callee's body, with the same operands and
+// labels; GetArgQuads and SetRetQuads are not copied this way
+static Quad * cloneQuad(Quad * quad){
+	if (BinOpQuad * bin = dynamic_cast<BinOpQuad *>(quad)){
+		return new BinOpQuad(bin->getDst(), bin->getOp(), bin->getSrc1(),
+			bin->getSrc2());
+	}
+	if (UnaryOpQuad * un = dynamic_cast<UnaryOpQuad *>(quad)){
+		return new UnaryOpQuad(un->getDst(), un->getOp(), un->getSrc());
+	}
+	if (AssignQuad * assign = dynamic_cast<AssignQuad *>(quad)){
+		return new AssignQuad(assign->getDst(), assign->getSrc(), false);
+	}
+	if (IndexQuad * index = dynamic_cast<IndexQuad *>(quad)){
+		return new IndexQuad(static_cast<AddrOpd *>(index->getDst()),
+			index->getSrc(), index->getOff());
+	}
+	if (GotoQuad * jump = dynamic_cast<GotoQuad *>(quad)){
+		return new GotoQuad(jump->getTarget());
+	}
+	if (IfzQuad * ifz = dynamic_cast<IfzQuad *>(quad)){
+		return new IfzQuad(ifz->getCnd(), ifz->getTarget());
+	}
+	if (dynamic_cast<NopQuad *>(quad) != nullptr){ return new NopQuad(); }
+	if (IntrinsicOutputQuad * out = dynamic_cast<IntrinsicOutputQuad *>(quad)){
+		return new IntrinsicOutputQuad(out->getSrc(), out->getType());
+	}
+	if (IntrinsicInputQuad * in = dynamic_cast<IntrinsicInputQuad *>(quad)){
+		return new IntrinsicInputQuad(in->getDst(), in->getType());
+	}
+	if (dynamic_cast<TailCallQuad *>(quad) != nullptr){
+		throw new InternalError("Tail call inlined as a plain quad");
+	}
+	if (CallQuad * call = dynamic_cast<CallQuad *>(quad)){
+		return new CallQuad(call->getCallee());
+	}
+	if (SetArgQuad * arg = dynamic_cast<SetArgQuad *>(quad)){
+		return new SetArgQuad(arg->getIndex(), arg->getSrc(), arg->getType());
+	}
+	if (GetRetQuad * ret = dynamic_cast<GetRetQuad *>(quad)){
+		return new GetRetQuad(ret->getDst(), ret->isRecord());
+	}
+	throw new InternalError("Quad cannot be inlined");
+}
+
+//The state of inlining calls into one procedure
+class CallInliner{
+public:
+	CallInliner(Procedure * procIn, const CallGraph& graphIn, size_t thresholdIn)
+	: proc(procIn), graph(graphIn), threshold(thresholdIn),
+	  globals(procIn->getProg()->globalSyms()){ }
+	size_t run();
+private:
+	Procedure * inlinable(CallQuad * call, const std::vector<SetArgQuad *>& args);
+	bool writesFormal(Procedure * callee, Opd * formal);
+	void expand(Procedure * callee, const std::vector<SetArgQuad *>& args,
+		CallQuad * call, GetRetQuad * getRet);
+	Opd * copyOf(Procedure * callee, Opd * opd);
+	Label * labelOf(Label * label);
+	void emit(Quad * quad);
+
+	Procedure * proc;
+	const CallGraph& graph;
+	size_t threshold;
+	std::set<Opd *> globals;
+	//For the call being inlined: the caller's stand-in for each
+	// operand and label of the callee
+	HashMap<Opd *, Opd *> opds;
+	HashMap<Label *, Label *> labels;
+	std::list<Quad *> body;
+	//Labels of the quads a call replaced, for the first quad
+	// put in their place
+	std::vector<Label *> pending;
+};
+
+//Whether the callee's body may change a record formal, which it
+// would then need its own copy of
+bool CallInliner::writesFormal(Procedure * callee, Opd * formal){
+	std::set<Opd *> fields;
+	for (Quad * quad : *callee->getQuads()){
+		if (dynamic_cast<GetArgQuad *>(quad) != nullptr){ continue; }
+		if (IndexQuad * index = dynamic_cast<IndexQuad *>(quad)){
+			Opd * src = index->getSrc();
+			if (src == formal || fields.count(src) != 0){
+				fields.insert(index->getDst());
+			}
+			continue;
+		}
+		Opd ** def = quad->defSlot();
+		if (def != nullptr && *def == formal){ return true; }
+		Opd * stored = storedTo(quad);
+		if (stored != nullptr && fields.count(stored) != 0){ return true; }
+	}
+	return false;
+}
+
+//The callee of a call that may be inlined here, or nullptr
+Procedure * CallInliner::inlinable(CallQuad * call,
+  const std::vector<SetArgQuad *>& args){
+	Procedure * callee = graph.callee(call);
+	if (callee == nullptr || callee->getName() == "main"){ return nullptr; }
+	if (graph.recursive(proc, callee)){ return nullptr; }
+	size_t numFormals = callee->getFormals().size();
+	if (args.size() != numFormals){ return nullptr; }
+	for (size_t i = 0; i < numFormals; i++){
+		if (args[i]->getIndex() != i + 1){ return nullptr; }
+		//A record goes by the address of the variable holding it
+		if (args[i]->getType()->isRecord()
+		  && dynamic_cast<SymOpd *>(args[i]->getSrc()) == nullptr){
+			return nullptr;
+		}
+	}
+
+	//Each argument costs a SetArgQuad and a GetArgQuad, on top of
+	// the call itself; a callee may be that much bigger than the
+	// threshold and still not grow the program by more than it
+	size_t size = 0;
+	for (Quad * quad : *callee->getQuads()){
+		if (SetRetQuad * ret = dynamic_cast<SetRetQuad *>(quad)){
+			if (ret->isRecord()){ return nullptr; }
+		}
+		if (dynamic_cast<GetArgQuad *>(quad) != nullptr){ continue; }
+		if (dynamic_cast<NopQuad *>(quad) != nullptr){ continue; }
+		size++;
+	}
+	if (size > threshold + 2 * numFormals){ return nullptr; }
+	return callee;
+}
+
+Label * CallInliner::labelOf(Label * label){
+	Label *& copy = labels[label];
+	if (copy == nullptr){ copy = proc->makeLabel(); }
+	return copy;
+}
+
+//The caller's stand-in for an operand of the callee. Globals and
+// literals are shared; everything of the callee's own gets a new
+// operand for each call inlined, scalars as temps.
+Opd * CallInliner::copyOf(Procedure * callee, Opd * opd){
+	if (dynamic_cast<LitOpd *>(opd) != nullptr){ return opd; }
+	if (globals.count(opd) != 0){ return opd; }
+	Opd *& copy = opds[opd];
+	if (copy != nullptr){ return copy; }
+	std::string prefix = callee->getName() + ".";
+	if (AuxOpd * tmp = dynamic_cast<AuxOpd *>(opd)){
+		copy = proc->makeTmp(tmp->getWidth(), prefix + tmp->getName());
+	} else if (dynamic_cast<AddrOpd *>(opd) != nullptr){
+		copy = proc->makeAddrOpd(opd->getWidth());
+	} else if (SymOpd * sym = dynamic_cast<SymOpd *>(opd)){
+		if (sym->getSym()->getDataType()->isRecord()){
+			copy = proc->inlineLocal(sym);
+		} else {
+			copy = proc->makeTmp(sym->getWidth(), prefix + sym->getName());
+		}
+	} else {
+		throw new InternalError("Operand cannot be inlined");
+	}
+	return copy;
+}
+
+void CallInliner::emit(Quad * quad){
+	for (Label * label : pending){ quad->addLabel(label); }
+	pending.clear();
+	body.push_back(quad);
+}
+
+void CallInliner::expand(Procedure * callee, const std::vector<SetArgQuad *>& args,
+  CallQuad * call, GetRetQuad * getRet){
+	opds.clear();
+	labels.clear();
+	Label * after = proc->makeLabel();
+	labels[callee->getLeaveLabel()] = after;
+	//A tail call's value is returned once past the copy, since
+	// nothing may come between a SetRetQuad and leaving
+	bool tail = dynamic_cast<TailCallQuad *>(call) != nullptr;
+	Opd * result = getRet == nullptr ? nullptr : getRet->getDst();
+
+	//A record formal the callee only reads can be the caller's
+	// record itself, rather than a copy of it. A global might be
+	// changed under it, so globals are always copied.
+	std::vector<SymOpd *> formals;
+	for (SymOpd * formal : callee->getFormals()){ formals.push_back(formal); }
+	for (size_t i = 0; i < formals.size(); i++){
+		Opd * actual = args[i]->getSrc();
+		if (args[i]->getType()->isRecord() && globals.count(actual) == 0
+		  && !writesFormal(callee, formals[i])){
+			opds[formals[i]] = actual;
+		}
+	}
+
+	for (Quad * quad : *callee->getQuads()){
+		for (Label * label : quad->getLabels()){ pending.push_back(labelOf(label)); }
+		if (GetArgQuad * getArg = dynamic_cast<GetArgQuad *>(quad)){
+			Opd * actual = args[getArg->getIndex() - 1]->getSrc();
+			Opd * formal = copyOf(callee, getArg->getDst());
+			if (formal == actual){ continue; }
+			if (!getArg->isRecord()){
+				emit(new AssignQuad(formal, actual, false));
+				continue;
+			}
+			//What GetArgQuad does for a record, a word at a time
+			for (size_t off = 0; off < formal->getWidth(); off += 8){
+				AddrOpd * from = proc->makeAddrOpd(8);
+				AddrOpd * to = proc->makeAddrOpd(8);
+				LitOpd * offset = LitOpd::buildInt(static_cast<int>(off));
+				emit(new IndexQuad(from, actual, offset));
+				emit(new IndexQuad(to, formal, offset));
+				emit(new AssignQuad(to, from, false));
+			}
+			continue;
+		}
+		if (SetRetQuad * setRet = dynamic_cast<SetRetQuad *>(quad)){
+			if (tail && result == nullptr){
+				result = proc->makeTmp(setRet->getSrc()->getWidth());
+			}
+			if (result != nullptr){
+				emit(new AssignQuad(result, copyOf(callee, setRet->getSrc()),
+					false));
+			}
+			continue;
+		}
+		if (TailCallQuad * tailCall = dynamic_cast<TailCallQuad *>(quad)){
+			//Still a tail call only if the call inlined was one
+			if (tail){
+				emit(new TailCallQuad(tailCall->getCallee(), proc));
+				continue;
+			}
+			emit(new CallQuad(tailCall->getCallee()));
+			if (result != nullptr){ emit(new GetRetQuad(result, false)); }
+			continue;
+		}
+		Quad * copy = cloneQuad(quad);
+		std::vector<Opd **> slots;
+		copy->useSlots(slots);
+		if (Opd ** def = copy->defSlot()){ slots.push_back(def); }
+		for (Opd ** slot : slots){ *slot = copyOf(callee, *slot); }
+		if (GotoQuad * jump = dynamic_cast<GotoQuad *>(copy)){
+			jump->setTarget(labelOf(jump->getTarget()));
+		} else if (IfzQuad * ifz = dynamic_cast<IfzQuad *>(copy)){
+			ifz->setTarget(labelOf(ifz->getTarget()));
+		}
+		emit(copy);
+	}
+	pending.push_back(after);
+	emit(new NopQuad());
+	if (tail && result != nullptr){ emit(new SetRetQuad(result, false)); }
+}
+
+size_t CallInliner::run(){
+	size_t inlined = 0;
+	//The SetArgQuads just before the quad being looked at, which
+	// are those of the call that follows them
+	std::vector<SetArgQuad *> args;
+	std::list<Quad *> * quads = proc->getQuads();
+	for (auto itr = quads->begin(); itr != quads->end(); itr++){
+		Quad * quad = *itr;
+		if (SetArgQuad * arg = dynamic_cast<SetArgQuad *>(quad)){
+			args.push_back(arg);
+			continue;
+		}
+		CallQuad * call = dynamic_cast<CallQuad *>(quad);
+		Procedure * callee = nullptr;
+		if (call != nullptr){ callee = inlinable(call, args); }
+		if (callee == nullptr){
+			for (SetArgQuad * arg : args){ body.push_back(arg); }
+			args.clear();
+			body.push_back(quad);
+			continue;
+		}
+		GetRetQuad * getRet = nullptr;
+		auto next = std::next(itr);
+		if (next != quads->end()){ getRet = dynamic_cast<GetRetQuad *>(*next); }
+		if (getRet != nullptr){ itr = next; }
+		for (SetArgQuad * arg : args){
+			for (Label * label : arg->getLabels()){ pending.push_back(label); }
+		}
+		for (Label * label : call->getLabels()){ pending.push_back(label); }
+		if (getRet != nullptr){
+			for (Label * label : getRet->getLabels()){ pending.push_back(label); }
+		}
+		expand(callee, args, call, getRet);
+		args.clear();
+		inlined++;
+	}
+	for (SetArgQuad * arg : args){ body.push_back(arg); }
+	quads->swap(body);
+	return inlined;
+}
+
+size_t Inliner::run(Procedure * proc, const CallGraph& graph, size_t threshold){
+	if (threshold == 0){ return 0; }
+	CallInliner inliner(proc, graph, threshold);
+	return inliner.run();
+}
+
+}
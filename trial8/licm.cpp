@@ -0,0 +1,115 @@
+#include "opt.hpp"
+#include "cfg.hpp"
+
+namespace cshanty{
+
+//The state of one run of LICM over one CFG
+class LoopHoister{
+public:
+	LoopHoister(CFG * cfgIn) : cfg(cfgIn), vars(cfgIn){ }
+	size_t run();
+private:
+	bool invariant(Quad * quad, Loop * loop);
+	bool setOutside(Opd * opd, Loop * loop);
+	void hoist(Loop * loop, BasicBlock * preheader);
+
+	CFG * cfg;
+	VarIndex vars;
+	//The block defining each numbered operand, and the address in
+	// each AddrOpd, with how many IndexQuads set one
+	HashMap<Opd *, BasicBlock *> defBlocks;
+	HashMap<Opd *, BasicBlock *> addrBlocks;
+	HashMap<Opd *, size_t> addrDefs;
+	size_t moved = 0;
+};
+
+//Whether the operand holds the same value all through the loop.
+// Operands read from memory never count.
+bool LoopHoister::setOutside(Opd * opd, Loop * loop){
+	if (dynamic_cast<LitOpd *>(opd) != nullptr){ return true; }
+	auto def = defBlocks.find(opd);
+	if (def == defBlocks.end()){ return false; }
+	return !loop->contains(def->second);
+}
+
+bool LoopHoister::invariant(Quad * quad, Loop * loop){
+	if (IndexQuad * index = dynamic_cast<IndexQuad *>(quad)){
+		if (addrDefs[index->getDst()] != 1){ return false; }
+		//A record's own address never changes, and an AddrOpd's
+		// only changes where an IndexQuad sets it
+		Opd * src = index->getSrc();
+		if (dynamic_cast<AddrOpd *>(src) != nullptr){
+			if (addrDefs[src] != 1){ return false; }
+			if (loop->contains(addrBlocks[src])){ return false; }
+		}
+		return setOutside(index->getOff(), loop);
+	}
+	Opd ** def = quad->defSlot();
+	if (def == nullptr || vars.id(*def) == VarIndex::NONE){ return false; }
+	if (BinOpQuad * bin = dynamic_cast<BinOpQuad *>(quad)){
+		return cannotTrap(quad) && setOutside(bin->getSrc1(), loop)
+			&& setOutside(bin->getSrc2(), loop);
+	}
+	if (UnaryOpQuad * un = dynamic_cast<UnaryOpQuad *>(quad)){
+		return setOutside(un->getSrc(), loop);
+	}
+	return false;
+}
+
+void LoopHoister::hoist(Loop * loop, BasicBlock * preheader){
+	//In reverse postorder each operand a quad reads is defined in
+	// the loop only by a quad already looked at, or by a phi
+	for (BasicBlock * block : loop->blocks){
+		std::vector<Quad *> kept;
+		for (Quad * quad : block->quads){
+			if (!invariant(quad, loop)){
+				kept.push_back(quad);
+				continue;
+			}
+			preheader->quads.push_back(quad);
+			if (dynamic_cast<IndexQuad *>(quad) != nullptr){
+				addrBlocks[*quad->defSlot()] = preheader;
+			} else {
+				defBlocks[*quad->defSlot()] = preheader;
+			}
+			moved++;
+		}
+		block->quads.swap(kept);
+	}
+}
+
+size_t LoopHoister::run(){
+	for (BasicBlock * block : cfg->getBlocks()){
+		for (Quad * quad : block->quads){
+			if (IndexQuad * index = dynamic_cast<IndexQuad *>(quad)){
+				addrDefs[index->getDst()]++;
+				addrBlocks[index->getDst()] = block;
+				continue;
+			}
+			Opd ** def = quad->defSlot();
+			if (def != nullptr && vars.id(*def) != VarIndex::NONE){
+				defBlocks[*def] = block;
+			}
+		}
+	}
+	//Inner loops come after the loops around them. Going the other
+	// way, what leaves an inner loop may then leave the outer one.
+	const std::vector<Loop *>& loops = cfg->getLoops();
+	for (auto itr = loops.rbegin(); itr != loops.rend(); itr++){
+		Loop * loop = *itr;
+		hoist(loop, cfg->addPreheader(loop));
+	}
+	return moved;
+}
+
+size_t LICM::run(CFG * cfg){
+	if (cfg->getLoops().empty()){ return 0; }
+	//Made first, so that their phis are numbered like any other
+	std::vector<Loop *> loops = cfg->getLoops();
+	for (Loop * loop : loops){ cfg->addPreheader(loop); }
+	cfg->analyze();
+	LoopHoister hoister(cfg);
+	return hoister.run();
+}
+
+}
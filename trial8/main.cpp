@@ -1,83 +1,65 @@
 #include <iostream>
+#include <atomic>
 #include <cstdlib>
 #include <cstring>
 #include <fstream>
+#include <sstream>
 #include <string.h>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
 #include "unistd.h"
 #include "errors.hpp"
 #include "scanner.hpp"
 #include "name_analysis.hpp"
 #include "type_analysis.hpp"
+#include "pipeline.hpp"
+#include "opt.hpp"
+#include "output_sink.hpp"
+#include "time_report.hpp"
+#include "trace.hpp"
 
 using namespace cshanty;
 
 static void usageAndDie(){
-	std::cerr << "Usage: cshantyc <infile>\n"
+	std::cerr << "Usage: cshantyc <infile> [<infile> ...]\n"
 	<< " [-t <tokensFile>]: Output tokens to <tokensFile>\n"
 	<< " [-p]: Parse the input to check syntax\n"
 	<< " [-u <unparseFile>]: Output canonical program text to <unparseFile>\n"
 	<< " [-n <nameFile>]: Output name analysis to <nameFile>\n"
 	<< " [-c]: Do type checking\n"
 	<< " [-a <3ACFile>]: Output program as 3-address code\n"
+	<< " [-v]: With -a, add comments, and each block's live operands and"
+	<< " the definitions of them that reach it\n"
 	<< " [-o <ASMFile>]: Output x64 assembly to <ASMFile>\n"
+	<< " [-O]: Optimize the 3AC before it is output (-a, -o)\n"
+	<< " [--opt-report]: With -O, report the quads and stack bytes each"
+	<< " procedure lost\n"
+	<< " [--inline-threshold=<quads>]: With -O, inline calls to procedures"
+	<< " of up to <quads> quads (default " << Optimizer::DEFAULT_INLINE_THRESHOLD
+	<< ", 0 for none)\n"
 	<< " [-l <LLVMFile>]: Output LLVM Bitcode to <LLVMFile>\n"
+	<< " [-k <cacheDir>]: Reuse type-checked ASTs cached in <cacheDir>\n"
+	<< " [-j <jobs>]: Compile up to <jobs> inputs at once\n"
+	<< " [-J <jobs>]: Type-check up to <jobs> functions of an input at once\n"
+	<< " [-e <count>]: Stop after reporting <count> errors\n"
+	<< " [--time-report[=json]]: Report time, allocations and peak RSS"
+	<< " per phase\n"
+	<< " [--trace=<traceFile>]: Write a Chrome trace of the compilation"
+	<< " to <traceFile>\n"
+	<< "With several inputs, every output file name must contain a %,\n"
+	<< " which is replaced by the input's name (e.g. -o %.s)\n"
 	;
 	std::cout << std::flush;
 	std::cerr << std::flush;
 	exit(1);
 }
 
-static void writeTokenStream(const char * inPath, const char * outPath){
-	std::ifstream inStream(inPath);
-	if (!inStream.good()){
-		std::string msg = "Bad input stream";
-		msg += inPath;
-		throw new cshanty::InternalError(msg.c_str());
-	}
-	if (outPath == nullptr){
-		std::string msg = "No tokens output file given";
-		throw new cshanty::InternalError(msg.c_str());
-	}
-
-	Scanner scanner(&inStream);
-	if (strcmp(outPath, "--") == 0){
-		scanner.outputTokens(std::cout);
-	} else {
-		std::ofstream outStream(outPath);
-		if (!outStream.good()){
-			std::string msg = "Bad output file ";
-			msg += outPath;
-			throw new InternalError(msg.c_str());
-		}
-		scanner.outputTokens(outStream);
-		outStream.close();
-	}
-}
-
-static cshanty::ProgramNode * parse(const char * inFile){
-	std::ifstream inStream(inFile);
-	if (!inStream.good()){
-		std::string msg = "Bad input stream ";
-		msg += inFile;
-		throw new InternalError(msg.c_str());
-	}
-
-	//This pointer will be set to the root of the
-	// AST after parsing
-	cshanty::ProgramNode * root = nullptr;
-
-	cshanty::Scanner scanner(&inStream);
-	cshanty::Parser parser(scanner, &root);
-
-	int errCode = parser.parse();
-	if (errCode != 0){ return nullptr; }
-
-	return root;
-}
-
 static void outputAST(ASTNode * ast, const char * outPath){
+	TIME_PHASE("unparse");
 	if (strcmp(outPath, "--") == 0){
-		ast->unparse(std::cout, 0);
+		OutputSink out(Console::out());
+		ast->unparse(out, 0);
 	} else {
 		std::ofstream outStream(outPath);
 		if (!outStream.good()){
@@ -85,74 +67,51 @@ static void outputAST(ASTNode * ast, const char * outPath){
 			msg += outPath;
 			throw new cshanty::InternalError(msg.c_str());
 		}
-		ast->unparse(outStream, 0);
+		OutputSink out(outStream);
+		ast->unparse(out, 0);
 	}
 }
 
-static cshanty::NameAnalysis * doNameAnalysis(const char * inputPath){
-	cshanty::ProgramNode * ast = parse(inputPath);
-	if (ast == nullptr){ return nullptr; }
-	
-	return cshanty::NameAnalysis::build(ast);
-}
-
-static bool doUnparsing(const char * inputPath, const char * outPath){
-	cshanty::ProgramNode * ast = parse(inputPath);
-	if (ast == nullptr){ 
-		std::cerr << "No AST built\n";
-		return false;
-	}
-
-	outputAST(ast, outPath);
-	return true;
-}
-
-static cshanty::TypeAnalysis * doTypeAnalysis(const char * inputPath){
-	cshanty::NameAnalysis * nameAnalysis = doNameAnalysis(inputPath);
-	if (nameAnalysis == nullptr){ return nullptr; }
-	return TypeAnalysis::build(nameAnalysis);
-}
-
-static void write3AC(cshanty::IRProgram * prog, const char * outPath){
+static void write3AC(cshanty::IRProgram * prog, const char * outPath,
+	bool verbose){
 	if (outPath == nullptr){
 		throw new InternalError("Null 3AC flat file given");
 	}
-	std::string flatProg = prog->toString();
+	TIME_PHASE("3AC output");
 	if (strcmp(outPath, "--") == 0){
-		std::cout << flatProg << std::endl;
+		OutputSink out(Console::out());
+		prog->print(out, verbose);
+		out << '\n';
 	} else {
 		std::ofstream outStream(outPath);
-		outStream << flatProg << std::endl;
-		outStream.close();
+		OutputSink out(outStream);
+		prog->print(out, verbose);
+		out << '\n';
 	}
 }
 
 
-static IRProgram * do3AC(const char * inputPath){
-	cshanty::TypeAnalysis * typeAnalysis = doTypeAnalysis(inputPath);
-	if (typeAnalysis == nullptr){ return nullptr; }
-	
-	IRProgram * prog = typeAnalysis->ast->to3AC(typeAnalysis);
-	return prog;
-}
-
 static int writeX64(cshanty::IRProgram * prog, const char * outPath){
 	if (outPath == nullptr){
 		throw new InternalError("Null codegen file given");
 	}
+	TIME_PHASE("x64 emission");
 	if (strcmp(outPath, "--") == 0){
-		prog->toX64(std::cout);
+		OutputSink out(Console::out());
+		prog->toX64(out);
 	} else {
 		std::ofstream outStream(outPath);
-		prog->toX64(outStream);
-		outStream.close();
+		OutputSink out(outStream);
+		prog->toX64(out);
 	}
 	return 0;
 }
 
 static void outputCPP(ASTNode* ast, const char* outPath) {
+	TIME_PHASE("C transpilation");
 	if (strcmp(outPath, "--") == 0){
-		ast->transpileToC(std::cout, 0);
+		OutputSink out(Console::out());
+		ast->transpileToC(out, 0);
 	} else {
 		std::ofstream outStream(outPath);
 		if (!outStream.good()){
@@ -160,36 +119,37 @@ static void outputCPP(ASTNode* ast, const char* outPath) {
 			msg += outPath;
 			throw new cshanty::InternalError(msg.c_str());
 		}
-		ast->transpileToC(outStream, 0);
+		OutputSink out(outStream);
+		ast->transpileToC(out, 0);
 	}
 }
 
-static std::string doTranspiling(const char* inputPath, const char* outPath) {
-	std::string cfile(outPath);
-	cfile += ".c";
+static std::string doTranspiling(ASTNode * ast, const char* outPath) {
 	if (outPath == nullptr){
 		throw new InternalError("Null codegen file given");
 	}
-	cshanty::ProgramNode * ast = doTypeAnalysis(inputPath)->ast;
-	if (ast == nullptr){ 
-		std::cerr << "No AST built\n";
-	} else {
-		outputCPP(ast, cfile.c_str());
-	}
+	std::string cfile(outPath);
+	cfile += ".c";
+	outputCPP(ast, cfile.c_str());
 	return cfile;
 }
 
-int main( const int argc, const char **argv )
-{
-	if (argc <= 1){ usageAndDie(); }
-	std::ifstream * input = new std::ifstream(argv[1]);
-	if (input == nullptr){ usageAndDie(); }
-	if (!input->good()){
-		std::cerr << "Bad path " << argv[1] << std::endl;
-		usageAndDie();
+//Run clang on the transpiled C, and wait for it to finish
+static int emitLLVM(const std::string& cfile, const char * llvmFile){
+	TIME_PHASE("LLVM (clang)");
+	pid_t pid = fork();
+	if (pid == 0){
+		execl("/usr/bin/clang-9","/usr/bin/clang-9",cfile.c_str(),"-S","-emit-llvm","-o",llvmFile, (char*)NULL);
+		_exit(127);
 	}
+	int status = 0;
+	if (pid < 0 || waitpid(pid, &status, 0) < 0){ return 1; }
+	return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : 1;
+}
 
-	const char * inFile = NULL;
+//The outputs requested on the command line, which are the same
+// for every input
+struct Outputs{
 	const char * tokensFile = NULL;
 	bool checkParse = false;
 	const char * unparseFile = NULL;
@@ -198,121 +158,365 @@ int main( const int argc, const char **argv )
 	const char * threeACFile = NULL;
 	const char * asmFile = NULL;
 	const char * llvmFile = NULL;
+	const char * cacheDir = NULL;
+	unsigned int checkJobs = 1;
+	bool optimize = false;
+	bool verbose = false;
+	bool optReport = false;
+	size_t inlineThreshold = Optimizer::DEFAULT_INLINE_THRESHOLD;
+	size_t errorLimit = 0;
+	bool timeReport = false;
+	TimeReport::Format timeFormat = TimeReport::TEXT;
+};
+
+//The name of one input's output: the requested path, with any %
+// replaced by the input's file name minus directory and extension
+static std::string outputFor(const char * path, const char * inFile){
+	std::string res(path);
+	size_t pct = res.find('%');
+	if (pct == std::string::npos){ return res; }
+	std::string stem(inFile);
+	size_t slash = stem.rfind('/');
+	if (slash != std::string::npos){ stem = stem.substr(slash + 1); }
+	size_t dot = stem.rfind('.');
+	if (dot != std::string::npos && dot > 0){ stem = stem.substr(0, dot); }
+	res.replace(pct, 1, stem);
+	return res;
+}
+
+//Compile one input. Diagnostics and "--" outputs go to this
+// thread's Console streams.
+static int compileInput(const char * inFile, const Outputs& req,
+	OptReport * optReport){
+	std::string tokensPath, unparsePath, namesPath;
+	std::string threeACPath, asmPath, llvmPath;
+	const char * tokensFile = NULL;
+	const char * unparseFile = NULL;
+	const char * namesFile = NULL;
+	const char * threeACFile = NULL;
+	const char * asmFile = NULL;
+	const char * llvmFile = NULL;
+	if (req.tokensFile){
+		tokensPath = outputFor(req.tokensFile, inFile);
+		tokensFile = tokensPath.c_str();
+	}
+	if (req.unparseFile){
+		unparsePath = outputFor(req.unparseFile, inFile);
+		unparseFile = unparsePath.c_str();
+	}
+	if (req.namesFile){
+		namesPath = outputFor(req.namesFile, inFile);
+		namesFile = namesPath.c_str();
+	}
+	if (req.threeACFile){
+		threeACPath = outputFor(req.threeACFile, inFile);
+		threeACFile = threeACPath.c_str();
+	}
+	if (req.asmFile){
+		asmPath = outputFor(req.asmFile, inFile);
+		asmFile = asmPath.c_str();
+	}
+	if (req.llvmFile){
+		llvmPath = outputFor(req.llvmFile, inFile);
+		llvmFile = llvmPath.c_str();
+	}
+	bool checkParse = req.checkParse;
+	bool checkTypes = req.checkTypes;
+
+	try {
+		//Every output below is served from this one pipeline,
+		// so each phase runs at most once
+		cshanty::Pipeline pipeline(inFile);
+		if (req.cacheDir != nullptr){ pipeline.setCacheDir(req.cacheDir); }
+		pipeline.setUnparse(unparseFile != nullptr);
+		pipeline.setCheckJobs(req.checkJobs);
+		pipeline.setOptimize(req.optimize);
+		pipeline.setOptReport(optReport);
+		pipeline.setInlineThreshold(req.inlineThreshold);
+		pipeline.setErrorLimit(req.errorLimit);
+		bool needsAST = checkParse || unparseFile || namesFile
+			|| checkTypes || threeACFile || asmFile || llvmFile;
+		if (tokensFile != nullptr){
+			pipeline.setTokenOutput(tokensFile);
+			//Otherwise the tokens come from the parser's scan
+			if (!needsAST){ pipeline.scan(); }
+		}
+		if (checkParse){
+			if (!pipeline.parse()){
+				Console::err() << "Parse failed" << std::endl;
+			}
+		}
+		if (unparseFile != nullptr){
+			cshanty::ProgramNode * ast = pipeline.parse();
+			if (ast == nullptr){
+				Console::err() << "No AST built\n";
+			} else {
+				outputAST(ast, unparseFile);
+			}
+		}
+		if (namesFile){
+			cshanty::NameAnalysis * na = pipeline.nameAnalysis();
+			if (na == nullptr){
+				Console::err() << "Name Analysis Failed\n";
+				return 1;
+			}
+			outputAST(na->ast, namesFile);
+		}
+		if (checkTypes){
+			cshanty::TypeAnalysis * ta = pipeline.typeAnalysis();
+			if (ta == nullptr){
+				Console::err() << "Type Analysis Failed\n";
+				return 1;
+			}
+		}
+		if (threeACFile != nullptr){
+			auto prog = pipeline.ir();
+			if (prog == nullptr){ return 1; }
+			write3AC(prog, threeACFile, req.verbose);
+		}
+		if (asmFile != nullptr){
+			auto prog = pipeline.ir();
+			if (prog == nullptr){ return 1; }
+			writeX64(prog, asmFile);
+		}
+		if (llvmFile != nullptr) {
+			cshanty::TypeAnalysis * ta = pipeline.typeAnalysis();
+			if (ta == nullptr){
+				Console::err() << "No AST built\n";
+				return 1;
+			}
+			std::string cfile = doTranspiling(ta->ast, llvmFile);
+			return emitLLVM(cfile, llvmFile);
+		}
+	} catch (cshanty::ToDoError * e){
+		Console::err() << "ToDoError: " << e->msg() << "\n";
+		return 1;
+	} catch (cshanty::InternalError& e){
+		Console::err() << "InternalError: " << e.msg() << "\n";
+		return 1;
+	} catch (cshanty::InternalError* e) {
+		Console::err() << "InternalError: " << e->msg() << "\n";
+		return 1;
+	}
+
+	return 0;
+}
+
+//Compile one input, then print its time and optimization reports
+// if they were asked for
+static int compile(const char * inFile, const Outputs& req){
+	TRACE_SPAN("compile", inFile);
+	OptReport optReport;
+	OptReport * optOut = req.optReport ? &optReport : nullptr;
+	if (!req.timeReport){
+		int res = compileInput(inFile, req, optOut);
+		if (optOut != nullptr){ optReport.print(Console::err(), inFile); }
+		return res;
+	}
+	TimeReport report(req.timeFormat);
+	int res;
+	{
+		TimeReport::Use timed(&report);
+		res = compileInput(inFile, req, optOut);
+	}
+	report.print(Console::err(), inFile);
+	if (optOut != nullptr){ optReport.print(Console::err(), inFile); }
+	return res;
+}
+
+//Write the trace, if one is being taken, once every input is done
+static int finishTrace(int res){
+	try {
+		Trace::finish();
+	} catch (cshanty::InternalError * e){
+		std::cerr << "InternalError: " << e->msg() << "\n";
+		return 1;
+	}
+	return res;
+}
+
+//With several inputs, every output written to a file needs a %
+// in its name, or the inputs would overwrite each other's output
+static bool distinctOutputs(const char * path){
+	return path == nullptr || strcmp(path, "--") == 0
+		|| strchr(path, '%') != nullptr;
+}
+
+int main( const int argc, const char **argv )
+{
+	if (argc <= 1){ usageAndDie(); }
+	std::ifstream * input = new std::ifstream(argv[1]);
+	if (input == nullptr){ usageAndDie(); }
+	if (!input->good()){
+		std::cerr << "Bad path " << argv[1] << std::endl;
+		usageAndDie();
+	}
+
+	std::vector<const char *> inFiles;
+	Outputs req;
+	unsigned int jobs = std::thread::hardware_concurrency();
+	const char * tracePath = nullptr;
 
 	bool useful = false;
 	int i = 1;
 	for (int i = 1 ; i < argc ; i++){
 		if (argv[i][0] == '-'){
-			if (argv[i][1] == 't'){
+			if (strcmp(argv[i], "--time-report") == 0
+			  || strcmp(argv[i], "--time-report=json") == 0){
+#ifdef CSHANTY_NO_TIME_REPORT
+				std::cerr << "This cshantyc was built without "
+					<< "time reports\n";
+				usageAndDie();
+#endif
+				req.timeReport = true;
+				if (argv[i][13] == '='){ req.timeFormat = TimeReport::JSON; }
+			} else if (strncmp(argv[i], "--trace=", 8) == 0){
+#ifdef CSHANTY_NO_TRACE
+				std::cerr << "This cshantyc was built without tracing\n";
+				usageAndDie();
+#endif
+				if (argv[i][8] == '\0'){ usageAndDie(); }
+				tracePath = argv[i] + 8;
+			} else if (strcmp(argv[i], "--opt-report") == 0){
+				req.optReport = true;
+			} else if (strncmp(argv[i], "--inline-threshold=", 19) == 0){
+				const char * quads = argv[i] + 19;
+				if (*quads == '\0'
+				  || strspn(quads, "0123456789") != strlen(quads)){
+					usageAndDie();
+				}
+				req.inlineThreshold = static_cast<size_t>(atoi(quads));
+			} else if (argv[i][1] == 't'){
 				i++;
-				tokensFile = argv[i];
+				req.tokensFile = argv[i];
 				useful = true;
 			} else if (argv[i][1] == 'p'){
-				checkParse = true;
+				req.checkParse = true;
 				useful = true;
 			} else if (argv[i][1] == 'u'){
 				i++;
 				if (i >= argc){ usageAndDie(); }
-				unparseFile = argv[i];
+				req.unparseFile = argv[i];
 				useful = true;
 			} else if (argv[i][1] == 'n'){
 				i++;
-				namesFile = argv[i];
+				req.namesFile = argv[i];
 				useful = true;
 			} else if (argv[i][1] == 'c'){
-				checkTypes = true;
+				req.checkTypes = true;
 				useful = true;
 			} else if (argv[i][1] == 'a'){
 				i++;
 				if (i >= argc){ usageAndDie(); }
-				threeACFile = argv[i];
+				req.threeACFile = argv[i];
 				useful = true;
 			} else if (argv[i][1] == 'o') {
 				i++;
 				if (i >= argc){ usageAndDie(); }
-				asmFile = argv[i];
+				req.asmFile = argv[i];
 				useful = true;
+			} else if (argv[i][1] == 'O') {
+				req.optimize = true;
+			} else if (argv[i][1] == 'v') {
+				req.verbose = true;
 			} else if (argv[i][1] == 'l') {
 				i++;
 				if (i >= argc){ usageAndDie(); }
-				llvmFile = argv[i];
+				req.llvmFile = argv[i];
 				useful = true;
+			} else if (argv[i][1] == 'k') {
+				i++;
+				if (i >= argc){ usageAndDie(); }
+				req.cacheDir = argv[i];
+			} else if (argv[i][1] == 'j') {
+				i++;
+				if (i >= argc){ usageAndDie(); }
+				int count = atoi(argv[i]);
+				if (count < 1){ usageAndDie(); }
+				jobs = static_cast<unsigned int>(count);
+			} else if (argv[i][1] == 'J') {
+				i++;
+				if (i >= argc){ usageAndDie(); }
+				int count = atoi(argv[i]);
+				if (count < 1){ usageAndDie(); }
+				req.checkJobs = static_cast<unsigned int>(count);
+			} else if (argv[i][1] == 'e') {
+				i++;
+				if (i >= argc){ usageAndDie(); }
+				int count = atoi(argv[i]);
+				if (count < 1){ usageAndDie(); }
+				req.errorLimit = static_cast<size_t>(count);
 			} else {
 				std::cerr << "Unrecognized argument: ";
 				std::cerr << argv[i] << std::endl;
 				usageAndDie();
 			}
 		} else {
-			if (inFile == NULL){
-				inFile = argv[i];
-			} else {
-				std::cerr << "Only 1 input file allowed";
-				std::cerr << argv[i] << std::endl;
-				usageAndDie();
-			}
+			inFiles.push_back(argv[i]);
 		}
 	}
-	if (inFile == NULL){
+	if (inFiles.empty()){
 		usageAndDie();
 	}
 	if (!useful){
 		std::cerr << "Hey, you didn't tell cshantyc to do anything!\n";
 		usageAndDie();
 	}
-
-	try {
-		if (tokensFile != nullptr){
-			writeTokenStream(inFile, tokensFile);
-		}
-		if (checkParse){
-			if (!parse(inFile)){
-				std::cerr << "Parse failed" << std::endl;
-			}
-		}
-		if (unparseFile != nullptr){
-			doUnparsing(inFile, unparseFile);
-		}
-		if (namesFile){
-			cshanty::NameAnalysis * na;
-			na = doNameAnalysis(inFile);
-			if (na == nullptr){
-				std::cerr << "Name Analysis Failed\n";
-				return 1;
-			}
-			outputAST(na->ast, namesFile);
-		}
-		if (checkTypes){
-			cshanty::TypeAnalysis * ta;
-			ta = doTypeAnalysis(inFile);
-			if (ta == nullptr){
-				std::cerr << "Type Analysis Failed\n";
-				return 1;
-			}
-		}
-		if (threeACFile != nullptr){
-			auto prog = do3AC(inFile);
-			if (prog == nullptr){ return 1; }
-			write3AC(prog, threeACFile);
+	if (req.optReport && !req.optimize){
+		std::cerr << "--opt-report needs -O\n";
+		usageAndDie();
+	}
+	if (tracePath != nullptr){
+		try {
+			Trace::start(tracePath);
+		} catch (cshanty::InternalError * e){
+			std::cerr << "InternalError: " << e->msg() << "\n";
+			return 1;
 		}
-		if (asmFile != nullptr){
-			auto prog = do3AC(inFile);
-			if (prog == nullptr){ return 1; }
-			writeX64(prog, asmFile);
+	}
+	if (inFiles.size() == 1){
+		int res = compile(inFiles[0], req);
+		return finishTrace(res);
+	}
+
+	for (const char * path : {req.tokensFile, req.unparseFile,
+	  req.namesFile, req.threeACFile, req.asmFile, req.llvmFile}){
+		if (!distinctOutputs(path)){
+			std::cerr << "Output " << path << " needs a % when "
+				<< "compiling several inputs\n";
+			usageAndDie();
 		}
-		if (llvmFile != nullptr) {
-			std::string cfile = doTranspiling(inFile, llvmFile);
-			execl("/usr/bin/clang-9","/usr/bin/clang-9",cfile.c_str(),"-S","-emit-llvm","-o",llvmFile, (char*)NULL);
+	}
+
+	//Compile the inputs on a pool of worker threads, each taking
+	// the next unclaimed input until none are left. Each input's
+	// console output is buffered, then printed in input order.
+	size_t count = inFiles.size();
+	std::vector<std::ostringstream> outBufs(count);
+	std::vector<std::ostringstream> errBufs(count);
+	std::vector<int> results(count, 0);
+	std::atomic<size_t> next(0);
+	auto worker = [&](){
+		for (size_t idx = next++; idx < count; idx = next++){
+			Console::redirect(&outBufs[idx], &errBufs[idx]);
+			results[idx] = compile(inFiles[idx], req);
 		}
-	} catch (cshanty::ToDoError * e){
-		std::cerr << "ToDoError: " << e->msg() << "\n";
-		return 1;
-	} catch (cshanty::InternalError& e){
-		std::cerr << "InternalError: " << e.msg() << "\n";
-		return 1;
-	} catch (cshanty::InternalError* e) {
-		std::cerr << "InternalError: " << e->msg() << "\n";
-		return 1;
+	};
+	if (jobs == 0){ jobs = 1; }
+	if (jobs > count){ jobs = static_cast<unsigned int>(count); }
+	std::vector<std::thread> pool;
+	for (unsigned int t = 0; t < jobs; t++){
+		pool.emplace_back(worker);
+	}
+	for (std::thread& thread : pool){
+		thread.join();
 	}
 
-	return 0;
+	int res = 0;
+	for (size_t idx = 0; idx < count; idx++){
+		std::cout << outBufs[idx].str() << std::flush;
+		std::cerr << errBufs[idx].str() << std::flush;
+		if (results[idx] != 0){ res = 1; }
+	}
+	return finishTrace(res);
 }
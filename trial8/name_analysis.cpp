@@ -10,7 +10,7 @@ bool ProgramNode::nameAnalysis(SymbolTable * symTab){
 	//Enter the global scope
 	symTab->enterScope();
 	bool res = true;
-	for (auto decl : *myGlobals){
+	for (auto decl : myGlobals){
 		res = decl->nameAnalysis(symTab) && res;
 	}
 	//Leave the global scope
@@ -42,7 +42,7 @@ bool IfStmtNode::nameAnalysis(SymbolTable * symTab){
 	bool result = true;
 	result = myCond->nameAnalysis(symTab) && result;
 	symTab->enterScope();
-	for (auto stmt : *myBody){
+	for (auto stmt : myBody){
 		result = stmt->nameAnalysis(symTab) && result;
 	}	
 	symTab->leaveScope();
@@ -53,12 +53,12 @@ bool IfElseStmtNode::nameAnalysis(SymbolTable * symTab){
 	bool result = true;
 	result = myCond->nameAnalysis(symTab) && result;
 	symTab->enterScope();
-	for (auto stmt : *myBodyTrue){
+	for (auto stmt : myBodyTrue){
 		result = stmt->nameAnalysis(symTab) && result;
 	}	
 	symTab->leaveScope();
 	symTab->enterScope();
-	for (auto stmt : *myBodyFalse){
+	for (auto stmt : myBodyFalse){
 		result = stmt->nameAnalysis(symTab) && result;
 	}	
 	symTab->leaveScope();
@@ -69,7 +69,7 @@ bool WhileStmtNode::nameAnalysis(SymbolTable * symTab){
 	bool result = true;
 	result = myCond->nameAnalysis(symTab) && result;
 	symTab->enterScope();
-	for (auto stmt : *myBody){
+	for (auto stmt : myBody){
 		result = stmt->nameAnalysis(symTab) && result;
 	}	
 	symTab->leaveScope();
@@ -77,8 +77,10 @@ bool WhileStmtNode::nameAnalysis(SymbolTable * symTab){
 }
 
 bool VarDeclNode::nameAnalysis(SymbolTable * symTab){
-	bool checkType = myType->nameAnalysis(symTab);
+	return declare(symTab, myType->nameAnalysis(symTab));
+}
 
+bool VarDeclNode::declare(SymbolTable * symTab, bool checkType){
 	const DataType * dataType = getTypeNode()->getType();
 	std::string varName = ID()->getName();
 
@@ -113,10 +115,10 @@ bool RecordTypeDeclNode::nameAnalysis(SymbolTable * symTab){
 		return false;
 	}
 
-	auto fields = new HashMap<std::string, const DataType *>();
+	std::vector<RecordField> fields;
 	SymbolTable t;
 	t.enterScope();
-	for(auto elt : *myFields){
+	for(auto elt : myFields){
 		std::string fieldName = elt->ID()->getName();
 		SemSymbol * sym = t.find(fieldName);
 		if (sym != nullptr){
@@ -130,7 +132,7 @@ bool RecordTypeDeclNode::nameAnalysis(SymbolTable * symTab){
 			NameErr::badVarType(elt->pos()); 
 			return false;
 		}
-		(*fields)[fieldName] = sym->getDataType();
+		fields.push_back({fieldName, sym->getDataType(), 0, 0});
 		t.addVar(fieldName, sym->getDataType());
 	}
 	t.leaveScope();
@@ -145,45 +147,47 @@ bool FnDeclNode::nameAnalysis(SymbolTable * symTab){
 
 	bool validRet = myRetType->nameAnalysis(symTab);
 
-	// hold onto the scope of the function.
-	ScopeTable * atFnScope = symTab->getCurrentScope();
-	//Enter a new scope for "within" this function.
-	ScopeTable * inFnScope = symTab->enterScope();
-
 	/*Note that we check for a clash of the function 
 	  name in it's declared scope (e.g. a global
 	  scope for a global function)
 	*/
 	bool validName = true;
-	if (atFnScope->clash(fnName)){
+	if (symTab->clash(fnName)){
 		NameErr::multiDecl(ID()->pos()); 
 		validName = false;
 	}
 
-	bool validFormals = true;
-	std::list<const DataType *> * formalTypes = 
-		new std::list<const DataType *>();
-	for (auto formal : *(this->myFormals)){
-		validFormals = formal->nameAnalysis(symTab) && validFormals;
+	//The formal types are part of the function's (interned)
+	// type, so they are resolved before it is declared
+	std::list<const DataType *> formalTypes;
+	std::vector<bool> formalTypesOK;
+	for (auto formal : myFormals){
 		TypeNode * typeNode = formal->getTypeNode();
-		const DataType * formalType = typeNode->getType();
-		formalTypes->push_back(formalType);
+		formalTypesOK.push_back(typeNode->nameAnalysis(symTab));
+		formalTypes.push_back(typeNode->getType());
 	}
 
-
-	const DataType * retType = this->getRetTypeNode()->getType();
-	FnType * dataType = new FnType(formalTypes, retType);
 	//Make sure the fnSymbol is in the symbol table before 
 	// analyzing the body, to allow for recursive calls
 	if (validName){
-		atFnScope->addFn(fnName, dataType);
-		SemSymbol * sym = atFnScope->lookup(fnName);
+		const DataType * retType = this->getRetTypeNode()->getType();
+		symTab->addFn(fnName, FnType::produce(formalTypes, retType));
+		SemSymbol * sym = symTab->find(fnName);
 		this->myID->attachSymbol(sym);
-		
+	}
+
+	//Enter a new scope for "within" this function.
+	symTab->enterScope();
+
+	bool validFormals = true;
+	size_t formalIdx = 0;
+	for (auto formal : myFormals){
+		bool typeOK = formalTypesOK[formalIdx++];
+		validFormals = formal->declare(symTab, typeOK) && validFormals;
 	}
 
 	bool validBody = true;
-	for (auto stmt : *myBody){
+	for (auto stmt : myBody){
 		validBody = stmt->nameAnalysis(symTab) && validBody;
 	}
 
@@ -206,7 +210,7 @@ bool BinaryExpNode::nameAnalysis(SymbolTable * symTab){
 bool CallExpNode::nameAnalysis(SymbolTable* symTab){
 	bool result = true;
 	result = myID->nameAnalysis(symTab) && result;
-	for (auto arg : *myArgs){
+	for (auto arg : myArgs){
 		result = arg->nameAnalysis(symTab) && result;
 	}
 	return result;
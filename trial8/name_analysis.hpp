@@ -18,6 +18,13 @@ public:
 		nameAnalysis->ast = astIn;
 		return nameAnalysis;
 	}
+	//Wrap an AST whose symbols were attached by an earlier
+	// run (i.e. one loaded from the AST cache)
+	static NameAnalysis * resolved(ProgramNode * astIn){
+		NameAnalysis * nameAnalysis = new NameAnalysis;
+		nameAnalysis->ast = astIn;
+		return nameAnalysis;
+	}
 	ProgramNode * ast;
 
 private:
@@ -0,0 +1,173 @@
+#ifndef CSHANTY_OPT_HPP
+#define CSHANTY_OPT_HPP
+
+#include <cstdint>
+#include <deque>
+#include <ostream>
+#include "3ac.hpp"
+
+namespace cshanty{
+
+class CFG;
+
+//What -O did to each procedure of one input, for --opt-report
+class OptReport{
+public:
+	struct ProcStats{
+		std::string name;
+		size_t quadsBefore = 0;
+		size_t quadsAfter = 0;
+		//Stack frame bytes, as Procedure::arSize() gives them
+		size_t frameBefore = 0;
+		size_t frameAfter = 0;
+		//Calls inlined into the procedure
+		size_t inlinedCalls = 0;
+		//Quads strength reduction rewrote, value numbering
+		// removed, LICM moved out of loops and dead code
+		// elimination removed
+		size_t reducedQuads = 0;
+		size_t redundantQuads = 0;
+		size_t hoistedQuads = 0;
+		size_t deadQuads = 0;
+	};
+	ProcStats& add(const std::string& name);
+	void print(std::ostream& out, const char * input) const;
+private:
+	//A deque, so that what add() returns stays where it is
+	std::deque<ProcStats> procs;
+};
+
+//Which procedures of a program call which
+class CallGraph{
+public:
+	CallGraph(IRProgram * prog);
+	//The procedure a call goes to
+	Procedure * callee(CallQuad * call) const;
+	//Every procedure, each after all those it calls, but for
+	// those it can be called back from
+	const std::vector<Procedure *>& bottomUp() const{ return order; }
+	//Whether the callee can (maybe through others) call the
+	// caller, or is the caller
+	bool recursive(Procedure * caller, Procedure * callee) const;
+private:
+	HashMap<std::string, Procedure *> byName;
+	HashMap<Procedure *, std::vector<Procedure *>> calls;
+	//Each procedure's strongly connected component, by the number
+	// of its first member found
+	HashMap<Procedure *, size_t> cycle;
+	std::vector<Procedure *> order;
+};
+
+//Inlining of calls, run on 3AC before a procedure goes into a CFG.
+// A call to a procedure whose body has at most threshold quads
+// (plus two for each argument, whose passing the call no longer
+// needs) is replaced by a copy of that body: the callee's formals,
+// locals and temps become temps of the caller, its labels new
+// labels, a return a jump past the copy (the callee's own tail
+// calls stay tail calls only if the call inlined was one). A
+// record argument the callee never writes to is not copied at
+// all. Calls within a cycle of calls are never inlined, and a
+// threshold of 0 inlines nothing. Callees should already be
+// optimized, as when the procedures are taken in
+// CallGraph::bottomUp() order. Returns how many calls were
+// inlined.
+class Inliner{
+public:
+	static size_t run(Procedure * proc, const CallGraph& graph,
+		size_t threshold);
+};
+
+//What -O does to a program's 3AC before code generation. Each
+// procedure has the calls it makes inlined, then its body is
+// turned into a CFG, run through the passes and written back, so
+// the x64 backend sees ordinary quads. Procedures are done callees
+// first, so that what is inlined is already optimized.
+class Optimizer{
+public:
+	static const size_t DEFAULT_INLINE_THRESHOLD = 20;
+	//Optimize every procedure, noting what changed in report
+	// if one is given. See Inliner for inlineThreshold.
+	static void optimize(IRProgram * prog, OptReport * report = nullptr,
+		size_t inlineThreshold = DEFAULT_INLINE_THRESHOLD);
+private:
+	static void optimizeProc(Procedure * proc, const CallGraph& graph,
+		size_t inlineThreshold, OptReport::ProcStats * stats);
+};
+
+//Sparse conditional constant propagation (Wegman and Zadeck) over
+// a CFG in SSA form. Operands found to always hold one constant
+// are replaced by it and their definitions dropped, IFZs on a
+// constant condition become unconditional, and blocks that can
+// then never run are removed. Returns whether anything changed.
+class SCCP{
+public:
+	static bool run(CFG * cfg);
+};
+
+//Value numbering over a CFG in SSA form, scoped by the dominator
+// tree: a BinOp, UnaryOp or IndexQuad computing what a quad in a
+// dominating block already did is dropped, and its uses read the
+// earlier result. Copies of plain values are propagated, and phis
+// whose sources agree give way to that source. Operands not kept
+// as plain values (globals, address-taken locals, memory behind
+// an AddrOpd) are only taken to be unchanged between a read and
+// the next call, store or receive in the same block. Returns how
+// many quads were removed.
+class GVN{
+public:
+	static size_t run(CFG * cfg);
+};
+
+//Loop-invariant code motion over a CFG in SSA form. Every loop
+// gets a preheader, and a BinOp, UnaryOp or IndexQuad in a loop
+// whose operands are all set outside it (or by quads already
+// hoisted) moves to the preheader, innermost loops first. Only
+// plain values count as unchanged: anything read from memory
+// stays. A quad may be hoisted out of a path that would not have
+// run it, so a division only moves if cannotTrap() says so.
+// Returns how many quads moved.
+class LICM{
+public:
+	static size_t run(CFG * cfg);
+};
+
+//The value of a literal operand: integers and bools have one,
+// string literals (which name their label) do not
+bool literalValue(Opd * opd, int64_t& val);
+
+//Whether running the quad can never crash the program: true of
+// all but a division whose divisor may be 0 or -1
+bool cannotTrap(Quad * quad);
+
+//Strength reduction over a CFG in SSA form, in two passes.
+// simplify() applies algebraic identities (x + 0, x * 1, x * 0,
+// x - x, !!b and the like), turns multiplication and division by
+// a power of two into shifts (division with the fix-up that makes
+// it round toward zero, as idivq does), and moves the literal in a
+// multiplication to the right, where the backend can use an lea.
+// reduceInductions() replaces i * c inside a loop, where i is an
+// induction variable stepping by a literal and c does not change
+// in the loop, with a new variable stepped by the product; it
+// needs the preheaders LICM makes. Each returns how many quads it
+// rewrote.
+class StrengthReduction{
+public:
+	static size_t simplify(CFG * cfg);
+	static size_t reduceInductions(CFG * cfg);
+};
+
+//Dead code elimination over a CFG in SSA form. Every quad with an
+// effect (a call, I/O, a store to memory, a branch, a write to a
+// global or to a local whose address is taken) is kept, along
+// with whatever computes the operands they read; every other quad
+// goes. That covers unused temps and stores to locals that are
+// overwritten or left unread, even around loops. Returns how many
+// quads were removed.
+class DCE{
+public:
+	static size_t run(CFG * cfg);
+};
+
+}
+
+#endif
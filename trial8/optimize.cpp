@@ -0,0 +1,147 @@
+#include "opt.hpp"
+#include "cfg.hpp"
+#include "ssa.hpp"
+#include <cstdio>
+#include "time_report.hpp"
+
+namespace cshanty{
+
+OptReport::ProcStats& OptReport::add(const std::string& name){
+	procs.push_back(ProcStats());
+	procs.back().name = name;
+	return procs.back();
+}
+
+//before -> after, and the change between them
+static std::string change(size_t before, size_t after){
+	char buf[64];
+	long diff = static_cast<long>(after) - static_cast<long>(before);
+	snprintf(buf, sizeof(buf), "%zu -> %zu (%+ld)", before, after, diff);
+	return buf;
+}
+
+void OptReport::print(std::ostream& out, const char * input) const{
+	char line[200];
+	std::string text = "Optimization report for ";
+	text += input;
+	snprintf(line, sizeof(line), "\n %-20s %-24s %-24s %6s %6s %6s %6s %6s\n",
+		"procedure", "quads", "frame bytes", "inline", "reduce", "cse",
+		"hoist", "dead");
+	text += line;
+	OptReport::ProcStats total;
+	for (const ProcStats& proc : procs){
+		snprintf(line, sizeof(line),
+			" %-20s %-24s %-24s %6zu %6zu %6zu %6zu %6zu\n",
+			proc.name.c_str(),
+			change(proc.quadsBefore, proc.quadsAfter).c_str(),
+			change(proc.frameBefore, proc.frameAfter).c_str(),
+			proc.inlinedCalls, proc.reducedQuads, proc.redundantQuads, proc.hoistedQuads,
+			proc.deadQuads);
+		text += line;
+		total.quadsBefore += proc.quadsBefore;
+		total.quadsAfter += proc.quadsAfter;
+		total.frameBefore += proc.frameBefore;
+		total.frameAfter += proc.frameAfter;
+		total.inlinedCalls += proc.inlinedCalls;
+		total.reducedQuads += proc.reducedQuads;
+		total.redundantQuads += proc.redundantQuads;
+		total.hoistedQuads += proc.hoistedQuads;
+		total.deadQuads += proc.deadQuads;
+	}
+	snprintf(line, sizeof(line), " %-20s %-24s %-24s %6zu %6zu %6zu %6zu %6zu\n",
+		"total", change(total.quadsBefore, total.quadsAfter).c_str(),
+		change(total.frameBefore, total.frameAfter).c_str(),
+		total.inlinedCalls, total.reducedQuads, total.redundantQuads, total.hoistedQuads,
+		total.deadQuads);
+	text += line;
+	out << text << std::flush;
+}
+
+void Optimizer::optimize(IRProgram * prog, OptReport * report,
+  size_t inlineThreshold){
+	//Reported in program order, whatever order they are done in
+	HashMap<Procedure *, OptReport::ProcStats *> stats;
+	for (Procedure * proc : *prog->getProcs()){
+		stats[proc] = report == nullptr ? nullptr : &report->add(proc->getName());
+	}
+	CallGraph * graph;
+	{
+		TIME_PHASE("Call graph");
+		graph = new CallGraph(prog);
+	}
+	for (Procedure * proc : graph->bottomUp()){
+		optimizeProc(proc, *graph, inlineThreshold, stats[proc]);
+	}
+	delete graph;
+}
+
+void Optimizer::optimizeProc(Procedure * proc, const CallGraph& graph,
+  size_t inlineThreshold, OptReport::ProcStats * stats){
+	TRACE_SPAN("Optimizer::optimizeProc", proc->getName());
+	OptReport::ProcStats unused;
+	if (stats == nullptr){ stats = &unused; }
+	stats->quadsBefore = proc->getQuads()->size();
+	stats->frameBefore = proc->arSize();
+
+	{
+		TIME_PHASE("Inlining");
+		stats->inlinedCalls = Inliner::run(proc, graph, inlineThreshold);
+	}
+	CFG * cfg;
+	{
+		TIME_PHASE("CFG construction");
+		cfg = CFG::build(proc);
+	}
+	{
+		TIME_PHASE("CFG simplification");
+		cfg->simplify();
+		cfg->analyze();
+	}
+	SSA ssa(cfg);
+	{
+		TIME_PHASE("SSA construction");
+		ssa.build();
+	}
+	{
+		TIME_PHASE("Constant propagation");
+		if (SCCP::run(cfg)){ cfg->analyze(); }
+	}
+	{
+		TIME_PHASE("Strength reduction");
+		stats->reducedQuads = StrengthReduction::simplify(cfg);
+	}
+	{
+		TIME_PHASE("Value numbering");
+		stats->redundantQuads = GVN::run(cfg);
+	}
+	{
+		TIME_PHASE("Loop-invariant code motion");
+		stats->hoistedQuads = LICM::run(cfg);
+	}
+	{
+		TIME_PHASE("Strength reduction");
+		stats->reducedQuads += StrengthReduction::reduceInductions(cfg);
+	}
+	{
+		TIME_PHASE("Dead code elimination");
+		stats->deadQuads = DCE::run(cfg);
+	}
+	{
+		TIME_PHASE("SSA destruction");
+		ssa.destroy();
+	}
+	{
+		TIME_PHASE("CFG simplification");
+		cfg->simplify();
+	}
+	{
+		TIME_PHASE("CFG write-back");
+		cfg->writeBack();
+		proc->dropUnusedOpds();
+	}
+	delete cfg;
+	stats->quadsAfter = proc->getQuads()->size();
+	stats->frameAfter = proc->arSize();
+}
+
+}
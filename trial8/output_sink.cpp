@@ -0,0 +1,53 @@
+#include "output_sink.hpp"
+
+namespace cshanty{
+
+//Every two-digit number, so digits come out a pair at a time
+static const char digitPairs[] =
+	"0001020304050607080910111213141516171819"
+	"2021222324252627282930313233343536373839"
+	"4041424344454647484950515253545556575859"
+	"6061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+void OutputSink::drain(){
+	if (len == 0){ return; }
+	stream.write(buf.data(), static_cast<std::streamsize>(len));
+	len = 0;
+}
+
+void OutputSink::flush(){
+	drain();
+	stream.flush();
+}
+
+OutputSink& OutputSink::writeUnsigned(unsigned long long val){
+	//Fill a scratch area from the right, then copy it out
+	char digits[20];
+	size_t pos = sizeof(digits);
+	while (val >= 100){
+		size_t pair = static_cast<size_t>(val % 100) * 2;
+		val /= 100;
+		digits[--pos] = digitPairs[pair + 1];
+		digits[--pos] = digitPairs[pair];
+	}
+	if (val >= 10){
+		size_t pair = static_cast<size_t>(val) * 2;
+		digits[--pos] = digitPairs[pair + 1];
+		digits[--pos] = digitPairs[pair];
+	} else {
+		digits[--pos] = static_cast<char>('0' + val);
+	}
+	return write(digits + pos, sizeof(digits) - pos);
+}
+
+OutputSink& OutputSink::writeSigned(long long val){
+	if (val >= 0){
+		return writeUnsigned(static_cast<unsigned long long>(val));
+	}
+	*this << '-';
+	//Negate in unsigned arithmetic, which is defined for LLONG_MIN
+	return writeUnsigned(0ULL - static_cast<unsigned long long>(val));
+}
+
+}
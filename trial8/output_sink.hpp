@@ -0,0 +1,73 @@
+#ifndef CSHANTY_OUTPUT_SINK_HPP
+#define CSHANTY_OUTPUT_SINK_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace cshanty{
+
+//The writer behind every textual output of the compiler (unparsed
+// source, transpiled C, 3AC and x64). Text collects in one large
+// buffer, which is reused after each flush, and reaches the stream
+// in a few big writes rather than one call per token. Integers are
+// formatted straight into the buffer, with no temporary string.
+class OutputSink{
+public:
+	explicit OutputSink(std::ostream& streamIn, size_t capacity = 256 * 1024)
+	: stream(streamIn), buf(capacity), len(0){ }
+	OutputSink(const OutputSink&) = delete;
+	OutputSink& operator=(const OutputSink&) = delete;
+	~OutputSink(){ flush(); }
+
+	OutputSink& write(const char * text, size_t size){
+		if (size > buf.size() - len){
+			drain();
+			//Too big to be worth copying; pass it straight on
+			if (size > buf.size()){
+				stream.write(text, static_cast<std::streamsize>(size));
+				return *this;
+			}
+		}
+		memcpy(buf.data() + len, text, size);
+		len += size;
+		return *this;
+	}
+
+	OutputSink& operator<<(char c){
+		if (len == buf.size()){ drain(); }
+		buf[len++] = c;
+		return *this;
+	}
+	OutputSink& operator<<(const char * text){
+		return write(text, strlen(text));
+	}
+	OutputSink& operator<<(const std::string& text){
+		return write(text.data(), text.size());
+	}
+	OutputSink& operator<<(int val){ return writeSigned(val); }
+	OutputSink& operator<<(long val){ return writeSigned(val); }
+	OutputSink& operator<<(long long val){ return writeSigned(val); }
+	OutputSink& operator<<(unsigned val){ return writeUnsigned(val); }
+	OutputSink& operator<<(unsigned long val){ return writeUnsigned(val); }
+	OutputSink& operator<<(unsigned long long val){
+		return writeUnsigned(val);
+	}
+
+	//Hand everything buffered so far to the stream
+	void flush();
+private:
+	void drain();
+	OutputSink& writeSigned(long long val);
+	OutputSink& writeUnsigned(unsigned long long val);
+
+	std::ostream& stream;
+	std::vector<char> buf;
+	size_t len;
+};
+
+}
+
+#endif
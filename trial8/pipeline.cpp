@@ -0,0 +1,209 @@
+#include <sstream>
+#include <cstring>
+#include "pipeline.hpp"
+#include "scanner.hpp"
+#include "name_analysis.hpp"
+#include "type_analysis.hpp"
+#include "ast_cache.hpp"
+#include "opt.hpp"
+#include "time_report.hpp"
+
+namespace cshanty{
+
+//Lasts for one phase: what the phase reports is collected in the
+// pipeline's buffer, then written out as the phase ends (however
+// it ends). Phases that run others report theirs first.
+class PhaseReport{
+public:
+	PhaseReport(Diagnostics * diagsIn) : diags(diagsIn), use(diagsIn){ }
+	~PhaseReport(){ diags->flush(Console::err()); }
+private:
+	Diagnostics * diags;
+	Diagnostics::Use use;
+};
+
+Pipeline::Pipeline(const char * inPathIn)
+: inPath(inPathIn),
+  inlineThreshold(Optimizer::DEFAULT_INLINE_THRESHOLD),
+  universe(new TypeUniverse()){
+	//Read the input once; every phase that needs the
+	// text lexes it from memory
+	std::ifstream inStream(inPath);
+	if (!inStream.good()){
+		std::string msg = "Bad input stream ";
+		msg += inPath;
+		throw new InternalError(msg.c_str());
+	}
+	std::stringstream contents;
+	contents << inStream.rdbuf();
+	source = contents.str();
+}
+
+Pipeline::~Pipeline(){
+	delete tokenFile;
+	delete cache;
+	delete myArena;
+	delete universe;
+}
+
+void Pipeline::setTokenOutput(const char * outPath){
+	if (outPath == nullptr){
+		std::string msg = "No tokens output file given";
+		throw new InternalError(msg.c_str());
+	}
+	if (strcmp(outPath, "--") == 0){
+		tokenOut = &Console::out();
+		return;
+	}
+	tokenFile = new std::ofstream(outPath);
+	if (!tokenFile->good()){
+		std::string msg = "Bad output file ";
+		msg += outPath;
+		throw new InternalError(msg.c_str());
+	}
+	tokenOut = tokenFile;
+}
+
+void Pipeline::setCacheDir(const char * dir){
+	if (dir == nullptr){
+		std::string msg = "No AST cache directory given";
+		throw new InternalError(msg.c_str());
+	}
+	cache = new ASTCache(dir, source);
+}
+
+bool Pipeline::loadCached(){
+	//A token dump needs a real scan, and an unparse the bare
+	// parse tree, so both bypass the cache
+	if (cache == nullptr || tokenOut != nullptr || unparse){
+		return false;
+	}
+	TIME_PHASE("cache load");
+	myArena = new Arena();
+	TypeAnalysis * types = cache->load(myArena);
+	if (types == nullptr){
+		delete myArena;
+		myArena = nullptr;
+		return false;
+	}
+	myAST = types->ast;
+	myNames = NameAnalysis::resolved(myAST);
+	myTypes = types;
+	parseState = nameState = typeState = DONE;
+	return true;
+}
+
+void Pipeline::finishTokens(){
+	tokensDone = true;
+	if (tokenFile != nullptr){ tokenFile->close(); }
+}
+
+void Pipeline::scan(){
+	if (tokenOut == nullptr || tokensDone){ return; }
+	TIME_PHASE("scan");
+	std::istringstream inStream(source);
+	Scanner scanner(&inStream);
+	scanner.outputTokens(*tokenOut);
+	finishTokens();
+}
+
+ProgramNode * Pipeline::parse(){
+	TypeUniverse::Use inUniverse(universe);
+	PhaseReport report(&diags);
+	if (parseState != NOT_RUN){ return myAST; }
+	if (loadCached()){ return myAST; }
+	//Includes scanning, which runs on the parser's demand
+	TIME_PHASE("parse");
+	parseState = FAILED;
+
+	std::istringstream inStream(source);
+	Scanner scanner(&inStream);
+	if (tokenOut != nullptr && !tokensDone){
+		scanner.setTokenLog(tokenOut);
+	}
+
+	//This pointer will be set to the root of the
+	// AST after parsing
+	ProgramNode * root = nullptr;
+	myArena = new Arena();
+	Parser parser(scanner, &root, myArena);
+	int errCode = 1;
+	try {
+		errCode = parser.parse();
+	} catch (ErrorLimit *){
+		//Stop parsing, but still finish the token dump
+	}
+
+	if (tokenOut != nullptr && !tokensDone){
+		scanner.finishTokenLog();
+		finishTokens();
+	}
+
+	if (errCode != 0){ return nullptr; }
+	myAST = root;
+	parseState = DONE;
+	return myAST;
+}
+
+NameAnalysis * Pipeline::nameAnalysis(){
+	TypeUniverse::Use inUniverse(universe);
+	//Parse first: a cache hit there fills in the analyses too
+	ProgramNode * ast = parse();
+	PhaseReport report(&diags);
+	if (nameState != NOT_RUN){ return myNames; }
+	nameState = FAILED;
+	if (ast == nullptr){ return nullptr; }
+	TIME_PHASE("name analysis");
+	try {
+		myNames = NameAnalysis::build(ast);
+	} catch (ErrorLimit *){
+		return nullptr;
+	}
+	if (myNames == nullptr){ return nullptr; }
+	nameState = DONE;
+	return myNames;
+}
+
+TypeAnalysis * Pipeline::typeAnalysis(){
+	TypeUniverse::Use inUniverse(universe);
+	NameAnalysis * names = nameAnalysis();
+	PhaseReport report(&diags);
+	if (typeState != NOT_RUN){ return myTypes; }
+	typeState = FAILED;
+	if (names == nullptr){ return nullptr; }
+	try {
+		TIME_PHASE("type analysis");
+		myTypes = TypeAnalysis::build(names, myArena->nodeCount(),
+			checkJobs);
+	} catch (ErrorLimit *){
+		return nullptr;
+	}
+	if (myTypes == nullptr){ return nullptr; }
+	typeState = DONE;
+	//A hit skips scanning and analysis, and so everything they
+	// reported; only an input that reported nothing is kept
+	if (cache != nullptr && diags.reportCount() == 0){
+		TIME_PHASE("cache store");
+		cache->store(myTypes);
+	}
+	return myTypes;
+}
+
+IRProgram * Pipeline::ir(){
+	TypeUniverse::Use inUniverse(universe);
+	if (irState != NOT_RUN){ return myIR; }
+	irState = FAILED;
+
+	TypeAnalysis * types = typeAnalysis();
+	if (types == nullptr){ return nullptr; }
+	{
+		TIME_PHASE("3AC generation");
+		myIR = types->ast->to3AC(types);
+	}
+	if (myIR == nullptr){ return nullptr; }
+	if (optimize){ Optimizer::optimize(myIR, optReport, inlineThreshold); }
+	irState = DONE;
+	return myIR;
+}
+
+}
@@ -0,0 +1,104 @@
+#ifndef CSHANTY_PIPELINE_HPP
+#define CSHANTY_PIPELINE_HPP
+
+#include <fstream>
+#include <string>
+#include "arena.hpp"
+#include "ast.hpp"
+#include "3ac.hpp"
+
+namespace cshanty{
+
+class NameAnalysis;
+class TypeAnalysis;
+class ASTCache;
+class OptReport;
+
+//Drives a single compilation of one input file. Pipelines for
+// different files share no state, so they may run on different
+// threads at the same time (each on one thread). Each phase is
+// run at most once, on demand, and its result is cached so that
+// every requested output (tokens, unparse, names, 3AC, x64, C)
+// is served from the same scan, AST, analyses and IR. A phase
+// that fails is remembered as failed and is not retried.
+class Pipeline{
+public:
+	Pipeline(const char * inPathIn);
+	~Pipeline();
+
+	//Echo every token to the given file ("--" for stdout). If
+	// the AST is also needed, the dump comes from the parser's
+	// own scan; otherwise scan() lexes the input by itself.
+	void setTokenOutput(const char * outPath);
+	void scan();
+
+	//Reuse (and keep) type-checked ASTs in the given directory.
+	// A cache hit serves parse(), nameAnalysis() and
+	// typeAnalysis() without running any of them.
+	void setCacheDir(const char * dir);
+	//An unparse (-u) is of the parser's own AST, so it bypasses
+	// the cache: a cached AST has its symbols already attached,
+	// and unparse would print them
+	void setUnparse(bool on){ unparse = on; }
+
+	//Type-check up to jobs function bodies at once (default 1)
+	void setCheckJobs(unsigned int jobs){ checkJobs = jobs; }
+
+	//Run the IR through the optimizer (-O) once it is generated
+	void setOptimize(bool on){ optimize = on; }
+	//Note what the optimizer does to each procedure in report
+	void setOptReport(OptReport * report){ optReport = report; }
+	//Inline calls to procedures of up to quads quads (0 for none)
+	void setInlineThreshold(size_t quads){ inlineThreshold = quads; }
+
+	//Stop the running phase once more than limit errors have
+	// been found (0, the default, for no limit)
+	void setErrorLimit(size_t limit){ diags.setLimit(limit); }
+
+	ProgramNode * parse();
+	NameAnalysis * nameAnalysis();
+	TypeAnalysis * typeAnalysis();
+	IRProgram * ir();
+private:
+	enum PhaseState { NOT_RUN, DONE, FAILED };
+
+	void finishTokens();
+	bool loadCached();
+
+	std::string inPath;
+	std::string source;
+
+	std::ostream * tokenOut = nullptr;
+	std::ofstream * tokenFile = nullptr;
+	bool tokensDone = false;
+
+	ASTCache * cache = nullptr;
+	bool unparse = false;
+	unsigned int checkJobs = 1;
+	bool optimize = false;
+	OptReport * optReport = nullptr;
+	size_t inlineThreshold;
+	//Each phase's diagnostics collect here, and are reported
+	// (sorted by position) when the phase ends
+	Diagnostics diags;
+	//Every type this compilation produces comes from here; each
+	// phase installs it on the thread that runs the phase
+	TypeUniverse * universe;
+
+	PhaseState parseState = NOT_RUN;
+	PhaseState nameState = NOT_RUN;
+	PhaseState typeState = NOT_RUN;
+	PhaseState irState = NOT_RUN;
+
+	//Owns the AST; every node is released in one step when
+	// the pipeline is destroyed
+	Arena * myArena = nullptr;
+	ProgramNode * myAST = nullptr;
+	NameAnalysis * myNames = nullptr;
+	TypeAnalysis * myTypes = nullptr;
+	IRProgram * myIR = nullptr;
+};
+
+}
+
+#endif
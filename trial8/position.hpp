@@ -5,6 +5,9 @@
 
 namespace cshanty{
 
+class ASTWriter;
+class Diagnostics;
+
 class Position{
 public: 
 	Position(size_t lineI, size_t colI, size_t lineE, size_t colE)
@@ -38,6 +41,8 @@ public:
 		return result;
 	}
 private:
+	friend class ASTWriter;
+	friend class Diagnostics;
 	size_t myLineI;
 	size_t myColI;
 	size_t myLineE;
@@ -7,19 +7,34 @@ using TokenKind = cshanty::Parser::token;
 using Lexeme = cshanty::Parser::semantic_type;
 
 void Scanner::outputTokens(std::ostream& outstream){
+	std::ostream * oldLog = tokenLog;
+	tokenLog = &outstream;
+	finishTokenLog();
+	tokenLog = oldLog;
+}
+
+int Scanner::nextToken(Lexeme * const lval){
+	int tokenKind = this->yylex(lval);
+	if (tokenKind == TokenKind::END){ sawEnd = true; }
+	if (tokenLog != nullptr){ logToken(tokenKind, lval); }
+	return tokenKind;
+}
+
+void Scanner::finishTokenLog(){
 	Lexeme lex;
-	int tokenKind;
-	while(true){
-		tokenKind = this->yylex(&lex);
-		if (tokenKind == TokenKind::END){
-			outstream << "EOF" 
-			  << " [" << this->lineNum 
-			  << "," << this->colNum << "]"
-			  << std::endl;
-			return;
-		} else {
-			outstream << lex.lexeme->toString()
-			  << std::endl;
-		}
+	while (!sawEnd){
+		nextToken(&lex);
+	}
+}
+
+void Scanner::logToken(int tokenKind, Lexeme * lval){
+	if (tokenKind == TokenKind::END){
+		*tokenLog << "EOF" 
+		  << " [" << this->lineNum 
+		  << "," << this->colNum << "]"
+		  << std::endl;
+	} else {
+		*tokenLog << lval->lexeme->toString()
+		  << std::endl;
 	}
 }
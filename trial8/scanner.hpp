@@ -29,6 +29,15 @@ public:
    // YY_DECL defined in the flex cshanty.l
    virtual int yylex( cshanty::Parser::semantic_type * const lval);
 
+   //The parser pulls tokens through this function rather than
+   // yylex directly, so that a token dump (-t) can be written
+   // from the same scan that builds the AST
+   int nextToken( cshanty::Parser::semantic_type * const lval);
+   void setTokenLog(std::ostream * logIn){ tokenLog = logIn; }
+   //Drain any tokens the parser did not consume (e.g. after a
+   // syntax error) into the token log
+   void finishTokenLog();
+
    int makeBareToken(int tagIn){
 	size_t len = static_cast<size_t>(yyleng);
 	Position * pos = new Position(
@@ -81,7 +90,11 @@ public:
    void outputTokens(std::ostream& outstream);
 
 private:
+   void logToken(int tokenKind, cshanty::Parser::semantic_type * lval);
+
    cshanty::Parser::semantic_type *yylval = nullptr;
+   std::ostream * tokenLog = nullptr;
+   bool sawEnd = false;
    size_t lineNum;
    size_t colNum;
 };
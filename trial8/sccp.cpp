@@ -0,0 +1,290 @@
+#include <cerrno>
+#include <cstdlib>
+#include "opt.hpp"
+#include "cfg.hpp"
+
+namespace cshanty{
+
+//What SCCP knows of an operand's value: nothing yet (TOP), that
+// it is always the one constant, or that it varies (BOTTOM)
+struct ConstValue{
+	enum Kind { TOP, CONST, BOTTOM };
+	Kind kind;
+	int64_t val;
+	static ConstValue top(){ return ConstValue{TOP, 0}; }
+	static ConstValue bottom(){ return ConstValue{BOTTOM, 0}; }
+	static ConstValue constant(int64_t v){ return ConstValue{CONST, v}; }
+	bool operator==(const ConstValue& other) const{
+		return kind == other.kind && (kind != CONST || val == other.val);
+	}
+	bool operator!=(const ConstValue& other) const{ return !(*this == other); }
+	ConstValue meet(const ConstValue& other) const{
+		if (kind == TOP){ return other; }
+		if (other.kind == TOP){ return *this; }
+		if (*this == other){ return *this; }
+		return bottom();
+	}
+};
+
+bool literalValue(Opd * opd, int64_t& val){
+	LitOpd * lit = dynamic_cast<LitOpd *>(opd);
+	if (lit == nullptr){ return false; }
+	std::string str = lit->valString();
+	if (str.empty()){ return false; }
+	char * end = nullptr;
+	errno = 0;
+	long long parsed = strtoll(str.c_str(), &end, 10);
+	if (errno != 0 || *end != '\0'){ return false; }
+	val = static_cast<int64_t>(parsed);
+	return true;
+}
+
+//Arithmetic wraps, as it does in the generated code
+static int64_t wrap(uint64_t val){
+	return static_cast<int64_t>(val);
+}
+
+//The result of the operation, if it can be known at compile time.
+// Division that would trap at run time is left for run time.
+static bool foldBinOp(BinOp op, int64_t l, int64_t r, int64_t& res){
+	uint64_t ul = static_cast<uint64_t>(l);
+	uint64_t ur = static_cast<uint64_t>(r);
+	switch (op){
+	case ADD64: res = wrap(ul + ur); return true;
+	case SUB64: res = wrap(ul - ur); return true;
+	case MULT64: res = wrap(ul * ur); return true;
+	case DIV64:
+		if (r == 0 || (l == INT64_MIN && r == -1)){ return false; }
+		res = l / r;
+		return true;
+	case EQ64: res = l == r; return true;
+	case NEQ64: res = l != r; return true;
+	case LT64: res = l < r; return true;
+	case GT64: res = l > r; return true;
+	case LTE64: res = l <= r; return true;
+	case GTE64: res = l >= r; return true;
+	case OR64: res = wrap(ul | ur); return true;
+	case AND64: res = wrap(ul & ur); return true;
+	//As on x64, only the low 6 bits of the count matter
+	case SHL64: res = wrap(ul << (ur & 63)); return true;
+	case SAR64: res = l >> (ur & 63); return true;
+	case SHR64: res = wrap(ul >> (ur & 63)); return true;
+	}
+	return false;
+}
+
+static int64_t foldUnaryOp(UnaryOp op, int64_t val){
+	switch (op){
+	case NEG64: return wrap(-static_cast<uint64_t>(val));
+	case NOT64: return val ^ 1;
+	}
+	return val;
+}
+
+//The state of one run of SCCP over one CFG
+class ConstPropagator{
+public:
+	ConstPropagator(CFG * cfgIn) : cfg(cfgIn), vars(cfgIn){ }
+	bool run();
+private:
+	ConstValue valueOf(Opd * opd);
+	void markEdge(BasicBlock * from, BasicBlock * to);
+	void visit(Quad * quad, BasicBlock * block);
+	void lower(size_t var, ConstValue val);
+	bool rewrite();
+
+	CFG * cfg;
+	VarIndex vars;
+	std::vector<ConstValue> values;
+	std::vector<std::vector<Quad *>> uses;
+	HashMap<Quad *, BasicBlock *> blockOf;
+	std::vector<bool> executable;
+	//Whether the edge from each of a block's predecessors (in
+	// the same order) has been found executable
+	std::vector<std::vector<bool>> liveEdges;
+	std::vector<std::pair<BasicBlock *, BasicBlock *>> edgeWork;
+	std::vector<Quad *> quadWork;
+};
+
+ConstValue ConstPropagator::valueOf(Opd * opd){
+	int64_t lit;
+	if (literalValue(opd, lit)){ return ConstValue::constant(lit); }
+	size_t var = vars.id(opd);
+	if (var == VarIndex::NONE){ return ConstValue::bottom(); }
+	return values[var];
+}
+
+void ConstPropagator::lower(size_t var, ConstValue val){
+	ConstValue lowered = values[var].meet(val);
+	if (lowered == values[var]){ return; }
+	values[var] = lowered;
+	quadWork.insert(quadWork.end(), uses[var].begin(), uses[var].end());
+}
+
+void ConstPropagator::markEdge(BasicBlock * from, BasicBlock * to){
+	edgeWork.push_back(std::make_pair(from, to));
+}
+
+void ConstPropagator::visit(Quad * quad, BasicBlock * block){
+	if (PhiQuad * phi = dynamic_cast<PhiQuad *>(quad)){
+		ConstValue res = ConstValue::top();
+		const std::vector<bool>& live = liveEdges[block->getID()];
+		for (size_t i = 0; i < phi->getSrcs().size(); i++){
+			if (live[i]){ res = res.meet(valueOf(phi->getSrcs()[i])); }
+		}
+		lower(vars.id(phi->getDst()), res);
+		return;
+	}
+	if (IfzQuad * ifz = dynamic_cast<IfzQuad *>(quad)){
+		//IFZ falls through (to succs[0]) unless its condition is 0
+		ConstValue cond = valueOf(ifz->getCnd());
+		if (cond.kind == ConstValue::TOP){ return; }
+		if (cond.kind == ConstValue::BOTTOM || cond.val != 0){
+			markEdge(block, block->succs[0]);
+		}
+		if (cond.kind == ConstValue::BOTTOM || cond.val == 0){
+			markEdge(block, block->succs[1]);
+		}
+		return;
+	}
+	Opd ** def = quad->defSlot();
+	size_t var = def == nullptr ? VarIndex::NONE : vars.id(*def);
+	if (var == VarIndex::NONE){ return; }
+
+	ConstValue res = ConstValue::bottom();
+	if (BinOpQuad * bin = dynamic_cast<BinOpQuad *>(quad)){
+		ConstValue l = valueOf(bin->getSrc1());
+		ConstValue r = valueOf(bin->getSrc2());
+		int64_t folded;
+		if (l.kind == ConstValue::BOTTOM || r.kind == ConstValue::BOTTOM){
+			res = ConstValue::bottom();
+		} else if (l.kind == ConstValue::TOP || r.kind == ConstValue::TOP){
+			res = ConstValue::top();
+		} else if (foldBinOp(bin->getOp(), l.val, r.val, folded)){
+			res = ConstValue::constant(folded);
+		}
+	} else if (UnaryOpQuad * un = dynamic_cast<UnaryOpQuad *>(quad)){
+		res = valueOf(un->getSrc());
+		if (res.kind == ConstValue::CONST){
+			res.val = foldUnaryOp(un->getOp(), res.val);
+		}
+	} else if (AssignQuad * assign = dynamic_cast<AssignQuad *>(quad)){
+		res = valueOf(assign->getSrc());
+	}
+	lower(var, res);
+}
+
+bool ConstPropagator::run(){
+	const std::vector<BasicBlock *>& blocks = cfg->getBlocks();
+	size_t numVars = vars.size();
+	values.assign(numVars, ConstValue::top());
+	uses.assign(numVars, std::vector<Quad *>());
+	executable.assign(blocks.size(), false);
+	liveEdges.resize(blocks.size());
+
+	//An operand nothing defines holds whatever it held on entry
+	std::vector<bool> defined(numVars, false);
+	std::vector<Opd **> slots;
+	for (BasicBlock * block : blocks){
+		liveEdges[block->getID()].assign(block->preds.size(), false);
+		for (Quad * quad : block->quads){
+			blockOf[quad] = block;
+			slots.clear();
+			quad->useSlots(slots);
+			for (Opd ** slot : slots){
+				size_t var = vars.id(*slot);
+				if (var != VarIndex::NONE){ uses[var].push_back(quad); }
+			}
+			Opd ** def = quad->defSlot();
+			size_t var = def == nullptr ? VarIndex::NONE : vars.id(*def);
+			if (var != VarIndex::NONE){ defined[var] = true; }
+		}
+	}
+	for (size_t var = 0; var < numVars; var++){
+		if (!defined[var]){ values[var] = ConstValue::bottom(); }
+	}
+
+	executable[cfg->getEntry()->getID()] = true;
+	for (BasicBlock * succ : cfg->getEntry()->succs){
+		markEdge(cfg->getEntry(), succ);
+	}
+	while (!edgeWork.empty() || !quadWork.empty()){
+		if (!edgeWork.empty()){
+			BasicBlock * from = edgeWork.back().first;
+			BasicBlock * to = edgeWork.back().second;
+			edgeWork.pop_back();
+			size_t idx = 0;
+			while (to->preds[idx] != from){ idx++; }
+			std::vector<bool>& live = liveEdges[to->getID()];
+			if (live[idx]){ continue; }
+			live[idx] = true;
+			if (executable[to->getID()]){
+				//Only its phis can see the new edge
+				for (Quad * quad : to->quads){
+					if (dynamic_cast<PhiQuad *>(quad) == nullptr){ break; }
+					visit(quad, to);
+				}
+				continue;
+			}
+			executable[to->getID()] = true;
+			for (Quad * quad : to->quads){ visit(quad, to); }
+			if (to->getIfz() == nullptr){
+				for (BasicBlock * succ : to->succs){ markEdge(to, succ); }
+			}
+			continue;
+		}
+		Quad * quad = quadWork.back();
+		quadWork.pop_back();
+		BasicBlock * block = blockOf[quad];
+		if (executable[block->getID()]){ visit(quad, block); }
+	}
+	return rewrite();
+}
+
+bool ConstPropagator::rewrite(){
+	bool changed = false;
+	std::vector<Opd **> slots;
+	std::vector<BasicBlock *> blocks = cfg->getBlocks();
+	for (BasicBlock * block : blocks){
+		if (!executable[block->getID()]){ continue; }
+		std::vector<Quad *> kept;
+		for (Quad * quad : block->quads){
+			//Every use of a constant is about to be replaced, so
+			// its definition can go
+			Opd ** def = quad->defSlot();
+			size_t var = def == nullptr ? VarIndex::NONE : vars.id(*def);
+			if (var != VarIndex::NONE && values[var].kind == ConstValue::CONST){
+				changed = true;
+				continue;
+			}
+			slots.clear();
+			quad->useSlots(slots);
+			for (Opd ** slot : slots){
+				size_t used = vars.id(*slot);
+				if (used == VarIndex::NONE){ continue; }
+				if (values[used].kind != ConstValue::CONST){ continue; }
+				*slot = new LitOpd(std::to_string(values[used].val),
+					(*slot)->getWidth());
+				changed = true;
+			}
+			kept.push_back(quad);
+		}
+		block->quads.swap(kept);
+
+		if (IfzQuad * ifz = block->getIfz()){
+			int64_t cond;
+			if (literalValue(ifz->getCnd(), cond)){
+				cfg->removeEdge(block, block->succs[cond == 0 ? 0 : 1]);
+				changed = true;
+			}
+		}
+	}
+	return cfg->removeUnreachable() || changed;
+}
+
+bool SCCP::run(CFG * cfg){
+	ConstPropagator prop(cfg);
+	return prop.run();
+}
+
+}
@@ -0,0 +1,239 @@
+#include "ast.hpp"
+#include "ast_cache.hpp"
+
+namespace cshanty{
+
+void ProgramNode::serialize(ASTWriter * w){
+	w->begin(TAG_PROGRAM, this);
+	w->nodes(myGlobals);
+}
+
+void IDNode::serialize(ASTWriter * w){
+	w->begin(TAG_ID, this);
+	w->str(name);
+	w->symbol(mySymbol);
+}
+
+void IndexNode::serialize(ASTWriter * w){
+	w->begin(TAG_INDEX, this);
+	w->node(myBase);
+	w->node(myIdx);
+	w->word(static_cast<uint32_t>(myField));
+}
+
+void RecordTypeNode::serialize(ASTWriter * w){
+	w->begin(TAG_RECORD_TYPE, this);
+	w->node(myID);
+	w->type(myType);
+}
+
+void IntTypeNode::serialize(ASTWriter * w){
+	w->begin(TAG_INT_TYPE, this);
+}
+
+void BoolTypeNode::serialize(ASTWriter * w){
+	w->begin(TAG_BOOL_TYPE, this);
+}
+
+void StringTypeNode::serialize(ASTWriter * w){
+	w->begin(TAG_STRING_TYPE, this);
+}
+
+void VoidTypeNode::serialize(ASTWriter * w){
+	w->begin(TAG_VOID_TYPE, this);
+}
+
+void VarDeclNode::serialize(ASTWriter * w){
+	w->begin(TAG_VAR_DECL, this);
+	w->node(myType);
+	w->node(myID);
+}
+
+void FormalDeclNode::serialize(ASTWriter * w){
+	w->begin(TAG_FORMAL_DECL, this);
+	w->node(getTypeNode());
+	w->node(ID());
+}
+
+void RecordTypeDeclNode::serialize(ASTWriter * w){
+	w->begin(TAG_RECORD_DECL, this);
+	w->node(myID);
+	w->nodes(myFields);
+}
+
+void FnDeclNode::serialize(ASTWriter * w){
+	w->begin(TAG_FN_DECL, this);
+	w->node(myRetType);
+	w->node(myID);
+	w->nodes(myFormals);
+	w->nodes(myBody);
+}
+
+void AssignStmtNode::serialize(ASTWriter * w){
+	w->begin(TAG_ASSIGN_STMT, this);
+	w->node(myExp);
+}
+
+void ReceiveStmtNode::serialize(ASTWriter * w){
+	w->begin(TAG_RECEIVE, this);
+	w->node(myDst);
+}
+
+void ReportStmtNode::serialize(ASTWriter * w){
+	w->begin(TAG_REPORT, this);
+	w->node(mySrc);
+}
+
+void PostDecStmtNode::serialize(ASTWriter * w){
+	w->begin(TAG_POST_DEC, this);
+	w->node(myLVal);
+}
+
+void PostIncStmtNode::serialize(ASTWriter * w){
+	w->begin(TAG_POST_INC, this);
+	w->node(myLVal);
+}
+
+void IfStmtNode::serialize(ASTWriter * w){
+	w->begin(TAG_IF, this);
+	w->node(myCond);
+	w->nodes(myBody);
+}
+
+void IfElseStmtNode::serialize(ASTWriter * w){
+	w->begin(TAG_IF_ELSE, this);
+	w->node(myCond);
+	w->nodes(myBodyTrue);
+	w->nodes(myBodyFalse);
+}
+
+void WhileStmtNode::serialize(ASTWriter * w){
+	w->begin(TAG_WHILE, this);
+	w->node(myCond);
+	w->nodes(myBody);
+}
+
+void ReturnStmtNode::serialize(ASTWriter * w){
+	w->begin(TAG_RETURN, this);
+	w->node(myExp);
+}
+
+void CallStmtNode::serialize(ASTWriter * w){
+	w->begin(TAG_CALL_STMT, this);
+	w->node(myCallExp);
+}
+
+void CallExpNode::serialize(ASTWriter * w){
+	w->begin(TAG_CALL_EXP, this);
+	w->node(myID);
+	w->nodes(myArgs);
+	w->word(retString ? 1 : 0);
+}
+
+void PlusNode::serialize(ASTWriter * w){
+	w->begin(TAG_PLUS, this);
+	w->node(myExp1);
+	w->node(myExp2);
+}
+
+void MinusNode::serialize(ASTWriter * w){
+	w->begin(TAG_MINUS, this);
+	w->node(myExp1);
+	w->node(myExp2);
+}
+
+void TimesNode::serialize(ASTWriter * w){
+	w->begin(TAG_TIMES, this);
+	w->node(myExp1);
+	w->node(myExp2);
+}
+
+void DivideNode::serialize(ASTWriter * w){
+	w->begin(TAG_DIVIDE, this);
+	w->node(myExp1);
+	w->node(myExp2);
+}
+
+void AndNode::serialize(ASTWriter * w){
+	w->begin(TAG_AND, this);
+	w->node(myExp1);
+	w->node(myExp2);
+}
+
+void OrNode::serialize(ASTWriter * w){
+	w->begin(TAG_OR, this);
+	w->node(myExp1);
+	w->node(myExp2);
+}
+
+void EqualsNode::serialize(ASTWriter * w){
+	w->begin(TAG_EQUALS, this);
+	w->node(myExp1);
+	w->node(myExp2);
+}
+
+void NotEqualsNode::serialize(ASTWriter * w){
+	w->begin(TAG_NOT_EQUALS, this);
+	w->node(myExp1);
+	w->node(myExp2);
+}
+
+void LessNode::serialize(ASTWriter * w){
+	w->begin(TAG_LESS, this);
+	w->node(myExp1);
+	w->node(myExp2);
+}
+
+void LessEqNode::serialize(ASTWriter * w){
+	w->begin(TAG_LESS_EQ, this);
+	w->node(myExp1);
+	w->node(myExp2);
+}
+
+void GreaterNode::serialize(ASTWriter * w){
+	w->begin(TAG_GREATER, this);
+	w->node(myExp1);
+	w->node(myExp2);
+}
+
+void GreaterEqNode::serialize(ASTWriter * w){
+	w->begin(TAG_GREATER_EQ, this);
+	w->node(myExp1);
+	w->node(myExp2);
+}
+
+void NegNode::serialize(ASTWriter * w){
+	w->begin(TAG_NEG, this);
+	w->node(myExp);
+}
+
+void NotNode::serialize(ASTWriter * w){
+	w->begin(TAG_NOT, this);
+	w->node(myExp);
+}
+
+void AssignExpNode::serialize(ASTWriter * w){
+	w->begin(TAG_ASSIGN_EXP, this);
+	w->node(myDst);
+	w->node(mySrc);
+}
+
+void IntLitNode::serialize(ASTWriter * w){
+	w->begin(TAG_INT_LIT, this);
+	w->word(static_cast<uint32_t>(myNum));
+}
+
+void StrLitNode::serialize(ASTWriter * w){
+	w->begin(TAG_STR_LIT, this);
+	w->str(myStr);
+}
+
+void TrueNode::serialize(ASTWriter * w){
+	w->begin(TAG_TRUE, this);
+}
+
+void FalseNode::serialize(ASTWriter * w){
+	w->begin(TAG_FALSE, this);
+}
+
+}
@@ -0,0 +1,342 @@
+#include <algorithm>
+#include <set>
+#include "ssa.hpp"
+#include "dataflow.hpp"
+
+namespace cshanty{
+
+void SSA::build(){
+	VarIndex vars(cfg);
+	size_t numVars = vars.size();
+	const std::vector<BasicBlock *>& blocks = cfg->getBlocks();
+
+	//Where each operand is defined, how often, and whether any
+	// block reads it before defining it (a global name, in Briggs'
+	// terms); only global names can need phis
+	std::vector<std::vector<BasicBlock *>> defBlocks(numVars);
+	std::vector<size_t> numDefs(numVars, 0);
+	std::vector<bool> global(numVars, false);
+	std::vector<size_t> definedIn(numVars, VarIndex::NONE);
+	std::vector<Opd **> slots;
+	for (BasicBlock * block : cfg->rpo()){
+		for (Quad * quad : block->quads){
+			slots.clear();
+			quad->useSlots(slots);
+			for (Opd ** slot : slots){
+				size_t var = vars.id(*slot);
+				if (var != VarIndex::NONE && definedIn[var] != block->getID()){
+					global[var] = true;
+				}
+			}
+			Opd ** def = quad->defSlot();
+			size_t var = def == nullptr ? VarIndex::NONE : vars.id(*def);
+			if (var == VarIndex::NONE){ continue; }
+			numDefs[var]++;
+			if (definedIn[var] != block->getID()){
+				definedIn[var] = block->getID();
+				defBlocks[var].push_back(block);
+			}
+		}
+	}
+
+	//Phis, placed at the iterated dominance frontier of each
+	// global name's defs
+	HashMap<Quad *, size_t> phiVars;
+	std::vector<size_t> hasPhi(blocks.size(), VarIndex::NONE);
+	std::vector<size_t> queued(blocks.size(), VarIndex::NONE);
+	std::vector<BasicBlock *> work;
+	for (size_t var = 0; var < numVars; var++){
+		if (!global[var]){ continue; }
+		work = defBlocks[var];
+		for (BasicBlock * block : work){ queued[block->getID()] = var; }
+		while (!work.empty()){
+			BasicBlock * block = work.back();
+			work.pop_back();
+			for (BasicBlock * join : block->frontier){
+				if (hasPhi[join->getID()] == var){ continue; }
+				hasPhi[join->getID()] = var;
+				PhiQuad * phi = new PhiQuad(vars.opd(var), join->preds.size());
+				join->quads.insert(join->quads.begin(), phi);
+				phiVars[phi] = var;
+				if (queued[join->getID()] != var){
+					queued[join->getID()] = var;
+					work.push_back(join);
+				}
+			}
+		}
+	}
+
+	//Rename, walking the dominator tree: each def pushes a new
+	// version, which every use it dominates then reads. An operand
+	// read where no version reaches keeps its own name, standing
+	// for whatever it held on entry.
+	std::vector<bool> renamed(numVars);
+	for (size_t var = 0; var < numVars; var++){
+		renamed[var] = global[var] || numDefs[var] > 1;
+	}
+	std::vector<std::vector<Opd *>> current(numVars);
+	std::vector<size_t> numVersions(numVars, 0);
+	auto newVersion = [&](size_t var){
+		Opd * orig = vars.opd(var);
+		std::string name = orig->locString() + "."
+			+ std::to_string(++numVersions[var]);
+		Opd * version = proc->makeTmp(orig->getWidth(), name);
+		origins[version] = orig;
+		current[var].push_back(version);
+		return version;
+	};
+	auto reaching = [&](size_t var){
+		return current[var].empty() ? vars.opd(var) : current[var].back();
+	};
+
+	//The operands each block pushed versions of, popped on the
+	// way back up the tree
+	std::vector<size_t> pushed;
+	std::vector<std::pair<BasicBlock *, size_t>> stack;
+	std::vector<size_t> marks;
+	stack.push_back(std::make_pair(cfg->getEntry(), 0));
+	bool entering = true;
+	while (!stack.empty()){
+		BasicBlock * block = stack.back().first;
+		if (entering){
+			marks.push_back(pushed.size());
+			for (Quad * quad : block->quads){
+				auto phiVar = phiVars.find(quad);
+				if (phiVar == phiVars.end()){
+					slots.clear();
+					quad->useSlots(slots);
+					for (Opd ** slot : slots){
+						size_t var = vars.id(*slot);
+						if (var != VarIndex::NONE && renamed[var]){
+							*slot = reaching(var);
+						}
+					}
+				}
+				Opd ** def = quad->defSlot();
+				size_t var = phiVar != phiVars.end() ? phiVar->second
+					: def == nullptr ? VarIndex::NONE : vars.id(*def);
+				if (var != VarIndex::NONE && renamed[var]){
+					*def = newVersion(var);
+					pushed.push_back(var);
+				}
+			}
+			for (BasicBlock * succ : block->succs){
+				size_t predIdx = static_cast<size_t>(std::find(
+					succ->preds.begin(), succ->preds.end(), block)
+					- succ->preds.begin());
+				for (Quad * quad : succ->quads){
+					auto phiVar = phiVars.find(quad);
+					if (phiVar == phiVars.end()){ break; }
+					PhiQuad * phi = static_cast<PhiQuad *>(quad);
+					phi->getSrcs()[predIdx] = reaching(phiVar->second);
+				}
+			}
+		}
+		size_t next = stack.back().second;
+		if (next < block->domKids.size()){
+			stack.back().second++;
+			stack.push_back(std::make_pair(block->domKids[next], 0));
+			entering = true;
+			continue;
+		}
+		for (size_t i = marks.back(); i < pushed.size(); i++){
+			current[pushed[i]].pop_back();
+		}
+		pushed.resize(marks.back());
+		marks.pop_back();
+		stack.pop_back();
+		entering = false;
+	}
+}
+
+//The representative of var's set in a union-find forest
+static size_t findLeader(std::vector<size_t>& leader, size_t var){
+	while (leader[var] != var){
+		leader[var] = leader[leader[var]];
+		var = leader[var];
+	}
+	return var;
+}
+
+void SSA::destroy(){
+	//Each phi becomes a copy into a fresh temp at the end of each
+	// predecessor, and a copy out of that temp where the phi was.
+	// The temp keeps copies on different edges from clobbering
+	// each other (the "lost copy" and "swap" problems).
+	std::vector<BasicBlock *> blocks = cfg->getBlocks();
+	for (BasicBlock * block : blocks){
+		if (block->quads.empty()
+		  || dynamic_cast<PhiQuad *>(block->quads.front()) == nullptr){
+			continue;
+		}
+		std::vector<BasicBlock *> preds = block->preds;
+		for (BasicBlock * pred : preds){
+			if (pred->succs.size() > 1){ cfg->splitEdge(pred, block); }
+		}
+		for (Quad *& quad : block->quads){
+			PhiQuad * phi = dynamic_cast<PhiQuad *>(quad);
+			if (phi == nullptr){ break; }
+			Opd * dst = phi->getDst();
+			AuxOpd * tmp = proc->makeTmp(dst->getWidth(),
+				dst->locString() + ".phi");
+			auto origin = origins.find(dst);
+			origins[tmp] = origin == origins.end() ? dst : origin->second;
+			for (size_t i = 0; i < block->preds.size(); i++){
+				block->preds[i]->quads.push_back(
+					new AssignQuad(tmp, phi->getSrcs()[i], false));
+			}
+			quad = new AssignQuad(dst, tmp, false);
+		}
+	}
+	cfg->analyze();
+
+	//The copies that coalescing might remove, and the groups of
+	// operands they connect. Coalescing never merges across
+	// groups, so only the interference within a group matters.
+	VarIndex vars(cfg);
+	size_t numVars = vars.size();
+	std::vector<AssignQuad *> copies;
+	BitSet related(numVars);
+	std::vector<size_t> group(numVars);
+	for (size_t var = 0; var < numVars; var++){ group[var] = var; }
+	for (BasicBlock * block : cfg->rpo()){
+		for (Quad * quad : block->quads){
+			AssignQuad * copy = dynamic_cast<AssignQuad *>(quad);
+			if (copy == nullptr){ continue; }
+			size_t dst = vars.id(copy->getDst());
+			size_t src = vars.id(copy->getSrc());
+			if (dst == VarIndex::NONE || src == VarIndex::NONE){ continue; }
+			if (copy->getDst()->getWidth() != copy->getSrc()->getWidth()){
+				continue;
+			}
+			copies.push_back(copy);
+			related.set(dst);
+			related.set(src);
+			group[findLeader(group, src)] = findLeader(group, dst);
+		}
+	}
+	for (size_t var = 0; var < numVars; var++){
+		group[var] = findLeader(group, var);
+	}
+
+	//Two operands interfere if one is defined while the other is
+	// live, other than by a copy of the other
+	Liveness liveness(cfg, vars);
+	std::vector<std::vector<size_t>> conflicts(numVars);
+	BitSet liveRelated(numVars);
+	std::vector<Opd **> slots;
+	for (BasicBlock * block : cfg->rpo()){
+		BitSet live = liveness.out(block);
+		for (auto itr = block->quads.rbegin(); itr != block->quads.rend(); itr++){
+			Quad * quad = *itr;
+			Opd ** def = quad->defSlot();
+			size_t var = def == nullptr ? VarIndex::NONE : vars.id(*def);
+			if (var != VarIndex::NONE && related.test(var)){
+				size_t copied = VarIndex::NONE;
+				if (AssignQuad * copy = dynamic_cast<AssignQuad *>(quad)){
+					copied = vars.id(copy->getSrc());
+				}
+				liveRelated = live;
+				liveRelated.intersectWith(related);
+				liveRelated.forEach([&](size_t other){
+					if (other != var && other != copied
+					  && group[other] == group[var]){
+						conflicts[var].push_back(other);
+						conflicts[other].push_back(var);
+					}
+				});
+			}
+			liveness.step(quad, live);
+		}
+	}
+
+	//Coalesce across copies, merging classes of operands whenever
+	// no member of one conflicts with a member of the other
+	std::vector<size_t> leader(numVars);
+	std::vector<std::vector<size_t>> members(numVars);
+	for (size_t var = 0; var < numVars; var++){
+		leader[var] = var;
+		members[var].push_back(var);
+	}
+	auto find = [&](size_t var){ return findLeader(leader, var); };
+	auto conflict = [&](size_t a, size_t b){
+		if (members[a].size() > members[b].size()){ std::swap(a, b); }
+		for (size_t member : members[a]){
+			for (size_t other : conflicts[member]){
+				if (find(other) == b){ return true; }
+			}
+		}
+		return false;
+	};
+	for (AssignQuad * copy : copies){
+		size_t dst = find(vars.id(copy->getDst()));
+		size_t src = find(vars.id(copy->getSrc()));
+		if (dst == src || conflict(dst, src)){ continue; }
+		if (members[dst].size() < members[src].size()){
+			std::swap(dst, src);
+		}
+		leader[src] = dst;
+		members[dst].insert(members[dst].end(),
+			members[src].begin(), members[src].end());
+		members[src].clear();
+	}
+
+	//Name each class, in order of preference: after a local or
+	// formal in it, after a local its versions came from, after
+	// any other operand in it, or after any operand its versions
+	// came from. An origin still in use elsewhere is not available.
+	std::vector<Opd *> names(numVars, nullptr);
+	std::set<Opd *> claimed;
+	auto freeOrigin = [&](size_t member, bool local) -> Opd *{
+		auto origin = origins.find(vars.opd(member));
+		if (origin == origins.end()){ return nullptr; }
+		Opd * opd = origin->second;
+		if (vars.id(opd) != VarIndex::NONE || claimed.count(opd) != 0
+		  || proc->isLocal(opd) != local){
+			return nullptr;
+		}
+		return opd;
+	};
+	for (size_t var = 0; var < numVars; var++){
+		if (find(var) != var){ continue; }
+		Opd * name = nullptr;
+		for (size_t member : members[var]){
+			Opd * opd = vars.opd(member);
+			if (!isVersion(opd) && proc->isLocal(opd)){ name = opd; }
+		}
+		for (size_t member : members[var]){
+			if (name == nullptr){ name = freeOrigin(member, true); }
+		}
+		for (size_t member : members[var]){
+			Opd * opd = vars.opd(member);
+			if (name == nullptr && !isVersion(opd)){ name = opd; }
+		}
+		for (size_t member : members[var]){
+			if (name == nullptr){ name = freeOrigin(member, false); }
+		}
+		if (name == nullptr){ name = vars.opd(var); }
+		names[var] = name;
+		claimed.insert(name);
+	}
+
+	for (BasicBlock * block : cfg->getBlocks()){
+		std::vector<Quad *> kept;
+		for (Quad * quad : block->quads){
+			slots.clear();
+			quad->useSlots(slots);
+			if (Opd ** def = quad->defSlot()){ slots.push_back(def); }
+			for (Opd ** slot : slots){
+				size_t var = vars.id(*slot);
+				if (var != VarIndex::NONE){ *slot = names[find(var)]; }
+			}
+			AssignQuad * copy = dynamic_cast<AssignQuad *>(quad);
+			if (copy == nullptr || copy->getDst() != copy->getSrc()){
+				kept.push_back(quad);
+			}
+		}
+		block->quads.swap(kept);
+	}
+	origins.clear();
+}
+
+}
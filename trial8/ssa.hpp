@@ -0,0 +1,40 @@
+#ifndef CSHANTY_SSA_HPP
+#define CSHANTY_SSA_HPP
+
+#include "cfg.hpp"
+
+namespace cshanty{
+
+//Puts a procedure's CFG into SSA form and takes it back out.
+// Only the operands a VarIndex tracks are renamed; globals and
+// records keep their single home in memory throughout.
+class SSA{
+public:
+	SSA(CFG * cfgIn) : cfg(cfgIn), proc(cfgIn->getProc()){ }
+
+	//Give each def of a tracked operand a version of its own, and
+	// place phis (semi-pruned, at the iterated dominance frontier
+	// of its defs) wherever versions of one operand meet. A temp
+	// defined once, before any use, keeps its name. The CFG must
+	// be analyzed, with no unreachable blocks.
+	void build();
+
+	//Turn each phi into copies on its incoming edges, splitting
+	// critical edges to make room, then coalesce every copy whose
+	// two sides are never live at once into one operand. After a
+	// plain round trip no copies are left, and each coalesced
+	// operand gets back the name of the local it came from.
+	void destroy();
+
+	//Whether the operand is a version made by build()
+	bool isVersion(Opd * opd) const{ return origins.count(opd) != 0; }
+private:
+	CFG * cfg;
+	Procedure * proc;
+	//The operand each version was made from
+	HashMap<Opd *, Opd *> origins;
+};
+
+}
+
+#endif
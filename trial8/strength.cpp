@@ -0,0 +1,427 @@
+#include <algorithm>
+#include <map>
+#include "opt.hpp"
+#include "cfg.hpp"
+
+namespace cshanty{
+
+//k if val is 2 to the k, for k from 1 to 62; otherwise 0
+static int64_t log2Exact(int64_t val){
+	if (val < 2 || (val & (val - 1)) != 0){ return 0; }
+	return __builtin_ctzll(static_cast<unsigned long long>(val));
+}
+
+//a * b, wrapping as the generated code does
+static int64_t wrapMult(int64_t a, int64_t b){
+	return static_cast<int64_t>(static_cast<uint64_t>(a)
+		* static_cast<uint64_t>(b));
+}
+
+static LitOpd * intLit(int64_t val){
+	return new LitOpd(std::to_string(val), 8);
+}
+
+//The state of one run of algebraic simplification over one CFG
+class Simplifier{
+public:
+	Simplifier(CFG * cfgIn) : cfg(cfgIn), vars(cfgIn){ }
+	size_t run();
+private:
+	bool simplify(Quad * quad, std::vector<Quad *>& out);
+	bool simplifyBinOp(BinOpQuad * bin, std::vector<Quad *>& out);
+	bool simplifyUnaryOp(UnaryOpQuad * un, std::vector<Quad *>& out);
+	bool becomes(Quad * quad, Opd * val, std::vector<Quad *>& out);
+	bool becomesLit(Quad * quad, int64_t val, std::vector<Quad *>& out);
+
+	CFG * cfg;
+	VarIndex vars;
+	HashMap<Opd *, Quad *> defs;
+	//The operand or literal standing in for each one whose
+	// definition went
+	HashMap<Opd *, Opd *> replaced;
+	size_t changed = 0;
+};
+
+//The quad's destination holds val, a plain value or a literal.
+// A numbered destination is replaced by val wherever it is read;
+// any other one is still written, by a copy.
+bool Simplifier::becomes(Quad * quad, Opd * val, std::vector<Quad *>& out){
+	Opd * dst = quad->defSlot() == nullptr ? nullptr : *quad->defSlot();
+	bool plain = dynamic_cast<LitOpd *>(val) != nullptr
+		|| vars.id(val) != VarIndex::NONE;
+	if (dst != nullptr && vars.id(dst) != VarIndex::NONE && plain){
+		replaced[dst] = val;
+		return true;
+	}
+	BinOpQuad * bin = dynamic_cast<BinOpQuad *>(quad);
+	UnaryOpQuad * un = dynamic_cast<UnaryOpQuad *>(quad);
+	Opd * to = bin != nullptr ? bin->getDst() : un->getDst();
+	out.push_back(new AssignQuad(to, val, false));
+	return true;
+}
+
+bool Simplifier::becomesLit(Quad * quad, int64_t val,
+	std::vector<Quad *>& out){
+	Opd ** def = quad->defSlot();
+	size_t width = def == nullptr ? 8 : (*def)->getWidth();
+	return becomes(quad, new LitOpd(std::to_string(val), width), out);
+}
+
+bool Simplifier::simplifyBinOp(BinOpQuad * bin, std::vector<Quad *>& out){
+	Opd * dst = bin->getDst();
+	Opd * l = bin->getSrc1();
+	Opd * r = bin->getSrc2();
+	int64_t lv = 0;
+	int64_t rv = 0;
+	bool lLit = literalValue(l, lv);
+	bool rLit = literalValue(r, rv);
+	//Both reads of an operand in one quad see the same value
+	bool same = l == r || (lLit && rLit && lv == rv);
+
+	switch (bin->getOp()){
+	case ADD64:
+		if (rLit && rv == 0){ return becomes(bin, l, out); }
+		if (lLit && lv == 0){ return becomes(bin, r, out); }
+		return false;
+	case SUB64:
+		if (rLit && rv == 0){ return becomes(bin, l, out); }
+		if (same){ return becomesLit(bin, 0, out); }
+		if (lLit && lv == 0){
+			out.push_back(new UnaryOpQuad(dst, NEG64, r));
+			return true;
+		}
+		return false;
+	case MULT64: {
+		//Keep any literal on the right, where the backend looks
+		// for one it can multiply by with an lea
+		if (lLit && !rLit){
+			std::swap(l, r);
+			std::swap(lv, rv);
+			std::swap(lLit, rLit);
+		}
+		if (!rLit){ return false; }
+		if (rv == 0){ return becomesLit(bin, 0, out); }
+		if (rv == 1){ return becomes(bin, l, out); }
+		if (rv == -1){
+			out.push_back(new UnaryOpQuad(dst, NEG64, l));
+			return true;
+		}
+		int64_t shift = log2Exact(rv);
+		if (shift != 0){
+			out.push_back(new BinOpQuad(dst, SHL64, l, intLit(shift)));
+			return true;
+		}
+		if (l != bin->getSrc1()){
+			out.push_back(new BinOpQuad(dst, MULT64, l, r));
+			return true;
+		}
+		return false;
+	}
+	case DIV64: {
+		if (!rLit){ return false; }
+		if (rv == 1){ return becomes(bin, l, out); }
+		int64_t shift = log2Exact(rv);
+		if (shift == 0){ return false; }
+		//Shifting right rounds down, but division rounds toward
+		// zero: a negative dividend first gets 2^shift - 1 added
+		Procedure * proc = cfg->getProc();
+		AuxOpd * bias = proc->makeTmp(8);
+		if (shift == 1){
+			out.push_back(new BinOpQuad(bias, SHR64, l, intLit(63)));
+		} else {
+			AuxOpd * sign = proc->makeTmp(8);
+			out.push_back(new BinOpQuad(sign, SAR64, l, intLit(63)));
+			out.push_back(new BinOpQuad(bias, SHR64, sign, intLit(64 - shift)));
+		}
+		AuxOpd * biased = proc->makeTmp(8);
+		out.push_back(new BinOpQuad(biased, ADD64, l, bias));
+		out.push_back(new BinOpQuad(dst, SAR64, biased, intLit(shift)));
+		return true;
+	}
+	case AND64:
+		if ((rLit && rv == 0) || (lLit && lv == 0)){
+			return becomesLit(bin, 0, out);
+		}
+		if (same){ return becomes(bin, l, out); }
+		//Only && makes an AND64, and its bools are 0 or 1, so true
+		// changes nothing
+		if (rLit && rv == 1){ return becomes(bin, l, out); }
+		if (lLit && lv == 1){ return becomes(bin, r, out); }
+		return false;
+	case OR64:
+		if (rLit && rv == 0){ return becomes(bin, l, out); }
+		if (lLit && lv == 0){ return becomes(bin, r, out); }
+		if (same){ return becomes(bin, l, out); }
+		return false;
+	case EQ64: case LTE64: case GTE64:
+		if (same){ return becomesLit(bin, 1, out); }
+		return false;
+	case NEQ64: case LT64: case GT64:
+		if (same){ return becomesLit(bin, 0, out); }
+		return false;
+	default:
+		return false;
+	}
+}
+
+bool Simplifier::simplifyUnaryOp(UnaryOpQuad * un, std::vector<Quad *>& out){
+	//!!b is b, and -(-x) is x
+	auto def = defs.find(un->getSrc());
+	if (def == defs.end()){ return false; }
+	UnaryOpQuad * inner = dynamic_cast<UnaryOpQuad *>(def->second);
+	if (inner == nullptr || inner->getOp() != un->getOp()){ return false; }
+	Opd * src = inner->getSrc();
+	auto found = replaced.find(src);
+	if (found != replaced.end()){ src = found->second; }
+	if (dynamic_cast<LitOpd *>(src) == nullptr
+	  && vars.id(src) == VarIndex::NONE){
+		return false;
+	}
+	return becomes(un, src, out);
+}
+
+//Put whatever quad stands for quad in out, returning whether
+// that is anything but quad itself
+bool Simplifier::simplify(Quad * quad, std::vector<Quad *>& out){
+	if (BinOpQuad * bin = dynamic_cast<BinOpQuad *>(quad)){
+		if (simplifyBinOp(bin, out)){ return true; }
+	} else if (UnaryOpQuad * un = dynamic_cast<UnaryOpQuad *>(quad)){
+		if (simplifyUnaryOp(un, out)){ return true; }
+	}
+	out.push_back(quad);
+	return false;
+}
+
+size_t Simplifier::run(){
+	std::vector<Opd **> slots;
+	//Definitions come before their uses in reverse postorder, but
+	// for phi operands, which are only rewritten at the end
+	for (BasicBlock * block : cfg->rpo()){
+		std::vector<Quad *> kept;
+		for (Quad * quad : block->quads){
+			if (dynamic_cast<PhiQuad *>(quad) == nullptr){
+				slots.clear();
+				quad->useSlots(slots);
+				for (Opd ** slot : slots){
+					auto found = replaced.find(*slot);
+					if (found == replaced.end()){ continue; }
+					Opd * val = found->second;
+					if (dynamic_cast<LitOpd *>(val) != nullptr){
+						val = new LitOpd(val->valString(), (*slot)->getWidth());
+					}
+					*slot = val;
+				}
+			}
+			if (simplify(quad, kept)){ changed++; }
+			Quad * last = kept.empty() ? nullptr : kept.back();
+			Opd ** def = last == nullptr ? nullptr : last->defSlot();
+			if (def != nullptr && vars.id(*def) != VarIndex::NONE){
+				defs[*def] = last;
+			}
+		}
+		block->quads.swap(kept);
+	}
+	for (BasicBlock * block : cfg->getBlocks()){
+		for (Quad * quad : block->quads){
+			PhiQuad * phi = dynamic_cast<PhiQuad *>(quad);
+			if (phi == nullptr){ break; }
+			for (Opd *& src : phi->getSrcs()){
+				auto found = replaced.find(src);
+				if (found == replaced.end()){ continue; }
+				src = found->second;
+				if (dynamic_cast<LitOpd *>(src) != nullptr){
+					src = new LitOpd(src->valString(), phi->getDst()->getWidth());
+				}
+			}
+		}
+	}
+	return changed;
+}
+
+//An induction variable: a header phi that each trip round the
+// loop adds a literal step to
+struct Induction{
+	Opd * init;
+	int64_t step;
+	//The quad making the value for the next trip
+	Quad * next;
+};
+
+//The state of one run of induction variable strength reduction
+class InductionReducer{
+public:
+	InductionReducer(CFG * cfgIn) : cfg(cfgIn), vars(cfgIn){ }
+	size_t run();
+private:
+	void reduce(Loop * loop);
+	bool setOutside(Opd * opd, Loop * loop);
+
+	CFG * cfg;
+	VarIndex vars;
+	HashMap<Opd *, Quad *> defs;
+	HashMap<Quad *, BasicBlock *> blockOf;
+	HashMap<Opd *, Opd *> replaced;
+	size_t changed = 0;
+};
+
+bool InductionReducer::setOutside(Opd * opd, Loop * loop){
+	if (dynamic_cast<LitOpd *>(opd) != nullptr){ return true; }
+	auto def = defs.find(opd);
+	if (def == defs.end()){ return false; }
+	return !loop->contains(blockOf[def->second]);
+}
+
+void InductionReducer::reduce(Loop * loop){
+	BasicBlock * header = loop->header;
+	if (header->preds.size() != 2){ return; }
+	size_t outIdx = loop->contains(header->preds[0]) ? 1 : 0;
+	size_t backIdx = 1 - outIdx;
+	BasicBlock * preheader = header->preds[outIdx];
+	if (loop->contains(preheader) || preheader->succs.size() != 1
+	  || preheader == cfg->getEntry()){
+		return;
+	}
+
+	HashMap<Opd *, Induction> inductions;
+	for (Quad * quad : header->quads){
+		PhiQuad * phi = dynamic_cast<PhiQuad *>(quad);
+		if (phi == nullptr){ break; }
+		Opd * var = phi->getDst();
+		auto def = defs.find(phi->getSrcs()[backIdx]);
+		if (def == defs.end() || var->getWidth() != 8){ continue; }
+		BinOpQuad * bin = dynamic_cast<BinOpQuad *>(def->second);
+		if (bin == nullptr){ continue; }
+		int64_t step;
+		if (bin->getOp() == ADD64 && bin->getSrc1() == var
+		  && literalValue(bin->getSrc2(), step)){
+		} else if (bin->getOp() == ADD64 && bin->getSrc2() == var
+		  && literalValue(bin->getSrc1(), step)){
+		} else if (bin->getOp() == SUB64 && bin->getSrc1() == var
+		  && literalValue(bin->getSrc2(), step)){
+			step = static_cast<int64_t>(0 - static_cast<uint64_t>(step));
+		} else {
+			continue;
+		}
+		inductions[var] = Induction{phi->getSrcs()[outIdx], step, bin};
+	}
+	if (inductions.empty()){ return; }
+
+	//var * factor, for each one already made, as a new phi, and
+	// the quads to add once every block has been looked at
+	std::map<std::pair<Opd *, std::string>, Opd *> made;
+	std::vector<Quad *> phis;
+	HashMap<Quad *, std::vector<Quad *>> after;
+	Procedure * proc = cfg->getProc();
+	for (BasicBlock * block : loop->blocks){
+		std::vector<Quad *> kept;
+		for (Quad * quad : block->quads){
+			kept.push_back(quad);
+			BinOpQuad * bin = dynamic_cast<BinOpQuad *>(quad);
+			if (bin == nullptr || bin->getOp() != MULT64){ continue; }
+			Opd ** def = bin->defSlot();
+			if (def == nullptr || vars.id(*def) == VarIndex::NONE){ continue; }
+			Opd * var = bin->getSrc1();
+			Opd * factor = bin->getSrc2();
+			if (inductions.count(var) == 0){ std::swap(var, factor); }
+			auto found = inductions.find(var);
+			if (found == inductions.end() || factor->getWidth() != 8){
+				continue;
+			}
+			if (!setOutside(factor, loop)){ continue; }
+			const Induction& ind = found->second;
+
+			int64_t factorVal = 0;
+			bool factorLit = literalValue(factor, factorVal);
+			std::string factorKey = factorLit ? factor->valString()
+				: "@" + std::to_string(vars.id(factor));
+			Opd *& reduced = made[std::make_pair(var, factorKey)];
+			if (reduced == nullptr){
+				//var * factor starts at init * factor and goes up by
+				// step * factor each trip
+				int64_t initVal;
+				Opd * start;
+				if (factorLit && literalValue(ind.init, initVal)){
+					start = intLit(wrapMult(initVal, factorVal));
+				} else {
+					//With any literal on the right
+					start = proc->makeTmp(8);
+					preheader->quads.push_back(factorLit
+						? new BinOpQuad(start, MULT64, ind.init, factor)
+						: new BinOpQuad(start, MULT64, factor, ind.init));
+				}
+				Opd * stride;
+				if (factorLit){
+					stride = intLit(wrapMult(ind.step, factorVal));
+				} else {
+					stride = proc->makeTmp(8);
+					preheader->quads.push_back(new BinOpQuad(stride, MULT64,
+						factor, intLit(ind.step)));
+				}
+				reduced = proc->makeTmp(8);
+				Opd * nextVal = proc->makeTmp(8);
+				PhiQuad * phi = new PhiQuad(reduced, 2);
+				phi->getSrcs()[outIdx] = start;
+				phi->getSrcs()[backIdx] = nextVal;
+				phis.push_back(phi);
+				after[ind.next].push_back(
+					new BinOpQuad(nextVal, ADD64, reduced, stride));
+			}
+			replaced[*def] = reduced;
+			kept.pop_back();
+			changed++;
+		}
+		block->quads.swap(kept);
+	}
+	if (phis.empty()){ return; }
+
+	header->quads.insert(header->quads.begin(), phis.begin(), phis.end());
+	for (BasicBlock * block : loop->blocks){
+		std::vector<Quad *> quads;
+		for (Quad * quad : block->quads){
+			quads.push_back(quad);
+			auto found = after.find(quad);
+			if (found == after.end()){ continue; }
+			quads.insert(quads.end(), found->second.begin(), found->second.end());
+		}
+		block->quads.swap(quads);
+	}
+}
+
+size_t InductionReducer::run(){
+	for (BasicBlock * block : cfg->getBlocks()){
+		for (Quad * quad : block->quads){
+			blockOf[quad] = block;
+			Opd ** def = quad->defSlot();
+			if (def != nullptr && vars.id(*def) != VarIndex::NONE){
+				defs[*def] = quad;
+			}
+		}
+	}
+	for (Loop * loop : cfg->getLoops()){ reduce(loop); }
+	if (replaced.empty()){ return changed; }
+
+	std::vector<Opd **> slots;
+	for (BasicBlock * block : cfg->getBlocks()){
+		for (Quad * quad : block->quads){
+			slots.clear();
+			quad->useSlots(slots);
+			for (Opd ** slot : slots){
+				auto found = replaced.find(*slot);
+				if (found != replaced.end()){ *slot = found->second; }
+			}
+		}
+	}
+	return changed;
+}
+
+size_t StrengthReduction::simplify(CFG * cfg){
+	Simplifier simplifier(cfg);
+	return simplifier.run();
+}
+
+size_t StrengthReduction::reduceInductions(CFG * cfg){
+	InductionReducer reducer(cfg);
+	return reducer.run();
+}
+
+}
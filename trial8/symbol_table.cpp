@@ -2,88 +2,119 @@
 #include "types.hpp"
 namespace cshanty{
 
-SymbolTable::SymbolTable(){
-	scopeTableChain = new std::list<ScopeTable *>();
+const uint32_t SymbolTable::NONE;
+
+SymbolTable::SymbolTable()
+: slots(16), slotsUsed(0){
 }
 
 void SymbolTable::print(){
-	for(auto scope : *scopeTableChain){
+	//Innermost scope first, as a lookup would see them
+	size_t end = log.size();
+	for (size_t i = scopeStarts.size(); i > 0; i--){
+		size_t start = scopeStarts[i - 1];
 		std::cout << "--- scope ---\n";
-		std::cout << scope->toString();
+		for (size_t j = start; j < end; j++){
+			std::cout << log[j].sym->toString() << "\n";
+		}
+		end = start;
 	}
 }
 
-ScopeTable * SymbolTable::enterScope(){
-	ScopeTable * newScope = new ScopeTable();
-	scopeTableChain->push_front(newScope);
-	return newScope;
+void SymbolTable::enterScope(){
+	scopeStarts.push_back(log.size());
 }
 
 void SymbolTable::leaveScope(){
-	if (scopeTableChain->empty()){
+	if (scopeStarts.empty()){
 		throw new InternalError("Attempt to pop"
 			"empty symbol table");
 	}
-	scopeTableChain->pop_front();
-}
-
-ScopeTable * SymbolTable::getCurrentScope(){
-	return scopeTableChain->front();
-}
-
-bool SymbolTable::clash(std::string varName){
-	bool hasClash = getCurrentScope()->clash(varName);
-	return hasClash;
+	size_t start = scopeStarts.back();
+	scopeStarts.pop_back();
+	while (log.size() > start){
+		const Entry& entry = log.back();
+		slots[entry.slot].head = entry.shadowed;
+		log.pop_back();
+	}
 }
 
-SemSymbol * SymbolTable::find(std::string varName){
-	for (ScopeTable * scope : *scopeTableChain){
-		SemSymbol * sym = scope->lookup(varName);
-		if (sym != nullptr) { return sym; }
+//The slot holding name, or the empty slot where it would go
+uint32_t SymbolTable::probe(const std::string& name, size_t hash) const{
+	size_t mask = slots.size() - 1;
+	size_t idx = hash & mask;
+	while (true){
+		const Slot& slot = slots[idx];
+		if (slot.name.empty()){ break; }
+		if (slot.hash == hash && slot.name == name){ break; }
+		idx = (idx + 1) & mask;
 	}
-	return nullptr;
+	return static_cast<uint32_t>(idx);
 }
 
-bool SymbolTable::insert(SemSymbol * symbol){
-	return scopeTableChain->front()->insert(symbol);
-}
+uint32_t SymbolTable::slotFor(const std::string& name){
+	size_t hash = std::hash<std::string>()(name);
+	uint32_t idx = probe(name, hash);
+	if (!slots[idx].name.empty()){ return idx; }
 
-ScopeTable::ScopeTable(){
-	symbols = new HashMap<std::string, SemSymbol *>();
+	//Keep the table at most half full
+	if (2 * (slotsUsed + 1) > slots.size()){
+		grow();
+		idx = probe(name, hash);
+	}
+	slots[idx].name = name;
+	slots[idx].hash = hash;
+	slots[idx].head = NONE;
+	slotsUsed++;
+	return idx;
 }
 
-std::string ScopeTable::toString(){
-	std::string result = "";
-	for (auto entry : *symbols){
-		result += entry.second->toString();
-		result += "\n";
+void SymbolTable::grow(){
+	std::vector<Slot> old;
+	old.swap(slots);
+	slots.resize(2 * old.size());
+	std::vector<uint32_t> moved(old.size(), NONE);
+	for (size_t i = 0; i < old.size(); i++){
+		if (old[i].name.empty()){ continue; }
+		uint32_t idx = probe(old[i].name, old[i].hash);
+		slots[idx] = std::move(old[i]);
+		moved[i] = idx;
+	}
+	for (Entry& entry : log){
+		entry.slot = moved[entry.slot];
 	}
-	return result;
 }
 
-bool ScopeTable::clash(std::string varName){
-	SemSymbol * found = lookup(varName);
-	if (found != nullptr){
-		return true;
-	}
-	return false;
+bool SymbolTable::clash(const std::string& varName){
+	if (scopeStarts.empty()){ return false; }
+	size_t hash = std::hash<std::string>()(varName);
+	const Slot& slot = slots[probe(varName, hash)];
+	if (slot.name.empty() || slot.head == NONE){ return false; }
+	return log[slot.head].depth == scopeStarts.size();
 }
 
-SemSymbol * ScopeTable::lookup(std::string name){
-	auto found = symbols->find(name);
-	if (found == symbols->end()){
-		return NULL;
-	}
-	return found->second;
+SemSymbol * SymbolTable::find(const std::string& varName){
+	size_t hash = std::hash<std::string>()(varName);
+	const Slot& slot = slots[probe(varName, hash)];
+	if (slot.name.empty() || slot.head == NONE){ return nullptr; }
+	return log[slot.head].sym;
 }
 
-bool ScopeTable::insert(SemSymbol * symbol){
-	std::string symName = symbol->getName();
-	bool alreadyInScope = (this->lookup(symName) != NULL);
-	if (alreadyInScope){
-		return false;
+bool SymbolTable::insert(SemSymbol * symbol){
+	if (scopeStarts.empty()){
+		throw new InternalError("Insert into empty symbol table");
 	}
-	this->symbols->insert(std::make_pair(symName, symbol));
+	uint32_t idx = slotFor(symbol->getName());
+	uint32_t depth = static_cast<uint32_t>(scopeStarts.size());
+	uint32_t head = slots[idx].head;
+	if (head != NONE && log[head].depth == depth){ return false; }
+	Entry entry;
+	entry.sym = symbol;
+	entry.slot = idx;
+	entry.shadowed = head;
+	entry.depth = depth;
+	slots[idx].head = static_cast<uint32_t>(log.size());
+	log.push_back(entry);
 	return true;
 }
 
@@ -1,8 +1,10 @@
 #ifndef CSHANTY_SYMBOL_TABLE_HPP
 #define CSHANTY_SYMBOL_TABLE_HPP
+#include <cstdint>
 #include <string>
 #include <unordered_map>
 #include <list>
+#include <vector>
 #include "types.hpp"
 
 //Use an alias template so that we can use
@@ -71,47 +73,56 @@ public:
 	SymbolKind getKind(){ return RECORD; }
 };
 
-//A single scope. The symbol table is broken down into a 
-// chain of scope tables, and each scope table holds 
-// semantic symbols for a single scope. For example,
-// the globals scope will be represented by a ScopeTable,
-// and the contents of each function can be represented by
-// a ScopeTable.
-class ScopeTable {
-	public:
-		ScopeTable();
-		SemSymbol * lookup(std::string name);
-		bool insert(SemSymbol * symbol);
-		bool clash(std::string name);
-		std::string toString();
-		void addVar(std::string name, const DataType * type){
-			insert(new VarSymbol(name, type));
-		}
-		void addFn(std::string name, FnType * type){
-			insert(new FnSymbol(name, type));
-		}
-	private:
-		HashMap<std::string, SemSymbol *> * symbols;
-};
-
+//The symbol table for a whole program: a single open-addressing
+// hash table keyed by name, rather than a table per scope. A
+// name's slot holds the innermost symbol visible under that name,
+// and each symbol links to the outer one it shadows. Every insert
+// is also pushed on an undo log, so leaving a scope pops that
+// scope's entries and puts back the symbols they shadowed. A
+// lookup is one probe sequence however deep the nesting, and
+// entering a scope allocates nothing.
 class SymbolTable{
 	public:
 		SymbolTable();
-		ScopeTable * enterScope();
+		void enterScope();
 		void leaveScope();
-		ScopeTable * getCurrentScope();
+		//Number of scopes currently open
+		size_t depth() const { return scopeStarts.size(); }
 		bool insert(SemSymbol * symbol);
-		SemSymbol * find(std::string varName);
-		bool clash(std::string name);
+		SemSymbol * find(const std::string& varName);
+		bool clash(const std::string& name);
 		void addVar(std::string name, const DataType * type){
-			getCurrentScope()->addVar(name, type);
+			insert(new VarSymbol(name, type));
 		}
-		void addFn(std::string name, FnType * type){
-			getCurrentScope()->addFn(name, type);
+		void addFn(std::string name, const FnType * type){
+			insert(new FnSymbol(name, type));
 		}
 		void print();
 	private:
-		std::list<ScopeTable *> * scopeTableChain;
+		static const uint32_t NONE = UINT32_MAX;
+		//One per distinct name ever inserted. A slot stays put
+		// once made (so probe sequences never break), with
+		// head set to NONE while nothing of that name is visible.
+		struct Slot{
+			std::string name;
+			size_t hash;
+			uint32_t head;
+		};
+		//One per live symbol, in insertion order
+		struct Entry{
+			SemSymbol * sym;
+			uint32_t slot;
+			uint32_t shadowed;
+			uint32_t depth;
+		};
+		uint32_t probe(const std::string& name, size_t hash) const;
+		uint32_t slotFor(const std::string& name);
+		void grow();
+
+		std::vector<Slot> slots;
+		size_t slotsUsed;
+		std::vector<Entry> log;
+		std::vector<size_t> scopeStarts;
 };
 
 	
@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <sys/resource.h>
+#include "time_report.hpp"
+
+#ifndef CSHANTY_NO_TIME_REPORT
+//Every allocation in the process goes through here so it can be
+// counted. The count is shared by all threads, so phases of inputs
+// compiled side by side (-j) see each other's allocations.
+static std::atomic<uint64_t> allocCount(0);
+
+void * operator new(size_t size){
+	allocCount.fetch_add(1, std::memory_order_relaxed);
+	void * res = malloc(size == 0 ? 1 : size);
+	if (res == nullptr){ throw std::bad_alloc(); }
+	return res;
+}
+
+void operator delete(void * ptr) noexcept{
+	free(ptr);
+}
+
+void operator delete(void * ptr, size_t) noexcept{
+	free(ptr);
+}
+#endif
+
+namespace cshanty{
+
+uint64_t TimeReport::allocations(){
+#ifdef CSHANTY_NO_TIME_REPORT
+	return 0;
+#else
+	return allocCount.load(std::memory_order_relaxed);
+#endif
+}
+
+long TimeReport::peakRSS(){
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0){ return 0; }
+	return usage.ru_maxrss;
+}
+
+void TimeReport::add(const char * phase, double seconds,
+	uint64_t allocs, long peakKB){
+	for (Phase& row : phases){
+		if (row.name == phase){
+			row.seconds += seconds;
+			row.allocs += allocs;
+			row.peakKB = peakKB;
+			return;
+		}
+	}
+	phases.push_back(Phase{phase, seconds, allocs, peakKB});
+}
+
+std::string jsonString(const char * text){
+	std::string res = "\"";
+	for (const char * c = text; *c != '\0'; c++){
+		if (*c == '"' || *c == '\\'){
+			res += '\\';
+			res += *c;
+		} else if (static_cast<unsigned char>(*c) < 0x20){
+			char escape[8];
+			snprintf(escape, sizeof(escape), "\\u%04x",
+				static_cast<unsigned int>(*c));
+			res += escape;
+		} else {
+			res += *c;
+		}
+	}
+	return res + "\"";
+}
+
+void TimeReport::print(std::ostream& out, const char * input) const{
+	double totalSeconds = 0;
+	uint64_t totalAllocs = 0;
+	for (const Phase& row : phases){
+		totalSeconds += row.seconds;
+		totalAllocs += row.allocs;
+	}
+	char line[160];
+	std::string text;
+	if (format == JSON){
+		text += "{\"input\": " + jsonString(input) + ", \"phases\": [";
+		for (size_t i = 0; i < phases.size(); i++){
+			const Phase& row = phases[i];
+			snprintf(line, sizeof(line), "%s\n  {\"name\": ",
+				i == 0 ? "" : ",");
+			text += line;
+			text += jsonString(row.name.c_str());
+			snprintf(line, sizeof(line), ", \"wall_s\": %.6f, "
+				"\"allocs\": %llu, \"peak_rss_kb\": %ld}",
+				row.seconds,
+				static_cast<unsigned long long>(row.allocs), row.peakKB);
+			text += line;
+		}
+		snprintf(line, sizeof(line), "],\n \"total_wall_s\": %.6f, "
+			"\"total_allocs\": %llu, \"peak_rss_kb\": %ld}\n",
+			totalSeconds, static_cast<unsigned long long>(totalAllocs),
+			peakRSS());
+		text += line;
+	} else {
+		//The phase column is as wide as the longest phase name
+		int width = static_cast<int>(strlen("phase"));
+		for (const Phase& row : phases){
+			width = std::max(width, static_cast<int>(row.name.size()));
+		}
+		text += "Time report for ";
+		text += input;
+		snprintf(line, sizeof(line), "\n %-*s %10s %12s %14s\n",
+			width, "phase", "wall (s)", "allocs", "peak RSS (KB)");
+		text += line;
+		for (const Phase& row : phases){
+			snprintf(line, sizeof(line), " %-*s %10.4f %12llu %14ld\n",
+				width, row.name.c_str(), row.seconds,
+				static_cast<unsigned long long>(row.allocs), row.peakKB);
+			text += line;
+		}
+		snprintf(line, sizeof(line), " %-*s %10.4f %12llu %14ld\n",
+			width, "total", totalSeconds,
+			static_cast<unsigned long long>(totalAllocs), peakRSS());
+		text += line;
+	}
+	out.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
+}
@@ -0,0 +1,108 @@
+#ifndef CSHANTY_TIME_REPORT_HPP
+#define CSHANTY_TIME_REPORT_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "trace.hpp"
+
+namespace cshanty{
+
+//What --time-report collects for one compilation: for each phase,
+// its wall time, how many allocations were made while it ran and
+// the process's peak RSS once it was done. A phase that runs more
+// than once (say, unparsing for both -u and -n) is summed into a
+// single row. Phases are timed by PhaseTimer scopes, which report
+// to whichever TimeReport is installed on their thread. Building
+// with -DCSHANTY_NO_TIME_REPORT compiles the timers (and the
+// allocation counter) out altogether. Each timed phase is also
+// a span in the --trace output.
+class TimeReport{
+public:
+	enum Format { TEXT, JSON };
+	TimeReport(Format formatIn) : format(formatIn){ }
+
+	//The report installed on this thread, or nullptr
+	static TimeReport * current(){ return installed(); }
+
+	//Installs a report on this thread for the lifetime of the
+	// Use object
+	class Use{
+	public:
+		Use(TimeReport * report) : prev(installed()){
+			installed() = report;
+		}
+		~Use(){ installed() = prev; }
+	private:
+		TimeReport * prev;
+	};
+
+	void add(const char * phase, double seconds,
+		uint64_t allocs, long peakKB);
+	void print(std::ostream& out, const char * input) const;
+
+	//Allocations made so far by the whole process
+	static uint64_t allocations();
+	//Peak resident set size of the process so far, in KB
+	static long peakRSS();
+private:
+	struct Phase{
+		std::string name;
+		double seconds;
+		uint64_t allocs;
+		long peakKB;
+	};
+	static TimeReport *& installed(){
+		static thread_local TimeReport * report = nullptr;
+		return report;
+	}
+
+	Format format;
+	std::vector<Phase> phases;
+};
+
+//Text as a quoted JSON string, for the JSON report and the trace
+std::string jsonString(const char * text);
+
+//Times the enclosing scope as the named phase, if a report is
+// installed on this thread; otherwise it does nothing. Use it
+// through TIME_PHASE, which disappears when timing is compiled out.
+class PhaseTimer{
+public:
+	explicit PhaseTimer(const char * phaseIn)
+	: report(TimeReport::current()), phase(phaseIn){
+		if (report == nullptr){ return; }
+		allocs = TimeReport::allocations();
+		start = Clock::now();
+	}
+	~PhaseTimer(){
+		if (report == nullptr){ return; }
+		std::chrono::duration<double> spent = Clock::now() - start;
+		report->add(phase, spent.count(),
+			TimeReport::allocations() - allocs, TimeReport::peakRSS());
+	}
+	PhaseTimer(const PhaseTimer&) = delete;
+	PhaseTimer& operator=(const PhaseTimer&) = delete;
+private:
+	using Clock = std::chrono::steady_clock;
+	TimeReport * report;
+	const char * phase;
+	uint64_t allocs = 0;
+	Clock::time_point start;
+};
+
+}
+
+#define TIME_PHASE_CAT2(a, b) a##b
+#define TIME_PHASE_CAT(a, b) TIME_PHASE_CAT2(a, b)
+#ifdef CSHANTY_NO_TIME_REPORT
+#define TIME_PHASE(name) TRACE_SPAN(name)
+#else
+#define TIME_PHASE(name) \
+	TRACE_SPAN(name); \
+	::cshanty::PhaseTimer TIME_PHASE_CAT(phaseTimer, __LINE__)(name)
+#endif
+
+#endif
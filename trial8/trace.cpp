@@ -0,0 +1,154 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <vector>
+#include "errors.hpp"
+#include "time_report.hpp"
+#include "trace.hpp"
+
+namespace cshanty{
+
+namespace{
+
+using Clock = std::chrono::steady_clock;
+
+struct Event{
+	const char * name;
+	//The detail is copied, truncated if need be, so the ring
+	// holds no pointers into the caller's strings
+	char detail[48];
+	uint64_t start;
+	uint64_t duration;
+};
+
+//One thread's spans. Only its own thread writes it: an event goes
+// into the slot after the last one, and only then is the count
+// published, so a reader never sees a half-written event.
+struct TraceBuffer{
+	static const size_t CAPACITY = 1 << 16;
+	TraceBuffer(uint32_t tidIn) : events(CAPACITY), tid(tidIn){ }
+	std::vector<Event> events;
+	std::atomic<uint64_t> written{0};
+	uint32_t tid;
+};
+
+struct TraceState{
+	//Opened by start(), so that a bad path fails before the
+	// compile rather than after it
+	std::ofstream file;
+	Clock::time_point epoch;
+	//Every thread's buffer, kept until the trace is written even
+	// if the thread is gone. The lock is only taken the first
+	// time a thread records a span.
+	std::mutex lock;
+	std::vector<TraceBuffer *> buffers;
+};
+
+TraceState& state(){
+	static TraceState traceState;
+	return traceState;
+}
+
+TraceBuffer * threadBuffer(){
+	static thread_local TraceBuffer * mine = nullptr;
+	if (mine == nullptr){
+		TraceState& trace = state();
+		std::lock_guard<std::mutex> guard(trace.lock);
+		mine = new TraceBuffer(static_cast<uint32_t>(trace.buffers.size() + 1));
+		trace.buffers.push_back(mine);
+	}
+	return mine;
+}
+
+}
+
+void Trace::start(const char * path){
+	TraceState& trace = state();
+	trace.file.open(path);
+	if (!trace.file.good()){
+		std::string msg = "Bad trace file ";
+		msg += path;
+		throw new InternalError(msg.c_str());
+	}
+	trace.epoch = Clock::now();
+	on().store(true, std::memory_order_release);
+}
+
+uint64_t Trace::now(){
+	auto since = Clock::now() - state().epoch;
+	return static_cast<uint64_t>(
+		std::chrono::duration_cast<std::chrono::microseconds>(since).count());
+}
+
+void Trace::record(const char * name, const char * detail,
+	uint64_t start, uint64_t duration){
+	TraceBuffer * buf = threadBuffer();
+	uint64_t idx = buf->written.load(std::memory_order_relaxed);
+	Event& event = buf->events[idx % TraceBuffer::CAPACITY];
+	event.name = name;
+	event.detail[0] = '\0';
+	if (detail != nullptr){
+		strncpy(event.detail, detail, sizeof(event.detail) - 1);
+		event.detail[sizeof(event.detail) - 1] = '\0';
+	}
+	event.start = start;
+	event.duration = duration;
+	buf->written.store(idx + 1, std::memory_order_release);
+}
+
+void Trace::finish(){
+	if (!enabled()){ return; }
+	on().store(false, std::memory_order_release);
+	TraceState& trace = state();
+	std::lock_guard<std::mutex> guard(trace.lock);
+
+	std::string out = "{\"traceEvents\": [";
+	bool first = true;
+	uint64_t dropped = 0;
+	char line[128];
+	for (TraceBuffer * buf : trace.buffers){
+		uint64_t written = buf->written.load(std::memory_order_acquire);
+		uint64_t begin = 0;
+		if (written > TraceBuffer::CAPACITY){
+			begin = written - TraceBuffer::CAPACITY;
+			dropped += begin;
+		}
+		snprintf(line, sizeof(line), "%s\n{\"name\": \"thread_name\", "
+			"\"ph\": \"M\", \"pid\": 1, \"tid\": %u, "
+			"\"args\": {\"name\": \"thread %u\"}}",
+			first ? "" : ",", buf->tid, buf->tid);
+		out += line;
+		first = false;
+		for (uint64_t idx = begin; idx < written; idx++){
+			const Event& event = buf->events[idx % TraceBuffer::CAPACITY];
+			out += ",\n{\"name\": ";
+			std::string name = event.name;
+			if (event.detail[0] != '\0'){
+				name += ' ';
+				name += event.detail;
+			}
+			out += jsonString(name.c_str());
+			snprintf(line, sizeof(line), ", \"cat\": \"cshantyc\", "
+				"\"ph\": \"X\", \"ts\": %llu, \"dur\": %llu, "
+				"\"pid\": 1, \"tid\": %u}",
+				static_cast<unsigned long long>(event.start),
+				static_cast<unsigned long long>(event.duration), buf->tid);
+			out += line;
+		}
+	}
+	snprintf(line, sizeof(line), "\n], \"displayTimeUnit\": \"ms\", "
+		"\"otherData\": {\"dropped_spans\": %llu}}\n",
+		static_cast<unsigned long long>(dropped));
+	out += line;
+
+	trace.file.write(out.data(), static_cast<std::streamsize>(out.size()));
+	trace.file.close();
+
+	//Each buffer is megabytes, and nothing records any more
+	for (TraceBuffer * buf : trace.buffers){ delete buf; }
+	trace.buffers.clear();
+}
+
+}
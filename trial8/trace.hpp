@@ -0,0 +1,85 @@
+#ifndef CSHANTY_TRACE_HPP
+#define CSHANTY_TRACE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace cshanty{
+
+//What --trace records: a span for every TRACE_SPAN scope that runs
+// while tracing is on, written out at the end as Chrome trace-event
+// JSON (load it in chrome://tracing or Perfetto). Spans nest by
+// time, so phases show up around the per-function work inside them.
+// Each thread records into its own ring buffer, which it alone
+// writes, so recording takes no lock; a thread that records more
+// spans than its buffer holds loses its oldest ones. Building with
+// -DCSHANTY_NO_TRACE compiles the spans out.
+class Trace{
+public:
+	//Open path and start recording; finish() writes what was
+	// recorded there. Only one trace can be taken per process.
+	static void start(const char * path);
+	//Stop recording, write the trace and free every thread's
+	// buffer. Every thread that recorded spans must be done by now.
+	static void finish();
+
+	static bool enabled(){
+		return on().load(std::memory_order_relaxed);
+	}
+	//Microseconds since the trace started
+	static uint64_t now();
+	static void record(const char * name, const char * detail,
+		uint64_t start, uint64_t duration);
+private:
+	static std::atomic<bool>& on(){
+		static std::atomic<bool> flag(false);
+		return flag;
+	}
+};
+
+//Records the enclosing scope as a span named name, if tracing is
+// on. A detail (a function's name, say) is appended to the name;
+// a const char * one must outlive the span, while a std::string
+// one is copied (only if tracing is on). Use through TRACE_SPAN.
+class TraceSpan{
+public:
+	explicit TraceSpan(const char * nameIn, const char * detailIn = nullptr)
+	: name(nameIn), detail(detailIn), active(Trace::enabled()){
+		if (active){ start = Trace::now(); }
+	}
+	TraceSpan(const char * nameIn, const std::string& detailIn)
+	: name(nameIn), detail(nullptr), active(Trace::enabled()){
+		if (active){
+			ownDetail = detailIn;
+			detail = ownDetail.c_str();
+			start = Trace::now();
+		}
+	}
+	~TraceSpan(){
+		if (active){
+			Trace::record(name, detail, start, Trace::now() - start);
+		}
+	}
+	TraceSpan(const TraceSpan&) = delete;
+	TraceSpan& operator=(const TraceSpan&) = delete;
+private:
+	const char * name;
+	const char * detail;
+	bool active;
+	uint64_t start = 0;
+	std::string ownDetail;
+};
+
+}
+
+#define TRACE_SPAN_CAT2(a, b) a##b
+#define TRACE_SPAN_CAT(a, b) TRACE_SPAN_CAT2(a, b)
+#ifdef CSHANTY_NO_TRACE
+#define TRACE_SPAN(...)
+#else
+#define TRACE_SPAN(...) \
+	::cshanty::TraceSpan TRACE_SPAN_CAT(traceSpan, __LINE__)(__VA_ARGS__)
+#endif
+
+#endif
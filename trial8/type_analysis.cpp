@@ -1,12 +1,19 @@
 #include <assert.h>
+#include <atomic>
+#include <exception>
+#include <thread>
 
 #include "name_analysis.hpp"
 #include "type_analysis.hpp"
+#include "trace.hpp"
 
 namespace cshanty {
 
-TypeAnalysis * TypeAnalysis::build(NameAnalysis * nameAnalysis){
+TypeAnalysis * TypeAnalysis::build(NameAnalysis * nameAnalysis,
+	uint32_t nodeCount, unsigned int jobs){
 	TypeAnalysis * typeAnalysis = new TypeAnalysis();
+	typeAnalysis->nodeTypes.resize(nodeCount, nullptr);
+	typeAnalysis->jobs = jobs;
 	auto ast = nameAnalysis->ast;	
 	typeAnalysis->ast = ast;
 
@@ -19,10 +26,83 @@ TypeAnalysis * TypeAnalysis::build(NameAnalysis * nameAnalysis){
 
 }
 
+void TypeAnalysis::checkBodies(const std::vector<FnDeclNode *>& fns,
+	unsigned int jobs){
+	size_t count = fns.size();
+	if (jobs > count){ jobs = static_cast<unsigned int>(count); }
+	if (jobs <= 1){
+		for (FnDeclNode * fn : fns){ fn->typeBody(this); }
+		return;
+	}
+
+	//Make every type a body can ask for now, so that the workers
+	// only ever read the universe. (Function and record types all
+	// come from the signatures and declarations.)
+	ErrorType::produce();
+	BasicType::VOID();
+	BasicType::BOOL();
+	BasicType::STRING();
+	BasicType::INT();
+
+	//The bodies share this object's table: each node belongs to
+	// one function, so no slot is written twice, and the table was
+	// sized up front, so it never moves. Everything else a body
+	// produces (diagnostics, failure, an exception) is kept per
+	// function and merged below in declaration order, which is
+	// the order a sequential check would have found it in.
+	TypeUniverse * universe = TypeUniverse::current();
+	Diagnostics * into = Diagnostics::current();
+	size_t limit = into == nullptr ? 0 : into->getLimit();
+	std::vector<Diagnostics> diags(count, Diagnostics(limit));
+	std::vector<char> failed(count, 0);
+	std::vector<std::exception_ptr> thrown(count);
+	std::atomic<size_t> next(0);
+	auto worker = [&](){
+		TypeUniverse::Use inUniverse(universe);
+		for (size_t idx = next++; idx < count; idx = next++){
+			Diagnostics::Use reportTo(&diags[idx]);
+			TypeAnalysis task(this);
+			try {
+				fns[idx]->typeBody(&task);
+			} catch (...) {
+				thrown[idx] = std::current_exception();
+			}
+			failed[idx] = task.hasError;
+		}
+	};
+	std::vector<std::thread> pool;
+	for (unsigned int t = 0; t < jobs; t++){
+		pool.emplace_back(worker);
+	}
+	for (std::thread& thread : pool){
+		thread.join();
+	}
+
+	for (size_t idx = 0; idx < count; idx++){
+		if (into == nullptr){
+			diags[idx].flush(Console::err());
+		} else {
+			into->take(diags[idx]);
+		}
+		if (failed[idx]){ hasError = true; }
+		if (thrown[idx]){ std::rethrow_exception(thrown[idx]); }
+	}
+}
+
 void ProgramNode::typeAnalysis(TypeAnalysis * typing){
-	for (auto decl : *myGlobals){
-		decl->typeAnalysis(typing);
+	//Globals and signatures first; a body may call any function
+	// declared before it, and needs its type
+	std::vector<FnDeclNode *> fns;
+	for (auto decl : myGlobals){
+		FnDeclNode * fn = dynamic_cast<FnDeclNode *>(decl);
+		if (fn == nullptr){
+			decl->typeAnalysis(typing);
+		} else {
+			fn->typeSignature(typing);
+			fns.push_back(fn);
+		}
 	}
+	typing->checkBodies(fns, typing->getJobs());
 	typing->nodeType(this, BasicType::VOID());
 }
 
@@ -48,21 +128,28 @@ void RecordTypeDeclNode::typeAnalysis(TypeAnalysis * typing){
 }
 
 void FnDeclNode::typeAnalysis(TypeAnalysis * typing){
+	typeSignature(typing);
+	typeBody(typing);
+}
+
+void FnDeclNode::typeSignature(TypeAnalysis * typing){
 	myRetType->typeAnalysis(typing);
 	const DataType * retDataType = typing->nodeType(myRetType);
 
-	std::list<const DataType *> * formalTypes = 
-		new std::list<const DataType *>();
-	for (auto formal : *myFormals){
+	std::list<const DataType *> formalTypes;
+	for (auto formal : myFormals){
 		formal->typeAnalysis(typing);
-		formalTypes->push_back(typing->nodeType(formal));
+		formalTypes.push_back(typing->nodeType(formal));
 	}	
 
 	
-	typing->nodeType(this, new FnType(formalTypes, retDataType));
+	typing->nodeType(this, FnType::produce(formalTypes, retDataType));
+}
 
+void FnDeclNode::typeBody(TypeAnalysis * typing){
+	TRACE_SPAN("FnDeclNode::typeBody", myID->getName());
 	typing->setCurrentFnType(typing->nodeType(this)->asFn());
-	for (auto stmt : *myBody){
+	for (auto stmt : myBody){
 		stmt->typeAnalysis(typing);
 	}
 	typing->setCurrentFnType(nullptr);
@@ -157,7 +244,7 @@ void AssignExpNode::typeAnalysis(TypeAnalysis * typing){
 		return;
 	}
 
-	if (dstType == srcType){
+	if (DataType::same(dstType, srcType)){
 		typing->nodeType(this, dstType);
 		return;
 	}
@@ -169,10 +256,10 @@ void AssignExpNode::typeAnalysis(TypeAnalysis * typing){
 
 void CallExpNode::typeAnalysis(TypeAnalysis * typing){
 
-	std::list<const DataType *> * aList = new std::list<const DataType *>();
-	for (auto actual : *myArgs){
+	std::list<const DataType *> aList;
+	for (auto actual : myArgs){
 		actual->typeAnalysis(typing);
-		aList->push_back(typing->nodeType(actual));
+		aList.push_back(typing->nodeType(actual));
 	}
 
 	SemSymbol * calleeSym = myID->getSymbol();
@@ -186,15 +273,15 @@ void CallExpNode::typeAnalysis(TypeAnalysis * typing){
 	}
 
 	const std::list<const DataType *>* fList = fnType->getFormalTypes();
-	if (aList->size() != fList->size()){
+	if (aList.size() != fList->size()){
 		typing->errArgCount(pos());
 		//Note: we still consider the call to return the 
 		// return type
 	} else {
-		auto actualTypesItr = aList->begin();
+		auto actualTypesItr = aList.begin();
 		auto formalTypesItr = fList->begin();
-		auto actualsItr = myArgs->begin();
-		while(actualTypesItr != aList->end()){
+		auto actualsItr = myArgs.begin();
+		while(actualTypesItr != aList.end()){
 			const DataType * actualType = *actualTypesItr;
 			const DataType * formalType = *formalTypesItr;
 			ExpNode * actual = *actualsItr;
@@ -208,12 +295,12 @@ void CallExpNode::typeAnalysis(TypeAnalysis * typing){
 			if (formalType->asError()){ continue; }
 
 			//Ok match
-			if (formalType == actualType){ continue; }
+			if (DataType::same(formalType, actualType)){ continue; }
 
 			const RecordType * formalRec = formalType->asRecord();
 			const RecordType * actualRec = actualType->asRecord();
 			if (formalRec && actualRec){
-				if (formalRec == actualRec){
+				if (DataType::same(formalRec, actualRec)){
 					continue;
 				}
 			}
@@ -315,11 +402,11 @@ void IndexNode::typeAnalysis(TypeAnalysis * typing){
 		return;
 	}
 	
-	const DataType * fieldType = asRec->getField(myIdx->getName());
-	if (fieldType == nullptr){
+	myField = asRec->fieldIndex(myIdx->getName());
+	if (myField == RecordType::NO_FIELD){
 		TODO(No such field!)
 	}
-	typing->nodeType(this, fieldType);
+	typing->nodeType(this, asRec->getField(myField).type);
 	
 	/*
 	const ArrayType * asArray = baseType->asArray();
@@ -489,7 +576,7 @@ void BinaryExpNode::binaryEqTyping(TypeAnalysis * typing){
 		return;
 	}
 
-	if (lhsType == rhsType){
+	if (DataType::same(lhsType, rhsType)){
 		typing->nodeType(this, BasicType::BOOL());
 		return;
 	}
@@ -723,7 +810,7 @@ void IfStmtNode::typeAnalysis(TypeAnalysis * typing){
 			ErrorType::produce());
 	}
 
-	for (auto stmt : *myBody){
+	for (auto stmt : myBody){
 		stmt->typeAnalysis(typing);
 	}
 
@@ -746,10 +833,10 @@ void IfElseStmtNode::typeAnalysis(TypeAnalysis * typing){
 		typing->errIfCond(myCond->pos());
 		goodCond = false;
 	}
-	for (auto stmt : *myBodyTrue){
+	for (auto stmt : myBodyTrue){
 		stmt->typeAnalysis(typing);
 	}
-	for (auto stmt : *myBodyFalse){
+	for (auto stmt : myBodyFalse){
 		stmt->typeAnalysis(typing);
 	}
 	
@@ -770,7 +857,7 @@ void WhileStmtNode::typeAnalysis(TypeAnalysis * typing){
 		typing->errWhileCond(myCond->pos());
 	}
 
-	for (auto stmt : *myBody){
+	for (auto stmt : myBody){
 		stmt->typeAnalysis(typing);
 	}
 
@@ -787,7 +874,7 @@ void ReturnStmtNode::typeAnalysis(TypeAnalysis * typing){
 	const DataType * fnRet = fnType->getReturnType();
 
 	//Check: shouldn't return anything
-	if (fnRet == BasicType::VOID()){
+	if (DataType::same(fnRet, BasicType::VOID())){
 		if (myExp != nullptr) {
 			myExp->typeAnalysis(typing);
 			typing->extraRetValue(myExp->pos());
@@ -1,6 +1,8 @@
 #ifndef XXLANG_TYPE_ANALYSIS
 #define XXLANG_TYPE_ANALYSIS
 
+#include <algorithm>
+#include <vector>
 #include "ast.hpp"
 #include "symbol_table.hpp"
 #include "types.hpp"
@@ -11,21 +13,36 @@ namespace cshanty{
 
 // An instance of this class will be passed over the entire
 // AST. Rather than attaching types to each node, the 
-// TypeAnalysis class contains a map from each ASTNode to it's
+// TypeAnalysis class contains a table from each ASTNode to it's
 // DataType. Thus, instead of attaching a type field to most nodes,
 // one can instead map the node to it's type, or lookup the node
-// in the map.
+// in the table. The table is a vector indexed by the node's
+// dense ID (see Arena::makeNode).
 class TypeAnalysis {
 
 private:
 	//The private constructor here means that the type analysis
 	// can only be created via the static build function
 	TypeAnalysis(){
+		table = &nodeTypes;
+		currentFnType = nullptr;
+		hasError = false;
+	}
+	//A context for checking one function body in parallel with
+	// the others. It types nodes straight into the parent's table,
+	// but keeps its own current function and error flag.
+	explicit TypeAnalysis(TypeAnalysis * parent){
+		table = parent->table;
+		currentFnType = nullptr;
 		hasError = false;
 	}
 
 public:
-	static TypeAnalysis * build(NameAnalysis * astRoot);
+	//nodeCount (the arena's) sizes the per-node table up front.
+	// With jobs > 1, function bodies are checked on up to that
+	// many threads once every signature is known.
+	static TypeAnalysis * build(NameAnalysis * astRoot,
+		uint32_t nodeCount, unsigned int jobs = 1);
 	//static TypeAnalysis * build();
 
 	//The type analysis has an instance variable to say whether
@@ -36,6 +53,11 @@ public:
 		return !hasError;
 	}
 
+	//How many threads may check function bodies at once
+	unsigned int getJobs(){
+		return jobs;
+	}
+
 	void setCurrentFnType(const FnType * type){
 		currentFnType = type;
 	}
@@ -47,22 +69,31 @@ public:
 	
 	//Set the type of a node. Note that the function name is 
 	// overloaded: this 2-argument nodeType puts a value into the
-	// map with a given type. 
+	// table with a given type. 
 	void nodeType(const ASTNode * node, const DataType * type){
-		nodeToType[node] = type;
+		size_t id = node->nodeID();
+		if (id >= table->size()){
+			table->resize(std::max(id + 1, 2 * table->size()));
+		}
+		(*table)[id] = type;
 	}
 
-	//Gets the type of a node already placed in the map. Note
+	//Gets the type of a node already placed in the table. Note
 	// that this function name is overloaded: the 1-argument nodeType
-	// gets the type of the given node out of the map.
+	// gets the type of the given node out of the table.
 	const DataType * nodeType(const ASTNode * node){
-		auto res = nodeToType.find(node);
-		assert(res != nodeToType.end() || "No type for node");
-		
+		size_t id = node->nodeID();
 		//Note: this actually could be nullptr
-		return res->second;
+		if (id >= table->size()){ return nullptr; }
+		return (*table)[id];
 	}
 
+	//Type-check the given function bodies (whose signatures have
+	// already been typed) on up to jobs threads. Each body's
+	// diagnostics are held back and reported in the order of fns.
+	void checkBodies(const std::vector<FnDeclNode *>& fns,
+		unsigned int jobs);
+
 	//The following functions all report and error and 
 	// tell the object that the analysis has failed. 
 	void errWriteFn(Position * pos){
@@ -221,7 +252,12 @@ public:
 		Report::fatal(pos, "Bad index");
 	}
 private:
-	HashMap<const ASTNode *, const DataType *> nodeToType;
+	friend class ASTReader;
+	//Indexed by node ID; nullptr for untyped nodes. table points
+	// at nodeTypes, or at the parent's for a per-function context.
+	std::vector<const DataType *> nodeTypes;
+	std::vector<const DataType *> * table;
+	unsigned int jobs = 1;
 	const FnType * currentFnType;
 	bool hasError;
 public:
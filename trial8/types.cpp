@@ -6,6 +6,95 @@
 
 namespace cshanty{
 
+TypeUniverse::TypeUniverse() : basics(), error(nullptr){ }
+
+TypeUniverse::~TypeUniverse(){
+	for (DataType * type : types){ delete type; }
+}
+
+size_t TypeUniverse::IDListHash::operator()(
+	const std::vector<uint32_t>& ids) const{
+	size_t hash = ids.size();
+	for (uint32_t id : ids){
+		hash ^= id + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	}
+	return hash;
+}
+
+const FnType * FnType::produce(
+	const std::list<const DataType *>& formals,
+	const DataType * retType){
+	TypeUniverse * universe = TypeUniverse::current();
+	std::vector<uint32_t> key;
+	key.reserve(formals.size() + 1);
+	key.push_back(retType == nullptr ? 0 : retType->typeID());
+	for (const DataType * formal : formals){
+		key.push_back(formal == nullptr ? 0 : formal->typeID());
+	}
+	FnType *& fn = universe->fns[key];
+	if (fn == nullptr){
+		auto formalsCopy = new std::list<const DataType *>(formals);
+		fn = universe->intern(new FnType(formalsCopy, retType));
+	}
+	return fn;
+}
+
+TypeUniverse *& TypeUniverse::installed(){
+	static thread_local TypeUniverse * universe = nullptr;
+	return universe;
+}
+
+TypeUniverse * TypeUniverse::current(){
+	TypeUniverse *& universe = installed();
+	if (universe == nullptr){
+		//Code that never installs a universe (a single
+		// compilation on the main thread, say) gets one per
+		// thread that lasts until the thread exits
+		static thread_local TypeUniverse fallback;
+		universe = &fallback;
+	}
+	return universe;
+}
+
+TypeUniverse::Use::Use(TypeUniverse * universe) : prev(installed()){
+	installed() = universe;
+}
+
+TypeUniverse::Use::~Use(){
+	installed() = prev;
+}
+
+const size_t RecordType::NO_FIELD;
+
+RecordType::RecordType(std::string nameIn, std::vector<RecordField> fieldsIn)
+: name(nameIn), myFields(fieldsIn), mySize(0), myAlign(1){
+	for (RecordField& field : myFields){
+		size_t align = alignmentOf(field.type);
+		field.size = field.type->getSize();
+		field.offset = (mySize + align - 1) / align * align;
+		mySize = field.offset + field.size;
+		if (align > myAlign){ myAlign = align; }
+	}
+	mySize = (mySize + myAlign - 1) / myAlign * myAlign;
+}
+
+size_t RecordType::alignmentOf(const DataType * type){
+	if (const RecordType * record = type->asRecord()){
+		return record->getAlignment();
+	}
+	size_t size = type->getSize();
+	if (size == 0){ return 1; }
+	return size < 8 ? size : 8;
+}
+
+size_t RecordType::fieldIndex(const std::string& fieldName) const{
+	//Records are small, so a scan beats hashing here
+	for (size_t i = 0; i < myFields.size(); i++){
+		if (myFields[i].name == fieldName){ return i; }
+	}
+	return NO_FIELD;
+}
+
 std::string BasicType::getString() const{
 	std::string res = "";
 	switch(myBaseType){
@@ -1,8 +1,10 @@
 #ifndef CSHANTY_DATA_TYPES
 #define CSHANTY_DATA_TYPES
 
+#include <cstdint>
 #include <list>
 #include <sstream>
+#include <vector>
 #include "errors.hpp"
 
 #include <unordered_map>
@@ -19,6 +21,7 @@ namespace cshanty{
 
 class ASTNode;
 
+class DataType;
 class BasicType;
 class FnType;
 class ErrorType;
@@ -28,12 +31,63 @@ enum BaseType{
 	INT, VOID, STRING, BOOL
 };
 
+//The interner behind the produce() functions below. Every type
+// is made exactly once per universe (so basic, record and function
+// types are all hash-consed), gets a small integer ID, and is owned
+// by the universe until it is destroyed. Each compilation owns one
+// universe, so that files compiled side by side on different
+// threads never share (or race on) their types, and a record type
+// in one file cannot collide with a same-named record in another.
+// produce() uses whichever universe is installed on the calling
+// thread.
+class TypeUniverse{
+public:
+	TypeUniverse();
+	~TypeUniverse();
+	static TypeUniverse * current();
+
+	//Installs a universe on this thread for the lifetime of
+	// the Use object
+	class Use{
+	public:
+		Use(TypeUniverse * universe);
+		~Use();
+	private:
+		TypeUniverse * prev;
+	};
+
+	//How many distinct types have been made (IDs run from 1)
+	size_t size() const { return types.size(); }
+private:
+	friend class BasicType;
+	friend class ErrorType;
+	friend class RecordType;
+	friend class FnType;
+	static TypeUniverse *& installed();
+	//Give a new type the next ID and take ownership of it
+	template <typename T>
+	T * intern(T * type);
+
+	//Function types are keyed on the IDs of their return type
+	// and formal types, in that order (0 for a missing type)
+	struct IDListHash{
+		size_t operator()(const std::vector<uint32_t>& ids) const;
+	};
+
+	std::vector<DataType *> types;
+	BasicType * basics[4];
+	ErrorType * error;
+	HashMap<std::string, RecordType *> records;
+	std::unordered_map<std::vector<uint32_t>, FnType *, IDListHash> fns;
+};
+
 //This class is the superclass for all cshanty types. You
 // can get information about which type is implemented
 // concretely using the as<X> functions, or query information
 // using the is<X> functions.
 class DataType{
 public:
+	virtual ~DataType(){ }
 	virtual std::string getString() const = 0;
 	virtual const BasicType * asBasic() const { return nullptr; }
 	virtual const RecordType * asRecord() const { return nullptr; }
@@ -46,21 +100,33 @@ public:
 	virtual bool isRecord() const { return false; }
 	virtual bool validVarType() const = 0 ;
 	virtual size_t getSize() const = 0;
-protected:
+
+	//This type's ID within its universe (never 0). Since types
+	// are interned, two types are the same exactly when their
+	// IDs are equal.
+	uint32_t typeID() const { return myTypeID; }
+	static bool same(const DataType * a, const DataType * b){
+		if (a == nullptr || b == nullptr){ return a == b; }
+		return a->myTypeID == b->myTypeID;
+	}
+private:
+	friend class TypeUniverse;
+	uint32_t myTypeID = 0;
 };
 
 //This DataType subclass is the superclass for all cshanty types. 
-// Note that there is exactly one instance of this 
+// Note that there is exactly one instance of this per compilation
 class ErrorType : public DataType{
 public:
 	static ErrorType * produce(){
-		//Note: this static member will only ever be initialized 
-		// ONCE, no matter how many times the function is called.
-		// That means there will only ever be 1 instance of errorType
-		// in the entire codebase.
-		static ErrorType * error = new ErrorType();
-		
-		return error;
+		//Note: the instance is created the first time it is
+		// asked for, so there will only ever be 1 instance of
+		// errorType in the current TypeUniverse.
+		TypeUniverse * universe = TypeUniverse::current();
+		if (universe->error == nullptr){
+			universe->error = universe->intern(new ErrorType());
+		}
+		return universe->error;
 	}
 	virtual const ErrorType * asError() const override { return this; }
 	virtual std::string getString() const override { 
@@ -107,20 +173,15 @@ public:
 	// means that no instance of BasicType is needed to call
 	// the function.
 	static BasicType * produce(BaseType base){
-		//Note the use of the static local variable, which
-		//means that the flyweights variable persists between
-		// multiple calls to this function (it is essentially
-		// a global variable that can only be accessed
-		// in this function).
-		static std::list<BasicType *> flyweights;
-		for(BasicType * fly : flyweights){
-			if (fly->getBaseType() == base){
-				return fly;
-			}
+		//The flyweights live in the current TypeUniverse, which
+		// persists between calls to this function for as long
+		// as the compilation that owns it.
+		TypeUniverse * universe = TypeUniverse::current();
+		BasicType *& fly = universe->basics[base];
+		if (fly == nullptr){
+			fly = universe->intern(new BasicType(base));
 		}
-		BasicType * newType = new BasicType(base);
-		flyweights.push_back(newType);
-		return newType;
+		return fly;
 	}
 	const BasicType * asBasic() const override {
 		return this;
@@ -158,17 +219,32 @@ private:
 	BaseType myBaseType;
 };
 
+//One field of a record type, as laid out in memory
+struct RecordField{
+	std::string name;
+	const DataType * type;
+	size_t offset;
+	size_t size;
+};
+
+//A record's layout is fixed when the record is declared: fields
+// sit in declaration order, each at an offset aligned for its
+// type, and the total size is padded to the record's alignment.
+// Analysis turns a field name into an index once (fieldIndex);
+// everything after that works from the index.
 class RecordType : public DataType{
 public:
-	//static RecordType * produce(std::list<DataType *>, std::string name){
-	static RecordType * produce(std::string name, HashMap<std::string, const DataType *> * fields){
-		static HashMap <std::string, RecordType *> map;
+	static const size_t NO_FIELD = SIZE_MAX;
+
+	//fields gives each field's name and type, in declaration
+	// order; offsets and sizes are filled in here
+	static RecordType * produce(std::string name, std::vector<RecordField> fields){
+		TypeUniverse * universe = TypeUniverse::current();
+		HashMap <std::string, RecordType *>& map = universe->records;
 
-		//TODO: find a node
-		RecordType * r;
 		auto res = map.find(name);
 		if (res == map.end()){
-			RecordType * r = new RecordType(name, fields);
+			RecordType * r = universe->intern(new RecordType(name, fields));
 			map[name] = r;
 			return r;
 		} else {
@@ -177,53 +253,40 @@ public:
 	};
 	bool validVarType() const override { return true; }
 	std::string getString() const override { return name; }
-	size_t getSize() const override { 
-		size_t size = 0;
-		for (auto field : *fieldTypes){
-			const DataType * fieldType = field.second;
-			size += fieldType->getSize();
-		}
-		return size;
-	}
+	size_t getSize() const override { return mySize; }
+	size_t getAlignment() const { return myAlign; }
 	const RecordType * asRecord() const override { return this; }
 	bool isRecord() const override { return true; }
 
-	const DataType * getField(std::string fieldName) const{
-		auto res = fieldTypes->find(fieldName);
-		if (res == fieldTypes->end()){ return nullptr; }
-		return res->second;
-	}
-	size_t getOffset(std::string name) const {
-		auto itr = offset.find(name);
-		const size_t fieldOff = itr->second;
-		return fieldOff;
-	}
-private:
-	RecordType(std::string nameIn, HashMap<std::string, const DataType *> * fieldsIn) 
-	: name(nameIn), fieldTypes(fieldsIn){ 
-		size_t usedOffset = 0;
-		for (auto field : *fieldTypes){
-			std::string name = field.first;
-			const DataType * fieldType = field.second;
-			offset[name] = usedOffset;
-			usedOffset += fieldType->getSize();
+	size_t numFields() const { return myFields.size(); }
+	const RecordField& getField(size_t index) const{
+		if (index >= myFields.size()){
+			throw new InternalError("Bad record field index");
 		}
+		return myFields[index];
 	}
+	//The index of the named field, or NO_FIELD
+	size_t fieldIndex(const std::string& fieldName) const;
+private:
+	RecordType(std::string nameIn, std::vector<RecordField> fieldsIn);
+	static size_t alignmentOf(const DataType * type);
+
 	std::string name;
-	HashMap<std::string, const DataType *> *fieldTypes;
-	HashMap<std::string, size_t> offset;
+	std::vector<RecordField> myFields;
+	size_t mySize;
+	size_t myAlign;
 };
 
 //DataType subclass to represent the type of a function. It will
 // have a list of argument types and a return type. 
 class FnType : public DataType{
 public:
-	FnType(const std::list<const DataType *>* formalsIn, const DataType * retTypeIn) 
-	: DataType(),
-	  myFormalTypes(formalsIn),
-	  myRetType(retTypeIn)
-	{
-	}
+	//The one function type with these formal and return types,
+	// made the first time it is asked for
+	static const FnType * produce(
+		const std::list<const DataType *>& formals,
+		const DataType * retType);
+	~FnType(){ delete myFormalTypes; }
 	std::string getString() const override{
 		std::string result = "";
 		bool first = true;
@@ -247,10 +310,23 @@ public:
 	virtual bool validVarType() const override { return false; }
 	virtual size_t getSize() const override { return 0; }
 private:
+	FnType(const std::list<const DataType *>* formalsIn, const DataType * retTypeIn) 
+	: DataType(),
+	  myFormalTypes(formalsIn),
+	  myRetType(retTypeIn)
+	{
+	}
 	const std::list<const DataType *> * myFormalTypes;
 	const DataType * myRetType;
 };
 
+template <typename T>
+T * TypeUniverse::intern(T * type){
+	types.push_back(type);
+	type->myTypeID = static_cast<uint32_t>(types.size());
+	return type;
+}
+
 }
 
 #endif
@@ -3,17 +3,17 @@
 
 namespace cshanty{
 
-static void doIndent(std::ostream& out, int indent){
+static void doIndent(OutputSink& out, int indent){
 	for (int k = 0 ; k < indent; k++){ out << "\t"; }
 }
 
-void ProgramNode::unparse(std::ostream& out, int indent){
-	for (DeclNode * decl : *myGlobals){
+void ProgramNode::unparse(OutputSink& out, int indent){
+	for (DeclNode * decl : myGlobals){
 		decl->unparse(out, indent);
 	}
 }
 
-void VarDeclNode::unparse(std::ostream& out, int indent){
+void VarDeclNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent); 
 	myType->unparse(out, 0);
 	out << " ";
@@ -21,118 +21,118 @@ void VarDeclNode::unparse(std::ostream& out, int indent){
 	out << ";\n";
 }
 
-void RecordTypeDeclNode::unparse(std::ostream& out, int indent){
+void RecordTypeDeclNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent); 
 	out << "struct ";
 	myID->unparse(out, 0);
 	out << "{\n";
-	for(auto field : *myFields){
+	for(auto field : myFields){
 		field->unparse(out, 1);
 	}
 	out << "}\n";
 }
 
-void FormalDeclNode::unparse(std::ostream& out, int indent){
+void FormalDeclNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent); 
 	getTypeNode()->unparse(out, 0);
 	out << " ";
 	ID()->unparse(out, 0);
 }
 
-void FnDeclNode::unparse(std::ostream& out, int indent){
+void FnDeclNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent); 
 	myRetType->unparse(out, 0); 
 	out << " ";
 	myID->unparse(out, 0);
 	out << "(";
 	bool firstFormal = true;
-	for(auto formal : *myFormals){
+	for(auto formal : myFormals){
 		if (firstFormal) { firstFormal = false; }
 		else { out << ", "; }
 		formal->unparse(out, 0);
 	}
 	out << "){\n";
-	for(auto stmt : *myBody){
+	for(auto stmt : myBody){
 		stmt->unparse(out, indent+1);
 	}
 	doIndent(out, indent);
 	out << "}\n";
 }
 
-void AssignStmtNode::unparse(std::ostream& out, int indent){
+void AssignStmtNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	myExp->unparse(out,0);
 	out << ";\n";
 }
 
-void ReceiveStmtNode::unparse(std::ostream& out, int indent){
+void ReceiveStmtNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	out << "std::cin >> ";
 	myDst->unparse(out,0);
 	out << ";\n";
 }
 
-void ReportStmtNode::unparse(std::ostream& out, int indent){
+void ReportStmtNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	out << "report ";
 	mySrc->unparse(out,0);
 	out << ";\n";
 }
 
-void PostIncStmtNode::unparse(std::ostream& out, int indent){
+void PostIncStmtNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	myLVal->unparse(out,0);
 	out << "++;\n";
 }
 
-void PostDecStmtNode::unparse(std::ostream& out, int indent){
+void PostDecStmtNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	myLVal->unparse(out,0);
 	out << "--;\n";
 }
 
-void IfStmtNode::unparse(std::ostream& out, int indent){
+void IfStmtNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	out << "if (";
 	myCond->unparse(out, 0);
 	out << "){\n";
-	for (auto stmt : *myBody){
+	for (auto stmt : myBody){
 		stmt->unparse(out, indent + 1);
 	}
 	doIndent(out, indent);
 	out << "}\n";
 }
 
-void IfElseStmtNode::unparse(std::ostream& out, int indent){
+void IfElseStmtNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	out << "if (";
 	myCond->unparse(out, 0);
 	out << "){\n";
-	for (auto stmt : *myBodyTrue){
+	for (auto stmt : myBodyTrue){
 		stmt->unparse(out, indent + 1);
 	}
 	doIndent(out, indent);
 	out << "} else {\n";
-	for (auto stmt : *myBodyFalse){
+	for (auto stmt : myBodyFalse){
 		stmt->unparse(out, indent + 1);
 	}
 	doIndent(out, indent);
 	out << "}\n";
 }
 
-void WhileStmtNode::unparse(std::ostream& out, int indent){
+void WhileStmtNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	out << "while (";
 	myCond->unparse(out, 0);
 	out << "){\n";
-	for (auto stmt : *myBody){
+	for (auto stmt : myBody){
 		stmt->unparse(out, indent + 1);
 	}
 	doIndent(out, indent);
 	out << "}\n";
 }
 
-void ReturnStmtNode::unparse(std::ostream& out, int indent){
+void ReturnStmtNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	out << "return";
 	if (myExp != nullptr){
@@ -142,36 +142,36 @@ void ReturnStmtNode::unparse(std::ostream& out, int indent){
 	out << ";\n";
 }
 
-void CallStmtNode::unparse(std::ostream& out, int indent){
+void CallStmtNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	myCallExp->unparse(out, 0);
 	out << ";\n";
 }
 
-void ExpNode::unparseNested(std::ostream& out){
+void ExpNode::unparseNested(OutputSink& out){
 	out << "(";
 	unparse(out, 0);
 	out << ")";
 }
 
-void CallExpNode::unparse(std::ostream& out, int indent){
+void CallExpNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	myID->unparse(out, 0);
 	out << "(";
 	
 	bool firstArg = true;
-	for(auto arg : *myArgs){
+	for(auto arg : myArgs){
 		if (firstArg) { firstArg = false; }
 		else { out << ", "; }
 		arg->unparse(out, 0);
 	}
 	out << ")";
 }
-void CallExpNode::unparseNested(std::ostream& out){
+void CallExpNode::unparseNested(OutputSink& out){
 	unparse(out, 0);
 }
 
-void IndexNode::unparse(std::ostream& out, int indent){
+void IndexNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	myBase->unparseNested(out);
 	out << "[";
@@ -179,139 +179,139 @@ void IndexNode::unparse(std::ostream& out, int indent){
 	out << "]";
 }
 
-void MinusNode::unparse(std::ostream& out, int indent){
+void MinusNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	myExp1->unparseNested(out); 
 	out << " - ";
 	myExp2->unparseNested(out);
 }
 
-void PlusNode::unparse(std::ostream& out, int indent){
+void PlusNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	myExp1->unparseNested(out); 
 	out << " + ";
 	myExp2->unparseNested(out);
 }
 
-void TimesNode::unparse(std::ostream& out, int indent){
+void TimesNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	myExp1->unparseNested(out); 
 	out << " * ";
 	myExp2->unparseNested(out);
 }
 
-void DivideNode::unparse(std::ostream& out, int indent){
+void DivideNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	myExp1->unparseNested(out); 
 	out << " / ";
 	myExp2->unparseNested(out);
 }
 
-void AndNode::unparse(std::ostream& out, int indent){
+void AndNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	myExp1->unparseNested(out); 
 	out << " && ";
 	myExp2->unparseNested(out);
 }
 
-void OrNode::unparse(std::ostream& out, int indent){
+void OrNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	myExp1->unparseNested(out); 
 	out << " || ";
 	myExp2->unparseNested(out);
 }
 
-void EqualsNode::unparse(std::ostream& out, int indent){
+void EqualsNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	myExp1->unparseNested(out); 
 	out << " == ";
 	myExp2->unparseNested(out);
 }
 
-void NotEqualsNode::unparse(std::ostream& out, int indent){
+void NotEqualsNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	myExp1->unparseNested(out); 
 	out << " != ";
 	myExp2->unparseNested(out);
 }
 
-void GreaterNode::unparse(std::ostream& out, int indent){
+void GreaterNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	myExp1->unparseNested(out); 
 	out << " > ";
 	myExp2->unparseNested(out);
 }
 
-void GreaterEqNode::unparse(std::ostream& out, int indent){
+void GreaterEqNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	myExp1->unparseNested(out); 
 	out << " >= ";
 	myExp2->unparseNested(out);
 }
 
-void LessNode::unparse(std::ostream& out, int indent){
+void LessNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	myExp1->unparseNested(out); 
 	out << " < ";
 	myExp2->unparseNested(out);
 }
 
-void LessEqNode::unparse(std::ostream& out, int indent){
+void LessEqNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	myExp1->unparseNested(out); 
 	out << " <= ";
 	myExp2->unparseNested(out);
 }
 
-void NotNode::unparse(std::ostream& out, int indent){
+void NotNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	out << "!";
 	myExp->unparseNested(out); 
 }
 
-void NegNode::unparse(std::ostream& out, int indent){
+void NegNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	out << "-";
 	myExp->unparseNested(out); 
 }
 
-void VoidTypeNode::unparse(std::ostream& out, int indent){
+void VoidTypeNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	out << "void";
 }
 
-void IntTypeNode::unparse(std::ostream& out, int indent){
+void IntTypeNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	out << "int";
 }
 
-void StringTypeNode::unparse(std::ostream& out, int indent){
+void StringTypeNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	out << "string";
 }
 
-void RecordTypeNode::unparse(std::ostream& out, int indent){
+void RecordTypeNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	out << myID->getName();
 }
 
-void BoolTypeNode::unparse(std::ostream& out, int indent){
+void BoolTypeNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	out << "bool";
 }
 
-void AssignExpNode::unparse(std::ostream& out, int indent){
+void AssignExpNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	myDst->unparseNested(out);
 	out << " = ";
 	mySrc->unparseNested(out);
 }
 
-void LValNode::unparseNested(std::ostream& out){
+void LValNode::unparseNested(OutputSink& out){
 	unparse(out, 0);
 }
 
-void IDNode::unparse(std::ostream& out, int indent){
+void IDNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	out << name;
 	if (mySymbol != nullptr){
@@ -321,22 +321,22 @@ void IDNode::unparse(std::ostream& out, int indent){
 	}
 }
 
-void IntLitNode::unparse(std::ostream& out, int indent){
+void IntLitNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	out << myNum;
 }
 
-void StrLitNode::unparse(std::ostream& out, int indent){
+void StrLitNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	out << myStr;
 }
 
-void FalseNode::unparse(std::ostream& out, int indent){
+void FalseNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	out << "false";
 }
 
-void TrueNode::unparse(std::ostream& out, int indent){
+void TrueNode::unparse(OutputSink& out, int indent){
 	doIndent(out, indent);
 	out << "true";
 }
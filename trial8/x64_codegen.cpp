@@ -1,9 +1,9 @@
-#include <ostream>
 #include "3ac.hpp"
+#include "trace.hpp"
 
 namespace cshanty{
 
-void IRProgram::allocGlobals(std::ostream& out){
+void IRProgram::allocGlobals(OutputSink& out){
 	if (!procs->size()) return;
 	std::string globl = "_start";
 	for (auto i : *procs) {
@@ -13,30 +13,32 @@ void IRProgram::allocGlobals(std::ostream& out){
 	out << ".globl " << globl << "\n";
 }
 
-void IRProgram::datagenX64(std::ostream& out){
+void IRProgram::datagenX64(OutputSink& out){
 	out << ".data\n";
 	for (auto str : strings) {
 		out << "\t" << str.first->valString() << ": .asciz " << str.second << "\n";
 	}
 	for (auto i : this->globals) {
-		if (i.first->getKind() == SymbolKind::VAR) {
-			if (i.first->getDataType()->asRecord()) {
+		const SemSymbol * sym = i->getSym();
+		if (sym->getKind() == SymbolKind::VAR) {
+			if (sym->getDataType()->asRecord()) {
 				// if its a record instance, add adjacent data for all its fields
-				for (size_t j = 0; j < i.first->getDataType()->asRecord()->getSize()/8; j++) {
-					out << "\tvar_" << i.second->getName() << "_f" << j << ": .quad 0\n";
-					i.second->setMemoryLoc("var_" + i.second->getName() + "_f" + std::to_string(j));
+				for (size_t j = 0; j < sym->getDataType()->asRecord()->getSize()/8; j++) {
+					out << "\tvar_" << i->getName() << "_f" << j << ": .quad 0\n";
 				}
+				// field offsets count up from the first one
+				i->setMemoryLoc("var_" + i->getName() + "_f0");
 			} 
 			else {
-				out << "\tvar_" << i.second->getName() << ": .quad 0\n";
-				i.second->setMemoryLoc("var_" + i.second->getName());
+				out << "\tvar_" << i->getName() << ": .quad 0\n";
+				i->setMemoryLoc("var_" + i->getName());
 			}
 		}
 	}
 	out << "\t.align 8\n";
 }
 
-void IRProgram::toX64(std::ostream& out){
+void IRProgram::toX64(OutputSink& out){
 	datagenX64(out);
 	allocGlobals(out);
 	out << ".text\n";
@@ -53,8 +55,8 @@ void Procedure::allocLocals(){
 		dist += loc;
 	}
 	for (auto i : this->locals) {
-		int loc = i.second->getWidth();
-		i.second->setMemoryLoc("-" + std::to_string(dist + loc) + "(%rbp)");
+		int loc = i->getWidth();
+		i->setMemoryLoc("-" + std::to_string(dist + loc) + "(%rbp)");
 		dist += loc;
 	}
 	for (auto i : this->temps) {
@@ -69,7 +71,8 @@ void Procedure::allocLocals(){
 	}
 }
 
-void Procedure::toX64(std::ostream& out){
+void Procedure::toX64(OutputSink& out){
+	TRACE_SPAN("Procedure::toX64", getName());
 	//Allocate all locals
 	allocLocals();
 
@@ -84,7 +87,7 @@ void Procedure::toX64(std::ostream& out){
 	leave->codegenX64(out);
 }
 
-void Quad::codegenLabels(std::ostream& out){
+void Quad::codegenLabels(OutputSink& out){
 	if (labels.empty()){ return; }
 
 	size_t numLabels = labels.size();
@@ -96,7 +99,25 @@ void Quad::codegenLabels(std::ostream& out){
 	}
 }
 
-void BinOpQuad::codegenX64(std::ostream& out){
+//The scale of the lea that multiplies a register by the literal,
+// or 0 if there is none
+static int leaScale(Opd * opd){
+	LitOpd * lit = dynamic_cast<LitOpd *>(opd);
+	if (lit == nullptr){ return 0; }
+	std::string val = lit->valString();
+	if (val == "3"){ return 2; }
+	if (val == "5"){ return 4; }
+	if (val == "9"){ return 8; }
+	return 0;
+}
+
+void BinOpQuad::codegenX64(OutputSink& out){
+	if (opr == BinOp::MULT64 && leaScale(src2) != 0){
+		src1->genLoadVal(out,A);
+		out << "\tleaq (%rax,%rax," << leaScale(src2) << "), %rax\n\t";
+		dst->genStoreVal(out,A);
+		return;
+	}
 	src1->genLoadVal(out,A);
 	out << "\t";
 	src2->genLoadVal(out,B);
@@ -108,7 +129,9 @@ void BinOpQuad::codegenX64(std::ostream& out){
 		out << "\tsubq " << src1->getReg(B) << ", " << src2->getReg(A) << "\n\t";
 		break;
 	case BinOp::DIV64:
-		out << "\tdivq " << src1->getReg(B) << "\n\t";
+		//Signed: sign-extend %rax into %rdx first
+		out << "\tcqto\n\t";
+		out << "idivq " << src1->getReg(B) << "\n\t";
 		break;
 	case BinOp::MULT64:
 		out << "\timulq " << src1->getReg(B) << "\n\t";
@@ -146,7 +169,7 @@ void BinOpQuad::codegenX64(std::ostream& out){
 	case BinOp::GTE64:
 		out << "\tmovq $0, %rcx\n\t";
 		out << "cmpq " << src2->getReg(B) << ", " << src1->getReg(A) << "\n\t";
-		out << "setgt %cl\n\t";
+		out << "setge %cl\n\t";
 		out << "movq %rcx, %rax\n\t";
 		break;
 	case BinOp::OR64:
@@ -155,12 +178,24 @@ void BinOpQuad::codegenX64(std::ostream& out){
 	case BinOp::AND64:
 		out << "\tandq " << src1->getReg(B) << ", " << src2->getReg(A) << "\n\t";
 		break;
+	case BinOp::SHL64:
+		out << "\tmovq %rbx, %rcx\n\t";
+		out << "salq %cl, " << src1->getReg(A) << "\n\t";
+		break;
+	case BinOp::SAR64:
+		out << "\tmovq %rbx, %rcx\n\t";
+		out << "sarq %cl, " << src1->getReg(A) << "\n\t";
+		break;
+	case BinOp::SHR64:
+		out << "\tmovq %rbx, %rcx\n\t";
+		out << "shrq %cl, " << src1->getReg(A) << "\n\t";
+		break;
 	default: break;
 	}
 	dst->genStoreVal(out,A);
 }
 
-void UnaryOpQuad::codegenX64(std::ostream& out){
+void UnaryOpQuad::codegenX64(OutputSink& out){
 	src->genLoadVal(out, A);
 	switch (op) {
 	case UnaryOp::NEG64: 
@@ -174,17 +209,17 @@ void UnaryOpQuad::codegenX64(std::ostream& out){
 	dst->genStoreVal(out,A);
 }
 
-void AssignQuad::codegenX64(std::ostream& out){
+void AssignQuad::codegenX64(OutputSink& out){
 	src->genLoadVal(out, A);
 	out << "\t";
 	dst->genStoreVal(out, A);
 }
 
-void GotoQuad::codegenX64(std::ostream& out){
+void GotoQuad::codegenX64(OutputSink& out){
 	out << "jmp " << tgt->getName() << "\n";
 }
 
-void IfzQuad::codegenX64(std::ostream& out){
+void IfzQuad::codegenX64(OutputSink& out){
 	if (cnd->valString() == "0") {
 		out << "jmp " << tgt->getName() << "\n";
 		return;
@@ -193,11 +228,11 @@ void IfzQuad::codegenX64(std::ostream& out){
 	out << "je " << tgt->getName() << "\n";
 }
 
-void NopQuad::codegenX64(std::ostream& out){
+void NopQuad::codegenX64(OutputSink& out){
 	out << "nop" << "\n";
 }
 
-void IntrinsicOutputQuad::codegenX64(std::ostream& out){
+void IntrinsicOutputQuad::codegenX64(OutputSink& out){
 	if (myType->isBool()){
 		myArg->genLoadVal(out, DI);
 		out << "\tcallq printBool\n";
@@ -210,7 +245,7 @@ void IntrinsicOutputQuad::codegenX64(std::ostream& out){
 	}
 }
 
-void IntrinsicInputQuad::codegenX64(std::ostream& out){
+void IntrinsicInputQuad::codegenX64(OutputSink& out){
 	if (myType->isBool()){
 		myArg->genLoadVal(out, DI);
 		out << "\tcallq getBool\n\t";
@@ -222,26 +257,32 @@ void IntrinsicInputQuad::codegenX64(std::ostream& out){
 	} else throw InternalError("Attempt to receive string");
 }
 
-void CallQuad::codegenX64(std::ostream& out){
+void CallQuad::codegenX64(OutputSink& out){
 	out << "callq fun_" << callee->getName() << "\n";
 	auto t = callee->getDataType()->asFn()->getFormalTypes();
 	if (t->size() > 6) out << "\taddq $" << 8*(t->size() - 6) << ", %rsp # pop those extra args \n";
 }
 
-void EnterQuad::codegenX64(std::ostream& out){
+void TailCallQuad::codegenX64(OutputSink& out){
+	out << "addq $" << caller->arSize() << ", %rsp # tail call, drop frame\n";
+	out << "\tpopq %rbp\n";
+	out << "\tjmp fun_" << getCallee()->getName() << "\n";
+}
+
+void EnterQuad::codegenX64(OutputSink& out){
 	out << "\n\tpushq %rbp\n";
 	out << "\tmovq %rsp, %rbp\n";
 	out << "\taddq $16, %rbp\n";
 	out << "\tsubq $" << this->myProc->arSize() << ", %rsp\n\t # ^Function Header^\n";
 }
 
-void LeaveQuad::codegenX64(std::ostream& out){
+void LeaveQuad::codegenX64(OutputSink& out){
 	out << "\n\taddq $" << this->myProc->arSize() << ", %rsp\n";
 	out << "\tpopq %rbp\n";
 	out << "\tretq\n";
 }
 
-void SetArgQuad::codegenX64(std::ostream& out){
+void SetArgQuad::codegenX64(OutputSink& out){
 	Register r;
 	switch (index) {
 	case 1: r = DI; break;
@@ -268,7 +309,7 @@ void SetArgQuad::codegenX64(std::ostream& out){
 	}
 }
 
-void GetArgQuad::codegenX64(std::ostream& out){
+void GetArgQuad::codegenX64(OutputSink& out){
 	Register r;
 	switch (index) {
 	case 1: r = DI; break;
@@ -296,68 +337,72 @@ void GetArgQuad::codegenX64(std::ostream& out){
 	}
 }
 
-void SetRetQuad::codegenX64(std::ostream& out){
+void SetRetQuad::codegenX64(OutputSink& out){
 	getSrc()->genLoadVal(out,A);
 }
 
-void GetRetQuad::codegenX64(std::ostream& out){
+void GetRetQuad::codegenX64(OutputSink& out){
 	opd->genStoreVal(out,A);
 }
 
-void IndexQuad::codegenX64(std::ostream& out){
+void IndexQuad::codegenX64(OutputSink& out){
 	src->genLoadAddr(out,A);
 	out << "\taddq $" << off->valString() << ", %rax # Index, add addr offset\n\t";
 	dst->genStoreAddr(out,A);
 }
 
-void SymOpd::genLoadVal(std::ostream& out, Register reg){
+void PhiQuad::codegenX64(OutputSink& out){
+	throw new InternalError("PHI left in code for x64");
+}
+
+void SymOpd::genLoadVal(OutputSink& out, Register reg){
 	out << getMovOp() << getMemoryLoc() << ", " << getReg(reg) << "\n";
 }
 
-void SymOpd::genStoreVal(std::ostream& out, Register reg){
+void SymOpd::genStoreVal(OutputSink& out, Register reg){
 	out << getMovOp() << getReg(reg) << ", " << this->getMemoryLoc() << "\n";
 }
 
-void SymOpd::genLoadAddr(std::ostream& out, Register reg) {
+void SymOpd::genLoadAddr(OutputSink& out, Register reg) {
 	out << "leaq " << getMemoryLoc() << ", " << RegUtils::reg64(reg) << "\n";
 }
 
-void AuxOpd::genLoadVal(std::ostream& out, Register reg){
+void AuxOpd::genLoadVal(OutputSink& out, Register reg){
 	out << getMovOp() << this->getMemoryLoc() << ", " << getReg(reg) << "\n";
 }
 
-void AuxOpd::genStoreVal(std::ostream& out, Register reg){
+void AuxOpd::genStoreVal(OutputSink& out, Register reg){
 	out << getMovOp() << getReg(reg) << ", " << getMemoryLoc() << "\n";
 }
 
-void AuxOpd::genLoadAddr(std::ostream& out, Register reg){
+void AuxOpd::genLoadAddr(OutputSink& out, Register reg){
 	TODO(Implement me)
 }
 
 
-void AddrOpd::genStoreVal(std::ostream& out, Register reg){
+void AddrOpd::genStoreVal(OutputSink& out, Register reg){
 	//store address in rbx
 	out << getMovOp() << getMemoryLoc() << ", " << getReg(B) << "\n\t";
 	//store reg value in value at the address in rbx
 	out << getMovOp() << getReg(reg) << ", (" << getReg(B) << ")\n";
 }
 
-void AddrOpd::genLoadVal(std::ostream& out, Register reg){
+void AddrOpd::genLoadVal(OutputSink& out, Register reg){
 	//store address in rbx
 	out << getMovOp() << getMemoryLoc() << ", " << getReg(B) << "\n\t";
 	//store value at the address in rbx in reg
 	out << getMovOp() << "(" << getReg(B) << "), " << getReg(reg) << "\n";
 }
 
-void AddrOpd::genStoreAddr(std::ostream& out, Register reg){
+void AddrOpd::genStoreAddr(OutputSink& out, Register reg){
 	out << getMovOp() << getReg(reg) << ", " << getMemoryLoc() << "\n";
 }
 
-void AddrOpd::genLoadAddr(std::ostream & out, Register reg){
+void AddrOpd::genLoadAddr(OutputSink& out, Register reg){
 	out << getMovOp() << getMemoryLoc() << ", " << getReg(reg) << "\n";
 }
 
-void LitOpd::genLoadVal(std::ostream & out, Register reg){
+void LitOpd::genLoadVal(OutputSink& out, Register reg){
 	out << getMovOp() << "$" << val << ", " << getReg(reg) << "\n";
 }
 